@@ -1,80 +1,121 @@
 #version 410 core
+// compiled per ShaderVariants key: DIFFUSE_MAP, SPECULAR_MAP, ROUGHNESS_MAP,
+// METALNESS_MAP, EMISSION_MAP, INSTANCED
 
+#ifdef DIFFUSE_MAP
 uniform sampler2D texture_diffuse1;
+#endif
+#ifdef SPECULAR_MAP
 uniform sampler2D texture_specular1;
+#endif
+#ifdef ROUGHNESS_MAP
 uniform sampler2D texture_roughness1;
+#endif
+#ifdef METALNESS_MAP
 uniform sampler2D texture_metalness1;
+#endif
+#ifdef EMISSION_MAP
 uniform sampler2D texture_emission1;
-const int MAX_LIGHTS = 12;
-uniform vec3 lightColor[MAX_LIGHTS];
-uniform float lightIntensity[MAX_LIGHTS];
-uniform vec3 MatAmb;
-uniform vec3 MatDif;
-uniform vec3 MatSpec;
-uniform float MatShine;
-uniform int hasTexture;
-uniform int numLights;
+#endif
+layout(std140) uniform PerFrame {
+    mat4 P;
+    mat4 V;
+};
+
+// per-program scale on the shared frame lights
+uniform float lightIntensityScale;
+#ifdef INSTANCED
+flat in ivec4 drawParams;
+flat in vec4 uvTransform;
+#else
+layout(std140) uniform PerDraw {
+    mat4 M;
+    ivec4 drawParams; // x material index, y flags, z texture array layer
+    vec4 uvTransform;  // xy scale, zw offset into the layer
+};
+#endif
+#define MAX_MATERIALS 16
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // rgb specular, a shininess
+};
+layout(std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+// textured materials take their specular from the specular and metalness maps,
+// without both it is zero and the specular term is left out entirely
+#if !defined(DIFFUSE_MAP) || (defined(SPECULAR_MAP) && defined(METALNESS_MAP))
+#define HAS_SPECULAR
+#endif
 
 in vec2 vTexCoord;
 in vec3 fragNor;
-in vec3 lightDir[MAX_LIGHTS];
-in float distance[MAX_LIGHTS];
 in vec3 EPos;
 
 out vec4 Outcolor;
 
 void main() {
+    Material material = materials[drawParams.x];
+    vec3 MatAmb = material.ambient.rgb;
+    float MatShine = material.specular.a;
+
+    // every map is sampled once, outside the light loop
+#ifdef DIFFUSE_MAP
+    vec3 albedo = texture(texture_diffuse1, vTexCoord).rgb;
+    vec3 ambientAlbedo = albedo;
+#else
+    vec3 albedo = material.diffuse.rgb;
+    vec3 ambientAlbedo = vec3(1.0);
+#endif
+
+#ifdef HAS_SPECULAR
+#ifdef DIFFUSE_MAP
+#ifdef ROUGHNESS_MAP
+    float roughness = texture(texture_roughness1, vTexCoord).r;
+#else
+    float roughness = 0.0;
+#endif
+    float metalness = texture(texture_metalness1, vTexCoord).r;
+    vec3 specularColor = texture(texture_specular1, vTexCoord).rgb * (1.0 - roughness) * metalness;
+#else
+    vec3 specularColor = material.specular.rgb;
+#endif
+    vec3 viewDir = normalize(-EPos);
+#endif
+
     // Normalize vectors
     vec3 normal = normalize(fragNor);
     vec3 finalColor = vec3(0.0, 0.0, 0.0);
-    
-    for (int i = 0; i < numLights; ++i) {
-        vec3 light = normalize(lightDir[i]);
-        
+
+    uvec2 lightRange = clusterLightRange(EPos);
+    for (uint n = 0u; n < lightRange.y; ++n) {
+        ClusterLight clusterLight = fetchClusterLight(lightRange.x + n);
+        vec3 toLight = clusterLight.position - EPos;
+        float distance = length(toLight);
+        vec3 light = toLight / distance;
+        vec3 radiance = clusterLight.color * lightIntensityScale;
+        float attenuation = clusterAttenuation(distance, clusterLight.radius);
+
         // Diffuse
         float diff = max(dot(normal, light), 0.0);
-        
+        vec3 lit = diff * albedo;
+
+#ifdef HAS_SPECULAR
         // Specular
-        vec3 viewDir = normalize(-EPos);
         vec3 halfDir = normalize(light + viewDir);
         float spec = pow(max(dot(normal, halfDir), 0.0), MatShine);
-        
-        // Declare these outside the if statement
-        vec3 diffuse;
-        vec3 specular;
-        
-        if (hasTexture == 1) {
-            // Roughness and Metalness
-            float roughness = texture(texture_roughness1, vTexCoord).r;
-            float metalness = texture(texture_metalness1, vTexCoord).r;
-            diffuse = diff * texture(texture_diffuse1, vTexCoord).rgb * lightColor[i] * lightIntensity[i];
-            specular = spec * texture(texture_specular1, vTexCoord).rgb * lightColor[i] * lightIntensity[i] 
-                      * (1.0 - roughness) * metalness;
-        } else {
-            diffuse = diff * MatDif * lightColor[i] * lightIntensity[i];
-            specular = spec * MatSpec * lightColor[i] * lightIntensity[i];
-        }
-        
-        float attenuation = 1.0 / (1.0 + 0.045 * distance[i] + 0.0075 * distance[i] * distance[i]);
-        diffuse *= attenuation;
-        specular *= attenuation;
-        
-        finalColor += diffuse + specular;
+        lit += spec * specularColor;
+#endif
+
+        finalColor += lit * radiance * attenuation;
     }
-    
+
     // Ambient
-    vec3 ambient;
-    vec3 result;
-    
-    if (hasTexture == 1) {
-        ambient = MatAmb * texture(texture_diffuse1, vTexCoord).rgb * 0.5;
-        // Emission
-        vec3 emission = texture(texture_emission1, vTexCoord).rgb;
-        result = finalColor + ambient + emission;
-    } else {
-        ambient = MatAmb * 0.5;
-        result = finalColor + ambient;
-    }
-    
+    vec3 result = finalColor + MatAmb * ambientAlbedo * 0.5;
+#ifdef EMISSION_MAP
+    result += texture(texture_emission1, vTexCoord).rgb;
+#endif
+
     Outcolor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -1,46 +1,62 @@
 #version 410 core
+// compiled per ShaderVariants key: SKINNED, INSTANCED
 
 layout(location = 0) in vec3 vertPos;
 layout(location = 1) in vec3 vertNor;
 layout(location = 2) in vec2 vertTex;
+#ifdef SKINNED
 layout(location = 5) in ivec4 boneIds;
 layout(location = 6) in vec4 weights;
+#endif
 
-uniform mat4 P;
-uniform mat4 M;
-uniform mat4 V;
+#ifdef INSTANCED
+// the PerDraw record of each instance, see InstanceBuffer
+layout(location = 7) in mat4 M;
+layout(location = 11) in ivec4 instanceDrawParams;
+layout(location = 12) in vec4 instanceUvTransform;
+flat out ivec4 drawParams;
+flat out vec4 uvTransform;
+#else
+layout(std140) uniform PerDraw {
+  mat4 M;
+  ivec4 drawParams; // x material index, y flags, z texture array layer
+  vec4 uvTransform;  // xy scale, zw offset into the layer
+};
+#endif
 
+#ifdef SKINNED
 const int MAX_BONES = 200;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+layout(std140) uniform Bones {
+  mat4 finalBonesMatrices[MAX_BONES];
+};
+#endif
 
-const int MAX_LIGHTS = 12;
-uniform int numLights;
-uniform vec3 lightPos[MAX_LIGHTS];
+layout(std140) uniform PerFrame {
+  mat4 P;
+  mat4 V;
+};
 
 out vec2 vTexCoord;
 out vec3 fragNor;
 out vec3 EPos;
-out vec3 lightDir[MAX_LIGHTS];
-out float distance[MAX_LIGHTS];
 
 void main() {
+#ifdef SKINNED
   mat4 BoneTransform = finalBonesMatrices[boneIds[0]] * weights[0];
   BoneTransform += finalBonesMatrices[boneIds[1]] * weights[1];
   BoneTransform += finalBonesMatrices[boneIds[2]] * weights[2];
   BoneTransform += finalBonesMatrices[boneIds[3]] * weights[3];
 
   vec4 posL = BoneTransform * vec4(vertPos, 1.0f);
+#else
+  vec4 posL = vec4(vertPos, 1.0f);
+#endif
 
   vec3 wPos = vec3(M * posL);
 
   fragNor = vertNor;
 
-  for (int i = 0; i < numLights; ++i) {
-    lightDir[i] = (V * (vec4(lightPos[i] - wPos, 0.0))).xyz;
-    distance[i] = length(lightPos[i] - wPos);
-  }
-
   EPos = (V * vec4(wPos, 1.0)).xyz;
 
   mat4 viewModel = V * M;
@@ -48,4 +64,8 @@ void main() {
   gl_Position = P * viewModel * posL;
 
   vTexCoord = vertTex;
+#ifdef INSTANCED
+  drawParams = instanceDrawParams;
+  uvTransform = instanceUvTransform;
+#endif
 }
@@ -0,0 +1,38 @@
+// Clustered light lookup shared by every lit fragment shader; Program inserts it
+// after the #version line and defines (see Program::setFragmentPrelude). The
+// layouts and the attenuation must match LightClusters.
+
+layout(std140) uniform Clusters {
+    ivec4 clusterGrid; // xyz cluster counts, w light count
+    vec4 clusterDepth; // x slice near, y far, z slice scale, w slice bias
+    vec4 clusterTile;  // xy tile size in pixels
+};
+uniform samplerBuffer clusterLights;        // view-space position and radius, then color and intensity
+uniform usamplerBuffer clusterRanges;       // first entry in clusterLightIndices and count, per cluster
+uniform usamplerBuffer clusterLightIndices;
+
+struct ClusterLight {
+    vec3 position; // view space
+    float radius;
+    vec3 color;    // times intensity
+};
+
+// where the lights of this fragment's cluster start in clusterLightIndices, and how many there are
+uvec2 clusterLightRange(vec3 viewPos) {
+    ivec3 cell = ivec3(ivec2(gl_FragCoord.xy / clusterTile.xy), int(log(max(-viewPos.z, 1e-4)) * clusterDepth.z - clusterDepth.w));
+    cell = clamp(cell, ivec3(0), clusterGrid.xyz - 1);
+    return texelFetch(clusterRanges, cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)).xy;
+}
+
+ClusterLight fetchClusterLight(uint entry) {
+    int index = int(texelFetch(clusterLightIndices, int(entry)).r);
+    vec4 positionRadius = texelFetch(clusterLights, 2 * index);
+    vec4 colorIntensity = texelFetch(clusterLights, 2 * index + 1);
+    return ClusterLight(positionRadius.xyz, positionRadius.w, colorIntensity.rgb * colorIntensity.a);
+}
+
+// the usual distance falloff, windowed to reach zero at the light's radius
+float clusterAttenuation(float distance, float radius) {
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    return window * window / (1.0 + 0.045 * distance + 0.0075 * distance * distance);
+}
@@ -3,9 +3,12 @@
 layout(location = 0) in vec3 vertPos;
 layout(location = 1) in vec4 vertColor;
 
-uniform mat4 P;
 uniform mat4 M;
-uniform mat4 V;
+
+layout(std140) uniform PerFrame {
+	mat4 P;
+	mat4 V;
+};
 
 //replace with an attribute
 // uniform vec3 pColor;
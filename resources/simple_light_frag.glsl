@@ -38,17 +38,31 @@
 // }
 
 #version 410 core
-#define MAX_LIGHTS 12
 
 out vec4 color;
 
-uniform vec3 MatAmb;
-uniform vec3 MatDif;
-uniform vec3 MatSpec;
-uniform float MatShine;
-uniform vec3 lightColor[MAX_LIGHTS];
-uniform float lightIntensity[MAX_LIGHTS];
-uniform int numLights;
+layout(std140) uniform PerDraw {
+	mat4 M;
+	ivec4 drawParams; // x material index, y flags, z texture array layer
+	vec4 uvTransform;  // xy scale, zw offset into the layer
+};
+#define MAX_MATERIALS 16
+struct Material {
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular; // rgb specular, a shininess
+};
+layout(std140) uniform Materials {
+	Material materials[MAX_MATERIALS];
+};
+// per-program scale on the shared frame lights
+uniform float lightIntensityScale;
+
+layout(std140) uniform PerFrame {
+	mat4 P;
+	mat4 V;
+};
+
 uniform int hasEmittance;
 uniform vec3 MatEmitt;
 uniform float MatEmittIntensity;
@@ -61,35 +75,44 @@ uniform float randFloat2;
 uniform float randFloat3;
 uniform float randFloat4;
 
-//interpolated normal and light vector in camera space
+//interpolated normal and position in camera space
 in vec3 fragNor;
-in vec3 lightDir[MAX_LIGHTS];
 in vec3 EPos;
-in float distance[MAX_LIGHTS];
 
 void main()
 {
+	Material material = materials[drawParams.x];
+	vec3 MatAmb = material.ambient.rgb;
+	vec3 MatDif = material.diffuse.rgb;
+	vec3 MatSpec = material.specular.rgb;
+	float MatShine = material.specular.a;
+
 	//you will need to work with these for lighting
 	vec3 normal = normalize(fragNor);
 
 
 	vec3 finalColor = vec3(0.0);
 
-	for (int i = 0; i < numLights; ++i) {
-		vec3 light = normalize(lightDir[i]);
+	uvec2 lightRange = clusterLightRange(EPos);
+	for (uint n = 0u; n < lightRange.y; ++n) {
+		ClusterLight clusterLight = fetchClusterLight(lightRange.x + n);
+		vec3 toLight = clusterLight.position - EPos;
+		float distance = length(toLight);
+		vec3 light = toLight / distance;
+		vec3 radiance = clusterLight.color * lightIntensityScale;
 
-		// vec3 ambient = MatAmb * lightColor[i] * lightIntensity[i];
+		// vec3 ambient = MatAmb * radiance;
 
 		float dC = max(dot(normal, light), 0.0);
 
-		vec3 diffuse = dC * MatDif * lightColor[i] * lightIntensity[i];
+		vec3 diffuse = dC * MatDif * radiance;
 
 		vec3 viewDir = normalize(-EPos);
 		vec3 halfDir = normalize(light + viewDir);
 		float specular = pow(max(dot(halfDir, normal), 0.0), MatShine);
-		vec3 specularTerm = MatSpec * specular * lightColor[i] * lightIntensity[i];
+		vec3 specularTerm = MatSpec * specular * radiance;
 
-		float attenuation = 1.0 / (1.0 + 0.045 * distance[i] + 0.0075 * distance[i] * distance[i]);
+		float attenuation = clusterAttenuation(distance, clusterLight.radius);
 
 		diffuse *= attenuation;
 		specularTerm *= attenuation;
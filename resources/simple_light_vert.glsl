@@ -25,21 +25,22 @@
 // }
 
 #version 410 core
-#define MAX_LIGHTS 12
 layout(location = 0) in vec4 vertPos;
 layout(location = 1) in vec3 vertNor;
-uniform mat4 P;
-uniform mat4 V;
-uniform mat4 M;
+layout(std140) uniform PerDraw {
+	mat4 M;
+	ivec4 drawParams; // x material index, y flags, z texture array layer
+	vec4 uvTransform;  // xy scale, zw offset into the layer
+};
 
-uniform vec3 lightPos[MAX_LIGHTS];
-uniform int numLights;
+layout(std140) uniform PerFrame {
+	mat4 P;
+	mat4 V;
+};
 
 //keep these and set them correctly
 out vec3 fragNor;
-out vec3 lightDir[MAX_LIGHTS];
 out vec3 EPos;
-out float distance[MAX_LIGHTS];
 
 void main()
 {
@@ -51,9 +52,5 @@ void main()
 	fragNor = (V * M * vec4(vertNor, 0.0)).xyz;
 	vec3 wPos = vec3(M * vec4(vertPos.xyz, 1.0));
 
-	for (int i = 0; i < numLights; ++i) {
-		lightDir[i] = (V * (vec4(lightPos[i] - wPos, 0.0))).xyz;
-		distance[i] = length(lightPos[i] - wPos);
-	}
 	EPos = (V * vec4(wPos, 1.0)).xyz;
 }
@@ -3,10 +3,13 @@
 layout(location = 0) in vec4 vertPos;
 layout(location = 1) in vec3 vertNor;
 
-uniform mat4 P;
-uniform mat4 V;
 uniform mat4 M;
 
+layout(std140) uniform PerFrame {
+	mat4 P;
+	mat4 V;
+};
+
 out vec3 fragNor;
 
 void main() {
@@ -0,0 +1,98 @@
+#version 410 core
+// diffuse maps of every batched material, see MaterialBatcher
+uniform sampler2DArray TextureArray0;
+const int FLAG_ATLASED = 2;
+
+#ifdef INSTANCED
+flat in ivec4 drawParams;
+flat in vec4 uvTransform;
+#else
+layout(std140) uniform PerDraw {
+    mat4 M;
+    ivec4 drawParams; // x material index, y flags, z texture array layer
+    vec4 uvTransform;  // xy scale, zw offset into the layer
+};
+#endif
+#define MAX_MATERIALS 16
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // rgb specular, a shininess
+};
+layout(std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+// per-program scale on the shared frame lights
+uniform float lightIntensityScale;
+
+layout(std140) uniform PerFrame {
+    mat4 P;
+    mat4 V;
+};
+
+in vec2 vTexCoord;
+in vec3 fragNor;
+in vec3 EPos;
+
+out vec4 Outcolor;
+
+void main() {
+    Material material = materials[drawParams.x];
+    vec3 MatAmb = material.ambient.rgb;
+    vec3 MatSpec = material.specular.rgb;
+    float MatShine = material.specular.a;
+
+    // gradients of the unwrapped UVs, so the wrap inside an atlas entry does not pick a tiny mip at its seams
+    vec2 uvScale = uvTransform.xy;
+    vec2 dx = dFdx(vTexCoord) * uvScale;
+    vec2 dy = dFdy(vTexCoord) * uvScale;
+    vec2 uv = vTexCoord;
+    if ((drawParams.y & FLAG_ATLASED) != 0) {
+        uv = fract(uv);
+    }
+    uv = uv * uvScale + uvTransform.zw;
+    vec4 texColor = textureGrad(TextureArray0, vec3(uv, float(drawParams.z)), dx, dy);
+
+    vec3 finalColor = vec3(0.0, 0.0, 0.0);
+    vec3 textureColor = texColor.rgb;
+
+    // Normalize vectors
+    vec3 normal = normalize(fragNor);
+
+    uvec2 lightRange = clusterLightRange(EPos);
+    for (uint n = 0u; n < lightRange.y; ++n) {
+        ClusterLight clusterLight = fetchClusterLight(lightRange.x + n);
+        vec3 toLight = clusterLight.position - EPos;
+        float distance = length(toLight);
+        vec3 light = toLight / distance;
+        vec3 radiance = clusterLight.color * lightIntensityScale;
+
+
+        // Diffuse
+        float diff = max(dot(normal, light), 0.0);
+        vec3 diffuse = diff * texColor.rgb * radiance;
+
+        // Specular
+        vec3 viewDir = normalize(-EPos);
+        vec3 halfDir = normalize(light + viewDir);
+        float spec = pow(max(dot(normal, halfDir), 0.0), MatShine);
+        vec3 specular = MatSpec * spec * radiance;
+        // vec3 specular = spec * vec3(1.0) * radiance;
+
+        float attenuation = clusterAttenuation(distance, clusterLight.radius);
+
+        diffuse *= attenuation;
+        specular *= attenuation;
+
+        finalColor += diffuse + specular;
+    }
+
+    // Ambient
+    vec3 ambient = MatAmb * texColor.rgb * 0.5;
+
+    // Combine results
+    vec3 result = finalColor + ambient;
+
+    Outcolor = vec4(result, texColor.a);
+}
+
@@ -16,26 +16,47 @@
 
 
 #version 410 core
-#define MAX_LIGHTS 12
 uniform sampler2D Texture0;
 
-uniform vec3 MatAmb;
-uniform vec3 MatSpec;
-uniform float MatShine;
-uniform vec3 lightColor[MAX_LIGHTS];
-uniform float lightIntensity[MAX_LIGHTS];
-
-uniform int numLights;
+#ifdef INSTANCED
+flat in ivec4 drawParams;
+flat in vec4 uvTransform;
+#else
+layout(std140) uniform PerDraw {
+    mat4 M;
+    ivec4 drawParams; // x material index, y flags, z texture array layer
+    vec4 uvTransform;  // xy scale, zw offset into the layer
+};
+#endif
+#define MAX_MATERIALS 16
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // rgb specular, a shininess
+};
+layout(std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+// per-program scale on the shared frame lights
+uniform float lightIntensityScale;
+
+layout(std140) uniform PerFrame {
+    mat4 P;
+    mat4 V;
+};
 
 in vec2 vTexCoord;
 in vec3 fragNor;
-in vec3 lightDir[MAX_LIGHTS];
 in vec3 EPos;
-in float distance[MAX_LIGHTS];
 
 out vec4 Outcolor;
 
 void main() {
+    Material material = materials[drawParams.x];
+    vec3 MatAmb = material.ambient.rgb;
+    vec3 MatSpec = material.specular.rgb;
+    float MatShine = material.specular.a;
+
     vec4 texColor = texture(Texture0, vTexCoord);
 
     vec3 finalColor = vec3(0.0, 0.0, 0.0);
@@ -44,22 +65,27 @@ void main() {
     // Normalize vectors
     vec3 normal = normalize(fragNor);
 
-    for (int i = 0; i < numLights; ++i) {
-        vec3 light = normalize(lightDir[i]);
+    uvec2 lightRange = clusterLightRange(EPos);
+    for (uint n = 0u; n < lightRange.y; ++n) {
+        ClusterLight clusterLight = fetchClusterLight(lightRange.x + n);
+        vec3 toLight = clusterLight.position - EPos;
+        float distance = length(toLight);
+        vec3 light = toLight / distance;
+        vec3 radiance = clusterLight.color * lightIntensityScale;
 
 
         // Diffuse
         float diff = max(dot(normal, light), 0.0);
-        vec3 diffuse = diff * texColor.rgb * lightColor[i] * lightIntensity[i];
+        vec3 diffuse = diff * texColor.rgb * radiance;
 
         // Specular
         vec3 viewDir = normalize(-EPos);
         vec3 halfDir = normalize(light + viewDir);
         float spec = pow(max(dot(normal, halfDir), 0.0), MatShine);
-        vec3 specular = MatSpec * spec * lightColor[i] * lightIntensity[i];
-        // vec3 specular = spec * vec3(1.0) * lightColor[i] * lightIntensity[i];
+        vec3 specular = MatSpec * spec * radiance;
+        // vec3 specular = spec * vec3(1.0) * radiance;
 
-        float attenuation = 1.0 / (1.0 + 0.045 * distance[i] + 0.0075 * distance[i] * distance[i]);
+        float attenuation = clusterAttenuation(distance, clusterLight.radius);
 
         diffuse *= attenuation;
         specular *= attenuation;
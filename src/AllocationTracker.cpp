@@ -0,0 +1,476 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <intrin.h>
+#include <malloc.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+// where the operator new being run was called from; only meaningful in the operator itself
+#ifdef _MSC_VER
+#define CALLER_ADDRESS() _ReturnAddress()
+#else
+#define CALLER_ADDRESS() __builtin_return_address(0)
+#endif
+
+// Everything operator new touches is constant initialized, it can run before main
+namespace
+{
+
+std::atomic<bool> enabled{false};
+thread_local AllocationTracker::Tag currentTag = AllocationTracker::TAG_UNTAGGED;
+
+std::atomic<uint64_t> allocationCounts[AllocationTracker::TAG_COUNT];
+std::atomic<uint64_t> byteCounts[AllocationTracker::TAG_COUNT];
+std::atomic<uint64_t> freeCounts[AllocationTracker::TAG_COUNT];
+
+// Call sites in a fixed open addressed table, claimed with a compare and swap;
+// recording one must not allocate
+const size_t SITE_SLOTS = 4096;
+const size_t SITE_PROBES = 32;
+
+struct SiteSlot
+{
+	std::atomic<uintptr_t> address;
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> bytes;
+};
+
+SiteSlot sites[SITE_SLOTS];
+// allocations from sites that found no free slot
+std::atomic<uint64_t> unrecordedSites{0};
+
+// Frames are only ended and reset from one thread
+AllocationTracker::Counts frameStart[AllocationTracker::TAG_COUNT];
+AllocationTracker::Counts resetStart[AllocationTracker::TAG_COUNT];
+AllocationTracker::FrameStats lastFrame;
+AllocationTracker::FrameStats worstFrame;
+uint64_t frameCount = 0;
+uint64_t allocatingFrames = 0;
+
+void recordAllocation(size_t size, const void *caller)
+{
+	AllocationTracker::Tag tag = currentTag;
+	allocationCounts[tag].fetch_add(1, std::memory_order_relaxed);
+	byteCounts[tag].fetch_add(size, std::memory_order_relaxed);
+
+	uintptr_t address = (uintptr_t) caller;
+	size_t slot = (size_t) (((uint64_t) address * 0x9E3779B97F4A7C15ull) >> 52);
+	for (size_t probe = 0; probe < SITE_PROBES; probe++)
+	{
+		SiteSlot &site = sites[(slot + probe) % SITE_SLOTS];
+		uintptr_t current = site.address.load(std::memory_order_relaxed);
+		if (current == 0 && site.address.compare_exchange_strong(current, address, std::memory_order_relaxed))
+		{
+			current = address;
+		}
+		if (current == address)
+		{
+			site.allocations.fetch_add(1, std::memory_order_relaxed);
+			site.bytes.fetch_add(size, std::memory_order_relaxed);
+			return;
+		}
+	}
+	unrecordedSites.fetch_add(1, std::memory_order_relaxed);
+}
+
+void recordFree()
+{
+	freeCounts[currentTag].fetch_add(1, std::memory_order_relaxed);
+}
+
+// alignment 0 for the default one; nullptr once the new handler gives up
+void *allocateMemory(size_t size, size_t alignment)
+{
+	size = std::max<size_t>(size, 1);
+	for (;;)
+	{
+		void *memory = nullptr;
+		if (alignment == 0)
+		{
+			memory = std::malloc(size);
+		}
+		else
+		{
+#ifdef _WIN32
+			memory = _aligned_malloc(size, alignment);
+#else
+			if (posix_memalign(&memory, std::max(alignment, sizeof(void*)), size) != 0)
+			{
+				memory = nullptr;
+			}
+#endif
+		}
+		if (memory)
+		{
+			return memory;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+		{
+			return nullptr;
+		}
+		handler();
+	}
+}
+
+void *allocateOrThrow(size_t size, size_t alignment, const void *caller)
+{
+	if (enabled.load(std::memory_order_relaxed))
+	{
+		recordAllocation(size, caller);
+	}
+	void *memory = allocateMemory(size, alignment);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *allocateOrNull(size_t size, size_t alignment, const void *caller) noexcept
+{
+	if (enabled.load(std::memory_order_relaxed))
+	{
+		recordAllocation(size, caller);
+	}
+	try
+	{
+		return allocateMemory(size, alignment);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void release(void *memory, bool aligned) noexcept
+{
+	if (!memory)
+	{
+		return;
+	}
+	if (enabled.load(std::memory_order_relaxed))
+	{
+		recordFree();
+	}
+#ifdef _WIN32
+	if (aligned)
+	{
+		_aligned_free(memory);
+		return;
+	}
+#else
+	(void) aligned;
+#endif
+	std::free(memory);
+}
+
+void readCounts(AllocationTracker::Counts *counts)
+{
+	for (int tag = 0; tag < AllocationTracker::TAG_COUNT; tag++)
+	{
+		counts[tag].allocations = allocationCounts[tag].load(std::memory_order_relaxed);
+		counts[tag].bytes = byteCounts[tag].load(std::memory_order_relaxed);
+		counts[tag].frees = freeCounts[tag].load(std::memory_order_relaxed);
+	}
+}
+
+AllocationTracker::Counts difference(const AllocationTracker::Counts &later, const AllocationTracker::Counts &earlier)
+{
+	AllocationTracker::Counts counts;
+	counts.allocations = later.allocations - earlier.allocations;
+	counts.bytes = later.bytes - earlier.bytes;
+	counts.frees = later.frees - earlier.frees;
+	return counts;
+}
+
+void add(AllocationTracker::Counts &sum, const AllocationTracker::Counts &counts)
+{
+	sum.allocations += counts.allocations;
+	sum.bytes += counts.bytes;
+	sum.frees += counts.frees;
+}
+
+// The address, and the module offset and symbol when the platform can tell them.
+// The address is the return address, one instruction past the call
+void describeAddress(std::ostream &out, const void *address)
+{
+	out << address;
+#ifndef _WIN32
+	Dl_info info;
+	if (dladdr(address, &info) && info.dli_fname)
+	{
+		const char *module = std::strrchr(info.dli_fname, '/');
+		out << " " << (module ? module + 1 : info.dli_fname) << "+0x" << std::hex
+			<< (uintptr_t) address - (uintptr_t) info.dli_fbase << std::dec;
+		if (info.dli_sname)
+		{
+			const char *name = info.dli_sname;
+#ifdef __GNUG__
+			int status = 0;
+			char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+			if (status == 0 && demangled)
+			{
+				name = demangled;
+			}
+			out << " " << name;
+			std::free(demangled);
+#else
+			out << " " << name;
+#endif
+		}
+	}
+#endif
+}
+
+}
+
+AllocationTracker::Scope::Scope(Tag tag) : previous(currentTag)
+{
+	currentTag = tag;
+}
+
+AllocationTracker::Scope::~Scope()
+{
+	currentTag = previous;
+}
+
+void AllocationTracker::setEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::isEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::endFrame()
+{
+	Counts now[TAG_COUNT];
+	readCounts(now);
+
+	FrameStats frame;
+	frame.frame = ++frameCount;
+	for (int tag = 0; tag < TAG_COUNT; tag++)
+	{
+		frame.tags[tag] = difference(now[tag], frameStart[tag]);
+		add(frame.total, frame.tags[tag]);
+		frameStart[tag] = now[tag];
+	}
+
+	lastFrame = frame;
+	if (frame.total.allocations > 0)
+	{
+		allocatingFrames++;
+	}
+	if (frame.total.allocations > worstFrame.total.allocations)
+	{
+		worstFrame = frame;
+	}
+}
+
+void AllocationTracker::reset()
+{
+	readCounts(frameStart);
+	std::copy(frameStart, frameStart + TAG_COUNT, resetStart);
+	lastFrame = FrameStats();
+	worstFrame = FrameStats();
+	frameCount = 0;
+	allocatingFrames = 0;
+
+	// slots stay claimed, only their counts start over
+	for (SiteSlot &site : sites)
+	{
+		site.allocations.store(0, std::memory_order_relaxed);
+		site.bytes.store(0, std::memory_order_relaxed);
+	}
+	unrecordedSites.store(0, std::memory_order_relaxed);
+}
+
+const AllocationTracker::FrameStats &AllocationTracker::getLastFrame()
+{
+	return lastFrame;
+}
+
+const AllocationTracker::FrameStats &AllocationTracker::getWorstFrame()
+{
+	return worstFrame;
+}
+
+uint64_t AllocationTracker::getFrameCount()
+{
+	return frameCount;
+}
+
+uint64_t AllocationTracker::getAllocatingFrameCount()
+{
+	return allocatingFrames;
+}
+
+AllocationTracker::Counts AllocationTracker::getTotals(Tag tag)
+{
+	Counts now[TAG_COUNT];
+	readCounts(now);
+	return difference(now[tag], resetStart[tag]);
+}
+
+AllocationTracker::Counts AllocationTracker::getTotals()
+{
+	Counts total;
+	for (int tag = 0; tag < TAG_COUNT; tag++)
+	{
+		add(total, getTotals((Tag) tag));
+	}
+	return total;
+}
+
+std::vector<AllocationTracker::CallSite> AllocationTracker::getCallSites(size_t maxSites)
+{
+	std::vector<CallSite> result;
+	for (const SiteSlot &slot : sites)
+	{
+		CallSite site;
+		site.address = (const void*) slot.address.load(std::memory_order_relaxed);
+		site.allocations = slot.allocations.load(std::memory_order_relaxed);
+		site.bytes = slot.bytes.load(std::memory_order_relaxed);
+		if (site.address && site.allocations > 0)
+		{
+			result.push_back(site);
+		}
+	}
+	std::sort(result.begin(), result.end(), [](const CallSite &a, const CallSite &b) {
+		return a.allocations > b.allocations;
+	});
+	if (result.size() > maxSites)
+	{
+		result.resize(maxSites);
+	}
+	return result;
+}
+
+const char *AllocationTracker::getTagName(Tag tag)
+{
+	switch (tag)
+	{
+	case TAG_UNTAGGED: return "untagged";
+	case TAG_ASSETS: return "assets";
+	case TAG_ANIMATION: return "animation";
+	case TAG_RENDER: return "render";
+	case TAG_GAMEPLAY: return "gameplay";
+	default: return "unknown";
+	}
+}
+
+void AllocationTracker::report(std::ostream &out, size_t maxSites)
+{
+	// taken before the report allocates anything itself
+	Counts totals[TAG_COUNT];
+	for (int tag = 0; tag < TAG_COUNT; tag++)
+	{
+		totals[tag] = getTotals((Tag) tag);
+	}
+	uint64_t unrecorded = unrecordedSites.load(std::memory_order_relaxed);
+	std::vector<CallSite> callSites = getCallSites(maxSites);
+
+	out << "Allocations: " << allocatingFrames << " of " << frameCount << " frames allocated";
+	if (worstFrame.total.allocations > 0)
+	{
+		out << ", most in frame " << worstFrame.frame << ": " << worstFrame.total.allocations
+			<< " (" << worstFrame.total.bytes << " bytes)";
+	}
+	out << ", last frame " << lastFrame.total.allocations << std::endl;
+
+	// tags and call sites count everything since the last reset; after a
+	// warm-up reset that is the measured frames only
+	out << "  totals by tag:";
+	for (int tag = 0; tag < TAG_COUNT; tag++)
+	{
+		out << " " << getTagName((Tag) tag) << " " << totals[tag].allocations << " (" << totals[tag].bytes << " bytes)";
+	}
+	out << std::endl;
+
+	for (const CallSite &site : callSites)
+	{
+		out << "  " << site.allocations << " allocations";
+		if (frameCount > 0)
+		{
+			out << " (" << (double) site.allocations / frameCount << " per frame)";
+		}
+		out << ", " << site.bytes << " bytes from ";
+		describeAddress(out, site.address);
+		out << std::endl;
+	}
+	if (unrecorded > 0)
+	{
+		out << "  " << unrecorded << " allocations from call sites that did not fit the table" << std::endl;
+	}
+}
+
+// Replacements for every form of the global operator new and delete
+
+void *operator new(size_t size)
+{
+	return allocateOrThrow(size, 0, CALLER_ADDRESS());
+}
+
+void *operator new[](size_t size)
+{
+	return allocateOrThrow(size, 0, CALLER_ADDRESS());
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocateOrNull(size, 0, CALLER_ADDRESS());
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocateOrNull(size, 0, CALLER_ADDRESS());
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, (size_t) alignment, CALLER_ADDRESS());
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, (size_t) alignment, CALLER_ADDRESS());
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateOrNull(size, (size_t) alignment, CALLER_ADDRESS());
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateOrNull(size, (size_t) alignment, CALLER_ADDRESS());
+}
+
+void operator delete(void *memory) noexcept { release(memory, false); }
+void operator delete[](void *memory) noexcept { release(memory, false); }
+void operator delete(void *memory, const std::nothrow_t&) noexcept { release(memory, false); }
+void operator delete[](void *memory, const std::nothrow_t&) noexcept { release(memory, false); }
+void operator delete(void *memory, size_t) noexcept { release(memory, false); }
+void operator delete[](void *memory, size_t) noexcept { release(memory, false); }
+
+void operator delete(void *memory, std::align_val_t) noexcept { release(memory, true); }
+void operator delete[](void *memory, std::align_val_t) noexcept { release(memory, true); }
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t&) noexcept { release(memory, true); }
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t&) noexcept { release(memory, true); }
+void operator delete(void *memory, size_t, std::align_val_t) noexcept { release(memory, true); }
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept { release(memory, true); }
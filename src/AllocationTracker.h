@@ -0,0 +1,106 @@
+#pragma  once
+
+#ifndef ALLOCATIONTRACKER_H_INCLUDED
+#define ALLOCATIONTRACKER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Counts heap allocations made through operator new, which AllocationTracker.cpp
+// replaces for the whole program.
+//
+// Off by default: until setEnabled(true) every new and delete costs one extra
+// branch. Once enabled, each allocation is counted, with its size, against the
+// tag of the calling thread (see Scope) and against the code that called
+// operator new. endFrame() cuts the running counts into frames, so a frame
+// that allocates in what should be a steady state shows up on its own.
+//
+// Only operator new is seen; malloc from C libraries and drivers is not.
+class AllocationTracker
+{
+
+public:
+
+	// the subsystem an allocation is charged to
+	enum Tag
+	{
+		TAG_UNTAGGED,
+		TAG_ASSETS,
+		TAG_ANIMATION,
+		TAG_RENDER,
+		TAG_GAMEPLAY,
+		TAG_COUNT
+	};
+
+	struct Counts
+	{
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+		uint64_t frees = 0;
+	};
+
+	struct FrameStats
+	{
+		// frames ended since the last reset, this one included
+		uint64_t frame = 0;
+		Counts total;
+		Counts tags[TAG_COUNT];
+	};
+
+	// code that called operator new, as a return address
+	struct CallSite
+	{
+		const void *address = nullptr;
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+	};
+
+	// Charges the allocations of this thread to tag while open; scopes nest
+	class Scope
+	{
+
+	public:
+
+		explicit Scope(Tag tag);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+
+		Tag previous;
+
+	};
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Ends the current frame: what every thread allocated since the previous
+	// endFrame() or reset() is counted as one frame. Call from one thread only
+	static void endFrame();
+	// Starts counting afresh, e.g. once loading and warm-up are over
+	static void reset();
+
+	// the frame endFrame() last closed
+	static const FrameStats &getLastFrame();
+	// the frame with the most allocations since the last reset
+	static const FrameStats &getWorstFrame();
+	static uint64_t getFrameCount();
+	// frames since the last reset that allocated at all
+	static uint64_t getAllocatingFrameCount();
+	// everything since the last reset, frames not yet ended included
+	static Counts getTotals(Tag tag);
+	static Counts getTotals();
+	// call sites since the last reset, most allocations first
+	static std::vector<CallSite> getCallSites(size_t maxSites = 16);
+
+	static const char *getTagName(Tag tag);
+
+	// Frames, per tag totals and the busiest call sites, in readable form
+	static void report(std::ostream &out, size_t maxSites = 8);
+
+};
+
+#endif // ALLOCATIONTRACKER_H_INCLUDED
@@ -1,8 +1,12 @@
 #include "Animation.h"
+#include "PackIOSystem.h"
 // #include <assimp/Importer.hpp>
 
 Animation::Animation(const std::string& animationPath, AssimpModel* model, int animationIndex) {
     Assimp::Importer importer;
+    if (ResourcePack::isMounted()) {
+        importer.SetIOHandler(new PackIOSystem());
+    }
     const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
     assert(scene && scene->mRootNode);
     auto animation = scene->mAnimations[animationIndex];
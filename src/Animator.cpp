@@ -39,7 +39,7 @@ void Animator::PlayAnimation(Animation* pAnimation) {
 
 void Animator::CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
 {
-    std::string nodeName = node->name;
+    const std::string& nodeName = node->name;
     glm::mat4 nodeTransform = node->transformation;
 
     Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
@@ -52,11 +52,13 @@ void Animator::CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 pare
 
     glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-    auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-    if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+    // by reference, a copy of the map per node was most of the frame's allocations
+    const auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
+    auto boneInfo = boneInfoMap.find(nodeName);
+    if (boneInfo != boneInfoMap.end())
     {
-        int index = boneInfoMap[nodeName].id;
-        glm::mat4 offset = boneInfoMap[nodeName].offset;
+        int index = boneInfo->second.id;
+        glm::mat4 offset = boneInfo->second.offset;
         m_FinalBoneMatrices[index] = globalTransformation * offset;
         // m_FinalBoneMatrices[index] = offset * globalTransformation; // for fbx
     }
@@ -18,7 +18,7 @@ class Animator
         void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform);
         void SetCurrentAnimation(Animation* animation) { m_CurrentAnimation = animation; }
         Animation* GetCurrentAnimation() { return m_CurrentAnimation; }
-        std::vector<glm::mat4> GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
+        const std::vector<glm::mat4>& GetFinalBoneMatrices() const { return m_FinalBoneMatrices; }
     private:
         std::vector<glm::mat4> m_FinalBoneMatrices;
         Animation* m_CurrentAnimation;
@@ -1,17 +1,102 @@
 #include "AssimpMesh.h"
 #include "Program.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
 
 #include <iostream>
+#include <algorithm>
+#include <limits>
 
 // Constructor
-AssimpMesh::AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+AssimpMesh::AssimpMesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<AssimpTexture>&& textures, std::vector<MeshLod>&& lods)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)) {
+
+    // without generated levels the whole index buffer is LOD 0
+    if (this->lods.empty()) {
+        this->lods.push_back({ 0, static_cast<unsigned int>(this->indices.size()), 0.0f });
+    }
+
+    vertexCount = this->vertices.size();
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : this->vertices) {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+        skinned = skinned || vertex.m_BoneIDs[0] >= 0;
+    }
 
     // std::cout << "Mesh created" << std::endl;
 
     setupMesh();
+    updateTextureBindings();
+}
+
+AssimpMesh::AssimpMesh(AssimpMesh&& other) noexcept
+    : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+      textureBindings(std::move(other.textureBindings)), lods(std::move(other.lods)), positions(std::move(other.positions)), boundsMin(other.boundsMin), boundsMax(other.boundsMax),
+      VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), indexType(other.indexType), vertexCount(other.vertexCount),
+      skinned(other.skinned), shaderFeatures(other.shaderFeatures) {
+    other.VAO = other.VBO = other.EBO = 0;
+}
+
+AssimpMesh& AssimpMesh::operator=(AssimpMesh&& other) noexcept {
+    if (this != &other) {
+        destroyBuffers();
+
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        textureBindings = std::move(other.textureBindings);
+        lods = std::move(other.lods);
+        positions = std::move(other.positions);
+        boundsMin = other.boundsMin;
+        boundsMax = other.boundsMax;
+        VAO = other.VAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        indexType = other.indexType;
+        vertexCount = other.vertexCount;
+        skinned = other.skinned;
+        shaderFeatures = other.shaderFeatures;
+
+        other.VAO = other.VBO = other.EBO = 0;
+    }
+    return *this;
+}
+
+AssimpMesh::~AssimpMesh() {
+    destroyBuffers();
+}
+
+void AssimpMesh::destroyBuffers() {
+    if (VAO) {
+        GLState::deleteVertexArray(VAO);
+        GLState::deleteBuffer(VBO);
+        GLState::deleteBuffer(EBO);
+        VAO = VBO = EBO = 0;
+    }
+}
+
+void AssimpMesh::releaseCpuData(MeshRetention retention) {
+    if (retention == RETAIN_ALL) {
+        return;
+    }
+
+    if (retention == RETAIN_POSITIONS && !vertices.empty()) {
+        // positions and the full resolution triangles are all collision needs
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i] = vertices[i].Position;
+        }
+        indices.resize(lods[0].indexCount);
+        indices.shrink_to_fit();
+    } else if (retention == RETAIN_BOUNDS) {
+        std::vector<glm::vec3>().swap(positions);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    // swap with empty vectors, clear() alone keeps the capacity
+    std::vector<Vertex>().swap(vertices);
 }
 
 void AssimpMesh::setupMesh()
@@ -20,13 +105,21 @@ void AssimpMesh::setupMesh()
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (vertices.size() <= 65536) {
+        // halve the index buffer when the vertex count allows it
+        std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_INT;
+    }
 
     // Vertex positions
     glEnableVertexAttribArray(0);
@@ -58,59 +151,113 @@ void AssimpMesh::setupMesh()
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
 
-    glBindVertexArray(0);
-
     // std::cout << "Mesh setup complete" << std::endl;
 }
 
-// each diffuse texture should be named as texture_diffuseN, where N is a number
-// each specular texture should be named as texture_specularN, where N is a number
-// uniform sampler2D texture_diffuseN
-// uniform sampler2D texture_specularN
-
-// by this naming convention we can define as many texture samplers as we want in the shaders and
-// if a mesh actually does contain (so many) tetxures it will be loaded and applied
-
-// render the mesh
-void AssimpMesh::Draw(const std::shared_ptr<Program> prog) const {
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr = 1;
-    unsigned int heightNr = 1;
-    unsigned int roughnessNr = 1;
-    unsigned int metalnessNr = 1;
-    unsigned int emissionNr = 1;
-
-    for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        std::string number;
-        std::string name = textures[i].type;
-        if (name == "texture_diffuse") {
-            number = std::to_string(diffuseNr++);
-        } else if (name == "texture_specular") {
-            number = std::to_string(specularNr++);
-        } else if (name == "texture_normal") {
-            number = std::to_string(normalNr++);
-        } else if (name == "texture_height") {
-            number = std::to_string(heightNr++);
-        } else if (name == "texture_roughness") {
-            number = std::to_string(roughnessNr++);
-        } else if (name == "texture_metalness") {
-            number = std::to_string(metalnessNr++);
-        } else if (name == "texture_emission") {
-            number = std::to_string(emissionNr++);
+// sampler name prefix of each TextureSlot; the shaders declare the first map of
+// each kind, e.g. uniform sampler2D texture_diffuse1
+static const char* const TEXTURE_SLOT_NAMES[TEXTURE_SLOT_COUNT] = {
+    "texture_diffuse",
+    "texture_specular",
+    "texture_normal",
+    "texture_height",
+    "texture_roughness",
+    "texture_metalness",
+    "texture_emission"
+};
+
+void AssimpMesh::registerSamplerUnits() {
+    for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+        Program::setSamplerUnit(std::string(TEXTURE_SLOT_NAMES[slot]) + "1", slot);
+    }
+    // tex_frag0 samples the diffuse map as Texture0
+    Program::setSamplerUnit("Texture0", TEXTURE_SLOT_DIFFUSE);
+}
+
+// resolves texture types like "texture_diffuse" or "texture_diffuse1" to units once,
+// instead of building sampler names and looking them up on every draw
+void AssimpMesh::updateTextureBindings() {
+    textureBindings.clear();
+    unsigned int counts[TEXTURE_SLOT_COUNT] = {};
+
+    for (const auto& texture : textures) {
+        // unnumbered types are numbered in the order they appear
+        size_t digits = texture.type.find_last_not_of("0123456789") + 1;
+        std::string kind = texture.type.substr(0, digits);
+        for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+            if (kind != TEXTURE_SLOT_NAMES[slot]) {
+                continue;
+            }
+            unsigned int number = digits < texture.type.size() ? std::stoul(texture.type.substr(digits)) : ++counts[slot];
+            // only the first map of a kind has a sampler
+            if (number != 1) {
+                break;
+            }
+            // a later texture of the same kind overrides, e.g. one set with AssimpModel::assignTexture
+            auto existing = std::find_if(textureBindings.begin(), textureBindings.end(),
+                [slot](const TextureBinding& binding) { return binding.unit == (GLuint)slot; });
+            if (existing != textureBindings.end()) {
+                existing->texture = texture.id;
+            } else {
+                textureBindings.push_back({ (GLuint)slot, texture.id });
+            }
+            break;
+        }
+    }
+
+    shaderFeatures = skinned ? SHADER_FEATURE_SKINNED : 0;
+    if (getTexture(TEXTURE_SLOT_DIFFUSE)) {
+        shaderFeatures |= SHADER_FEATURE_DIFFUSE_MAP;
+        if (getTexture(TEXTURE_SLOT_SPECULAR)) shaderFeatures |= SHADER_FEATURE_SPECULAR_MAP;
+        if (getTexture(TEXTURE_SLOT_ROUGHNESS)) shaderFeatures |= SHADER_FEATURE_ROUGHNESS_MAP;
+        if (getTexture(TEXTURE_SLOT_METALNESS)) shaderFeatures |= SHADER_FEATURE_METALNESS_MAP;
+        if (getTexture(TEXTURE_SLOT_EMISSION)) shaderFeatures |= SHADER_FEATURE_EMISSION_MAP;
+    }
+}
+
+GLuint AssimpMesh::getTexture(TextureSlot slot) const {
+    for (const TextureBinding& binding : textureBindings) {
+        if (binding.unit == (GLuint)slot) {
+            return binding.texture;
         }
+    }
+    return 0;
+}
 
-        glUniform1i(glGetUniformLocation(prog->getPid(), (name + number).c_str()), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+// render the mesh at the given level of detail, clamped to the coarsest level available
+void AssimpMesh::Draw(int lod) const {
+    // sampler units were assigned when the program linked, only the textures change per mesh
+    for (const TextureBinding& binding : textureBindings) {
+        // meshes sharing a texture on the same unit skip the rebind
+        GLState::bindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
     }
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    DrawGeometry(lod);
+}
+
+void AssimpMesh::DrawGeometry(int lod) const {
+    IndexedGeometry geometry = getGeometry(lod);
+    GLState::bindVertexArray(geometry.vertexArray);
+    glDrawElements(GL_TRIANGLES, geometry.indexCount, geometry.indexType, (void*)geometry.indexOffset);
+}
+
+void AssimpMesh::DrawInstanced(const InstanceBuffer& instances, long offset, GLsizei count, int lod) const {
+    for (const TextureBinding& binding : textureBindings) {
+        GLState::bindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
+    }
+
+    IndexedGeometry geometry = getGeometry(lod);
+    instances.bindAttributes(geometry.vertexArray, offset);
+    glDrawElementsInstanced(GL_TRIANGLES, geometry.indexCount, geometry.indexType, (void*)geometry.indexOffset, count);
+}
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+IndexedGeometry AssimpMesh::getGeometry(int lod) const {
+    const MeshLod& level = lods[std::min(std::max(lod, 0), getLodCount() - 1)];
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    IndexedGeometry geometry;
+    geometry.vertexArray = VAO;
+    geometry.indexType = indexType;
+    geometry.indexCount = level.indexCount;
+    geometry.indexOffset = level.indexOffset * indexSize;
+    return geometry;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ASSIMPMESH_H
 #define ASSIMPMESH_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -8,9 +9,12 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Program.h"
+#include "MeshOptimizer.h"
 
 #define MAX_BONE_INFLUENCE 4
 
+class InstanceBuffer;
+
 
 struct Vertex {
     glm::vec3 Position;
@@ -23,24 +27,119 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// A range of the mesh index buffer holding one level of detail
+typedef MeshOptimizer::LodRange MeshLod;
+
+// What CPU-side geometry a mesh keeps once its buffers are on the GPU
+enum MeshRetention {
+    RETAIN_ALL,       // keep vertices and indices
+    RETAIN_POSITIONS, // keep compact positions and LOD 0 indices for collision queries
+    RETAIN_BOUNDS     // keep only the bounding box
+};
+
 struct AssimpTexture {
     unsigned int id;
     std::string type;
     std::string path;
 };
 
+// Texture unit of each kind of map, the same in every program. Samplers named
+// texture_diffuse1, texture_specular1, ... get these units once when a program
+// links (see AssimpMesh::registerSamplerUnits), so drawing only binds textures.
+enum TextureSlot {
+    TEXTURE_SLOT_DIFFUSE,
+    TEXTURE_SLOT_SPECULAR,
+    TEXTURE_SLOT_NORMAL,
+    TEXTURE_SLOT_HEIGHT,
+    TEXTURE_SLOT_ROUGHNESS,
+    TEXTURE_SLOT_METALNESS,
+    TEXTURE_SLOT_EMISSION,
+    TEXTURE_SLOT_COUNT
+};
+
+// Compile-time shader features a mesh needs, see ShaderVariants. The map
+// features are only set together with the diffuse map, untextured meshes are
+// shaded from their material colors alone.
+enum ShaderFeature {
+    SHADER_FEATURE_SKINNED = 1 << 0,
+    SHADER_FEATURE_DIFFUSE_MAP = 1 << 1,
+    SHADER_FEATURE_SPECULAR_MAP = 1 << 2,
+    SHADER_FEATURE_ROUGHNESS_MAP = 1 << 3,
+    SHADER_FEATURE_METALNESS_MAP = 1 << 4,
+    SHADER_FEATURE_EMISSION_MAP = 1 << 5,
+    // the PerDraw record comes from the instance attributes, see InstanceBuffer;
+    // set by AssimpModel::DrawInstanced, never part of a mesh's own mask
+    SHADER_FEATURE_INSTANCED = 1 << 6
+};
+
+struct TextureBinding {
+    GLuint unit;
+    GLuint texture;
+};
+
+// Everything glDrawElements needs for one level of detail, so a draw can be
+// queued and compared with others without going back to the mesh
+struct IndexedGeometry {
+    GLuint vertexArray = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei indexCount = 0;
+    // in bytes
+    size_t indexOffset = 0;
+};
+
 class AssimpMesh {
     public:
        std::vector<Vertex> vertices;
        std::vector<unsigned int> indices;
        std::vector<AssimpTexture> textures;
-       unsigned int VAO;
+       // textures resolved to their units, rebuilt by updateTextureBindings()
+       std::vector<TextureBinding> textureBindings;
+       // LOD 0 is the full mesh; all levels index into the same vertex buffer
+       std::vector<MeshLod> lods;
+       // filled by releaseCpuData(RETAIN_POSITIONS)
+       std::vector<glm::vec3> positions;
+       glm::vec3 boundsMin, boundsMax;
+       unsigned int VAO = 0;
 
-       AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures);
-       void Draw(const std::shared_ptr<Program> prog) const;
+       // the mesh owns its GL objects, so it can be moved but not copied
+       AssimpMesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<AssimpTexture>&& textures, std::vector<MeshLod>&& lods = {});
+       AssimpMesh(AssimpMesh&& other) noexcept;
+       AssimpMesh& operator=(AssimpMesh&& other) noexcept;
+       AssimpMesh(const AssimpMesh&) = delete;
+       AssimpMesh& operator=(const AssimpMesh&) = delete;
+       ~AssimpMesh();
+
+       void Draw(int lod = 0) const;
+       // draws without binding the mesh textures, for batched materials
+       void DrawGeometry(int lod = 0) const;
+       // draws count instances written to instances at offset, see InstanceBuffer::unmap()
+       void DrawInstanced(const InstanceBuffer& instances, long offset, GLsizei count, int lod = 0) const;
+       // the index range DrawGeometry(lod) draws
+       IndexedGeometry getGeometry(int lod = 0) const;
+       // the texture bound to slot, 0 when the mesh has none
+       GLuint getTexture(TextureSlot slot) const;
+       // ShaderFeature mask of the leanest shader variant that can draw this mesh
+       uint32_t getShaderFeatures() const { return shaderFeatures; }
+       // call after changing textures
+       void updateTextureBindings();
+       // registers the sampler unit of every TextureSlot; call before linking programs
+       static void registerSamplerUnits();
+       int getLodCount() const { return lods.size(); }
+       unsigned int getVertexCount() const { return vertexCount; }
+
+       // frees CPU copies of geometry that is only needed by the GPU
+       void releaseCpuData(MeshRetention retention);
 
     private:
-        unsigned int VBO, EBO;
+        unsigned int VBO = 0, EBO = 0;
+        // GL_UNSIGNED_SHORT when every index fits in 16 bits
+        GLenum indexType = GL_UNSIGNED_INT;
+        unsigned int vertexCount = 0;
+        // any vertex weighted to a bone
+        bool skinned = false;
+        uint32_t shaderFeatures = 0;
+
+        void destroyBuffers();
 
         void setupMesh();
 };
@@ -3,10 +3,182 @@
 #include <iostream>
 #include "stb_image.h"
 #include "AssimpGLMHelpers.h"
+#include "MeshOptimizer.h"
+#include "GLState.h"
+#include "PackIOSystem.h"
+#include "CookedFormats.h"
+#include <cstddef>
+#include <cstring>
 #include <filesystem>
 
+// projected height in pixels at which a model switches away from LOD 0; each
+// further level halves the size and roughly halves the triangle count
+static const float LOD_PIXEL_THRESHOLD = 240.0f;
+
+// cooked vertices are copied into Vertex byte for byte, so the layouts must stay identical
+static_assert(sizeof(Vertex) == sizeof(Cooked::CookedVertex), "Vertex and Cooked::CookedVertex layouts differ");
+static_assert(offsetof(Vertex, m_BoneIDs) == offsetof(Cooked::CookedVertex, boneIds), "Vertex and Cooked::CookedVertex layouts differ");
+
+// block compressed formats of cooked textures that glad does not define (EXT_texture_compression_s3tc, EXT_texture_sRGB)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+    // Reads a cooked file from a pack view. Every read is bounds checked; one past
+    // the end marks the reader failed and yields zeros from then on.
+    class CookedReader {
+        public:
+            explicit CookedReader(ResourceView view) : data(view.data), size(view.size) {}
+
+            template <typename T>
+            T read() {
+                T value{};
+                readBytes(&value, sizeof(T));
+                return value;
+            }
+
+            void readBytes(void *out, uint64_t count) {
+                const unsigned char *bytes = skip(count);
+                if (bytes && count) {
+                    std::memcpy(out, bytes, count);
+                }
+            }
+
+            std::string readString() {
+                uint32_t length = read<uint32_t>();
+                const unsigned char *bytes = skip(length);
+                return bytes ? std::string(reinterpret_cast<const char *>(bytes), length) : std::string();
+            }
+
+            // the next count bytes in place, nullptr past the end
+            const unsigned char *skip(uint64_t count) {
+                if (failed || count > size - position) {
+                    failed = true;
+                    return nullptr;
+                }
+                const unsigned char *bytes = data + position;
+                position += count;
+                return bytes;
+            }
+
+            bool canRead(uint64_t count) const { return !failed && count <= size - position; }
+            bool atEnd() const { return !failed && position == size; }
+            bool failed = false;
+
+        private:
+            const unsigned char *data;
+            size_t size;
+            size_t position = 0;
+    };
+
+    struct CookedTextureRef {
+        std::string type;
+        std::string path;
+        int32_t embedded;
+    };
+
+    struct CookedMeshData {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<MeshLod> lods;
+        std::vector<CookedTextureRef> textures;
+    };
+
+    bool hasExtension(const char *name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && std::strcmp(extension, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-AssimpModel::AssimpModel(std::string const &path, bool gamma) : gammaCorrection(gamma) {
+    // Uploads a cooked .tex with its whole mip chain. Returns 0 when view is empty
+    // or holds nothing this context can use, the caller then loads the source image.
+    unsigned int loadCookedTexture(ResourceView view, bool gamma, const std::string& name) {
+        if (!view) {
+            return 0;
+        }
+        static const bool s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+        static const bool s3tcSrgb = s3tc && hasExtension("GL_EXT_texture_sRGB");
+
+        CookedReader reader(view);
+        Cooked::CookedHeader header = reader.read<Cooked::CookedHeader>();
+        Cooked::TextureHeader texture = reader.read<Cooked::TextureHeader>();
+        if (reader.failed || header.magic != Cooked::TEXTURE_MAGIC || header.version != Cooked::COOKED_FORMAT_VERSION) {
+            std::cerr << "Ignoring cooked texture of " << name << ", it is not a version " << Cooked::COOKED_FORMAT_VERSION << " .tex" << std::endl;
+            return 0;
+        }
+
+        GLenum format;
+        uint64_t blockBytes = 8;
+        switch (texture.format) {
+            case Cooked::TEXTURE_BC1:
+                format = gamma ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                break;
+            case Cooked::TEXTURE_BC3:
+                format = gamma ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                blockBytes = 16;
+                break;
+            case Cooked::TEXTURE_BC4:
+                format = GL_COMPRESSED_RED_RGTC1;
+                break;
+            default:
+                return 0;
+        }
+        if (texture.format != Cooked::TEXTURE_BC4 && !(gamma ? s3tcSrgb : s3tc)) {
+            return 0;
+        }
+
+        // check every level before creating the texture, a damaged file leaves nothing behind
+        std::vector<const unsigned char *> levels;
+        uint64_t width = texture.width, height = texture.height;
+        for (uint32_t mip = 0; mip < texture.mipCount && width > 0 && height > 0; mip++) {
+            uint32_t byteSize = reader.read<uint32_t>();
+            if (byteSize != (width + 3) / 4 * ((height + 3) / 4) * blockBytes) {
+                break;
+            }
+            levels.push_back(reader.skip(byteSize));
+            width = std::max<uint64_t>(1, width / 2);
+            height = std::max<uint64_t>(1, height / 2);
+        }
+        if (levels.empty() || levels.size() != texture.mipCount || !reader.atEnd()) {
+            std::cerr << "Ignoring damaged cooked texture of " << name << std::endl;
+            return 0;
+        }
+
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::bindTextureForEdit(GL_TEXTURE_2D, textureID);
+        GLsizei levelWidth = texture.width, levelHeight = texture.height;
+        for (GLint mip = 0; mip < (GLint)levels.size(); mip++) {
+            GLsizei byteSize = (levelWidth + 3) / 4 * ((levelHeight + 3) / 4) * (GLsizei)blockBytes;
+            glCompressedTexImage2D(GL_TEXTURE_2D, mip, format, levelWidth, levelHeight, 0, byteSize, levels[mip]);
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        std::cout << "Loaded cooked texture: " << name << " (" << texture.width << "x" << texture.height << ", "
+            << levels.size() << " levels)" << std::endl;
+        return textureID;
+    }
+}
+
+AssimpModel::AssimpModel(std::string const &path, bool gamma, MeshRetention retention) : gammaCorrection(gamma), meshRetention(retention) {
     loadModel(path);
     // std::cout << "Model: " << path << " loaded" << std::endl;
 }
@@ -14,16 +186,126 @@ AssimpModel::AssimpModel(std::string const &path, bool gamma) : gammaCorrection(
 AssimpModel::~AssimpModel() {
 }
 
-void AssimpModel::Draw(const std::shared_ptr<Program> prog) const {
+void AssimpModel::Draw(const std::shared_ptr<Program> prog, int lod) const {
     // std::cout << "Mesh size: " << meshes.size() << std::endl;
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(prog);
+        meshes[i].Draw(lod);
         // std::cout << "Drawing mesh: " << i << std::endl;
     }
 }
 
+void AssimpModel::Draw(const std::shared_ptr<Program> prog, const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight) const {
+    Draw(prog, selectLod(modelView, projection, viewportHeight));
+}
+
+void AssimpModel::Draw(ShaderVariants& variants, int lod) const {
+    for (const AssimpMesh& mesh : meshes) {
+        std::shared_ptr<Program> prog = variants.get(mesh.getShaderFeatures());
+        if (!prog) {
+            continue;
+        }
+        // meshes sharing a variant keep the program bound
+        prog->bind();
+        mesh.Draw(lod);
+    }
+}
+
+long AssimpModel::writeInstances(InstanceBuffer& instances, const glm::mat4* transforms, size_t count, const InstanceParams* params) const {
+    InstanceBuffer::Instance* data = instances.map(count);
+    if (data) {
+        const InstanceParams defaults;
+        for (size_t i = 0; i < count; i++) {
+            const InstanceParams& instance = params ? params[i] : defaults;
+            data[i].M = transforms[i];
+            data[i].materialIndex = instance.materialIndex;
+            data[i].flags = instance.flags;
+            data[i].layer = instance.layer;
+            data[i].padding = 0;
+            data[i].uvTransform = instance.uvTransform;
+        }
+    }
+    return instances.unmap();
+}
+
+void AssimpModel::DrawInstanced(const std::shared_ptr<Program> prog, InstanceBuffer& instances, const glm::mat4* transforms, size_t count,
+                                const InstanceParams* params, int lod) const {
+    if (count == 0) {
+        return;
+    }
+    long offset = writeInstances(instances, transforms, count, params);
+    if (offset < 0) {
+        return;
+    }
+    prog->bind();
+    for (const AssimpMesh& mesh : meshes) {
+        mesh.DrawInstanced(instances, offset, (GLsizei)count, lod);
+    }
+}
+
+void AssimpModel::DrawInstanced(ShaderVariants& variants, InstanceBuffer& instances, const glm::mat4* transforms, size_t count,
+                                const InstanceParams* params, int lod) const {
+    if (count == 0) {
+        return;
+    }
+    long offset = writeInstances(instances, transforms, count, params);
+    if (offset < 0) {
+        return;
+    }
+    for (const AssimpMesh& mesh : meshes) {
+        std::shared_ptr<Program> prog = variants.get(mesh.getShaderFeatures() | SHADER_FEATURE_INSTANCED);
+        if (!prog) {
+            continue;
+        }
+        prog->bind();
+        mesh.DrawInstanced(instances, offset, (GLsizei)count, lod);
+    }
+}
+
+int AssimpModel::selectLod(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight) const {
+    if (meshes.empty() || boundingBoxMin.x > boundingBoxMax.x) {
+        return 0;
+    }
+
+    // bounding sphere of the model in view space
+    glm::vec3 center = 0.5f * (boundingBoxMin + boundingBoxMax);
+    float radius = 0.5f * glm::length(boundingBoxMax - boundingBoxMin);
+    float scale = std::max(glm::length(glm::vec3(modelView[0])), std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+    glm::vec3 viewCenter = glm::vec3(modelView * glm::vec4(center, 1.0f));
+
+    float viewRadius = radius * scale;
+    float distance = -viewCenter.z;
+    if (distance <= viewRadius) {
+        return 0; // camera is inside or touching the bounds
+    }
+
+    // projection[1][1] is cot(fovy / 2), so this is the sphere's height in pixels
+    float pixelSize = viewRadius * projection[1][1] * viewportHeight / distance;
+
+    int lod = 0;
+    for (float threshold = LOD_PIXEL_THRESHOLD; pixelSize < threshold && lod < getLodCount() - 1; threshold *= 0.5f) {
+        lod++;
+    }
+    return lod;
+}
+
+int AssimpModel::getLodCount() const {
+    int count = 1;
+    for (const auto& mesh : meshes) {
+        count = std::max(count, mesh.getLodCount());
+    }
+    return count;
+}
+
 void AssimpModel::loadModel(std::string const &path) {
+    if (loadCookedModel(path)) {
+        return;
+    }
+
     Assimp::Importer importer;
+    if (ResourcePack::isMounted()) {
+        // the importer owns and deletes its IO handler
+        importer.SetIOHandler(new PackIOSystem());
+    }
     // importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
     // importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.0f);
     const aiScene *scene = importer.ReadFile(path,
@@ -74,6 +356,7 @@ void AssimpModel::loadModel(std::string const &path) {
     // boundingBoxMin = glm::vec3(std::numeric_limits<float>::max());
     // boundingBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
 
+    meshes.reserve(scene->mNumMeshes);
     processNode(scene->mRootNode, scene);
 
     // after processing all nodes, we can calculate the bounding box
@@ -82,6 +365,127 @@ void AssimpModel::loadModel(std::string const &path) {
     std::cout<<"Model loaded"<<std::endl;
 }
 
+bool AssimpModel::loadCookedModel(std::string const &path) {
+    std::string name;
+    if (!ResourcePack::getPackName(path, name)) {
+        return false;
+    }
+    ResourceView view = ResourcePack::findName(Cooked::PACK_PREFIX + name + ".mesh");
+    if (!view) {
+        return false;
+    }
+
+    CookedReader reader(view);
+    Cooked::CookedHeader header = reader.read<Cooked::CookedHeader>();
+    if (reader.failed || header.magic != Cooked::MESH_MAGIC || header.version != Cooked::COOKED_FORMAT_VERSION) {
+        std::cerr << "Ignoring cooked mesh of " << path << ", it is not a version " << Cooked::COOKED_FORMAT_VERSION << " .mesh" << std::endl;
+        return false;
+    }
+    Cooked::MeshFileHeader fileHeader = reader.read<Cooked::MeshFileHeader>();
+
+    // parse everything before touching the model, so a damaged file falls back to the source cleanly
+    std::map<std::string, BoneInfo> boneInfoMap;
+    bool valid = true;
+    for (uint32_t i = 0; i < fileHeader.boneCount && valid; i++) {
+        std::string boneName = reader.readString();
+        BoneInfo info;
+        info.id = (int)reader.read<uint32_t>();
+        float offset[16];
+        reader.readBytes(offset, sizeof(offset));
+        info.offset = glm::make_mat4(offset);
+        valid = !reader.failed && (uint32_t)info.id < fileHeader.boneCount && boneInfoMap.emplace(boneName, info).second;
+    }
+
+    std::vector<CookedMeshData> cookedMeshes;
+    for (uint32_t m = 0; m < fileHeader.meshCount && valid; m++) {
+        Cooked::MeshHeader meshHeader = reader.read<Cooked::MeshHeader>();
+        reader.readString();
+        CookedMeshData mesh;
+        for (uint32_t t = 0; t < meshHeader.textureCount && !reader.failed; t++) {
+            CookedTextureRef texture;
+            texture.type = reader.readString();
+            texture.path = reader.readString();
+            texture.embedded = reader.read<int32_t>();
+            mesh.textures.push_back(std::move(texture));
+        }
+        for (uint32_t l = 0; l < meshHeader.lodCount && valid; l++) {
+            Cooked::LodRecord lod = reader.read<Cooked::LodRecord>();
+            valid = !reader.failed && (uint64_t)lod.indexOffset + lod.indexCount <= meshHeader.indexCount;
+            mesh.lods.push_back({ lod.indexOffset, lod.indexCount, lod.error });
+        }
+
+        bool shortIndices = meshHeader.vertexCount <= 65536;
+        uint64_t indexBytes = (uint64_t)meshHeader.indexCount * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t));
+        if (!valid || !reader.canRead((uint64_t)meshHeader.vertexCount * sizeof(Vertex) + indexBytes)) {
+            valid = false;
+            break;
+        }
+        mesh.vertices.resize(meshHeader.vertexCount);
+        reader.readBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        mesh.indices.resize(meshHeader.indexCount);
+        if (shortIndices) {
+            const unsigned char *indices = reader.skip(indexBytes);
+            for (size_t i = 0; i < mesh.indices.size(); i++) {
+                uint16_t index;
+                std::memcpy(&index, indices + i * sizeof(uint16_t), sizeof(uint16_t));
+                mesh.indices[i] = index;
+            }
+        }
+        else {
+            reader.readBytes(mesh.indices.data(), indexBytes);
+        }
+        for (unsigned int index : mesh.indices) {
+            valid = valid && index < meshHeader.vertexCount;
+        }
+        cookedMeshes.push_back(std::move(mesh));
+    }
+    if (!valid || !reader.atEnd()) {
+        std::cerr << "Ignoring damaged cooked mesh of " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Loading cooked model: " << path << std::endl;
+    directory = path.substr(0, path.find_last_of('/'));
+    m_BoneInfoMap = std::move(boneInfoMap);
+    m_BoneCounter = (int)fileHeader.boneCount;
+    boundingBoxMin = glm::make_vec3(fileHeader.boundsMin);
+    boundingBoxMax = glm::make_vec3(fileHeader.boundsMax);
+
+    meshes.reserve(cookedMeshes.size());
+    for (CookedMeshData& mesh : cookedMeshes) {
+        // the same sharing of textures between meshes as loadMaterialTextures
+        std::vector<AssimpTexture> textures;
+        for (const CookedTextureRef& ref : mesh.textures) {
+            auto loaded = std::find_if(textures_loaded.begin(), textures_loaded.end(), [&](const AssimpTexture& texture) { return texture.path == ref.path; });
+            if (loaded != textures_loaded.end()) {
+                textures.push_back(*loaded);
+                continue;
+            }
+            AssimpTexture texture;
+            texture.type = ref.type;
+            texture.path = ref.path;
+            if (ref.embedded >= 0) {
+                std::string embeddedName = Cooked::PACK_PREFIX + name + ".emb" + std::to_string(ref.embedded) + ".tex";
+                texture.id = loadCookedTexture(ResourcePack::findName(embeddedName), false, embeddedName);
+                if (texture.id == 0) {
+                    std::cerr << "Embedded texture " << ref.path << " of " << path << " was not cooked" << std::endl;
+                }
+            }
+            else {
+                texture.id = AssimpTextureFromFile(ref.path.c_str(), directory);
+            }
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
+        }
+
+        meshes.push_back(AssimpMesh(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures), std::move(mesh.lods)));
+        meshes.back().releaseCpuData(meshRetention);
+    }
+
+    std::cout << "Loaded cooked model: " << path << " (" << meshes.size() << " meshes, " << m_BoneCounter << " bones)" << std::endl;
+    return true;
+}
+
 void AssimpModel::processNode(aiNode* node, const aiScene* scene) {
 
     // Process all the node's meshes (if any)
@@ -90,6 +494,7 @@ void AssimpModel::processNode(aiNode* node, const aiScene* scene) {
         // std::cout<<"Processing node: "<<i<<std::endl;
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         meshes.push_back(processMesh(mesh, scene));
+        meshes.back().releaseCpuData(meshRetention);
     }
 
     // std::cout<<"Node processed"<<std::endl;
@@ -118,6 +523,8 @@ std::vector<AssimpTexture> AssimpModel::loadMaterialTextures(aiMaterial* mat, ai
         }
         if (!skip) {
             AssimpTexture texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
 
             // Check if the texture is embedded in the model
             const aiTexture* embeddedTexture = scene->GetEmbeddedTexture(str.C_Str());
@@ -154,11 +561,26 @@ unsigned int AssimpTextureFromFile(const char* path, const std::string& director
 
     std::cout << "Attempting to load texture: " << filename << std::endl;
 
+    std::string packName;
+    if (ResourcePack::getPackName(filename, packName)) {
+        unsigned int cookedID = loadCookedTexture(ResourcePack::findName(Cooked::PACK_PREFIX + packName + ".tex"), gamma, filename);
+        if (cookedID) {
+            return cookedID;
+        }
+    }
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char* data;
+    ResourceView packed = ResourcePack::find(filename);
+    if (packed) {
+        data = stbi_load_from_memory(packed.data, static_cast<int>(packed.size), &width, &height, &nrComponents, 0);
+    }
+    else {
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    }
 
     if (data) {
         GLenum format;
@@ -182,7 +604,7 @@ unsigned int AssimpTextureFromFile(const char* path, const std::string& director
             std::cout << "Unusual number of components in image: " << nrComponents << std::endl;
         }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::bindTextureForEdit(GL_TEXTURE_2D, textureID);
 
         // Use internalFormat to handle gamma correction properly
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
@@ -203,7 +625,7 @@ unsigned int AssimpTextureFromFile(const char* path, const std::string& director
         std::cerr << "STB_Image error: " << stbi_failure_reason() << std::endl;
 
         // Check if file exists
-        if (std::filesystem::exists(filename)) {
+        if (packed || std::filesystem::exists(filename)) {
             std::cerr << "File exists but could not be loaded as an image" << std::endl;
         }
         else {
@@ -237,7 +659,7 @@ unsigned int AssimpModel::loadEmbeddedTexture(const aiTexture* embeddedTexture)
             else if (channels == 4) format = GL_RGBA;
             else format = GL_RGB;
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
+            GLState::bindTextureForEdit(GL_TEXTURE_2D, textureID);
             glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -255,7 +677,7 @@ unsigned int AssimpModel::loadEmbeddedTexture(const aiTexture* embeddedTexture)
     }
     else {
         // Uncompressed texture data (raw pixels)
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::bindTextureForEdit(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
             embeddedTexture->mWidth, embeddedTexture->mHeight,
             0, GL_RGBA, GL_UNSIGNED_BYTE, embeddedTexture->pcData);
@@ -312,6 +734,7 @@ void AssimpModel::assignTexture(const std::string& type, const std::string& path
         if (!found) {
             mesh.textures.push_back(texture);
         }
+        mesh.updateTextureBindings();
     }
 
     std::cout << "Manually assigned texture: " << path << " as " << type << std::endl;
@@ -329,6 +752,9 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
     std::vector<unsigned int> indices;
     std::vector<AssimpTexture> textures;
 
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
+
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
         Vertex vertex;
         SetVertexBoneDataToDefault(vertex);
@@ -346,6 +772,16 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
         }
 
+        // always initialize tangents so identical vertices compare equal when deduplicating
+        if (mesh->mTangents && mesh->mBitangents) {
+            vertex.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+            vertex.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+        }
+        else {
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+
         // std::cout << "Processing vertex: " << i << std::endl;
 
         vertices.push_back(vertex);
@@ -355,7 +791,7 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
         // boundingBoxMax = glm::max(boundingBoxMax, vertex.Position);
     }
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++) {
             indices.push_back(face.mIndices[j]);
         }
@@ -365,37 +801,41 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
 
     // diffuse maps
     std::vector<AssimpTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", scene);
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(diffuseMaps.begin()), std::make_move_iterator(diffuseMaps.end()));
 
     // specular maps
     std::vector<AssimpTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", scene);
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(specularMaps.begin()), std::make_move_iterator(specularMaps.end()));
 
     // normal maps
     std::vector<AssimpTexture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", scene);
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(normalMaps.begin()), std::make_move_iterator(normalMaps.end()));
 
     // height maps
     std::vector<AssimpTexture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", scene);
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(heightMaps.begin()), std::make_move_iterator(heightMaps.end()));
 
     // roughness maps
     std::vector<AssimpTexture> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness", scene);
-    textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(roughnessMaps.begin()), std::make_move_iterator(roughnessMaps.end()));
 
     // metalness maps
     std::vector<AssimpTexture> metalnessMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_metalness", scene);
-    textures.insert(textures.end(), metalnessMaps.begin(), metalnessMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(metalnessMaps.begin()), std::make_move_iterator(metalnessMaps.end()));
 
     // emission maps
     std::vector<AssimpTexture> emissionMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emission", scene);
-    textures.insert(textures.end(), emissionMaps.begin(), emissionMaps.end());
+    textures.insert(textures.end(), std::make_move_iterator(emissionMaps.begin()), std::make_move_iterator(emissionMaps.end()));
 
     ExtractBoneWeightForVertices(vertices, mesh, scene);
 
+    // bone weights are indexed by the source vertex order, so optimize only after extracting them
+    std::vector<MeshLod> lods;
+    optimizeMesh(vertices, indices, lods, mesh->mName.C_Str());
+
     // std::cout << "Mesh processed" << std::endl;
 
-    return AssimpMesh(vertices, indices, textures);
+    return AssimpMesh(std::move(vertices), std::move(indices), std::move(textures), std::move(lods));
 }
 
 void AssimpModel::SetVertexBoneData(Vertex& vertex, int boneID, float weight) {
@@ -470,13 +910,58 @@ void AssimpModel::ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, ai
 
 }
 
+void AssimpModel::optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, const std::string& name) {
+    lods.clear();
+    if (vertices.empty() || indices.empty()) {
+        return;
+    }
+
+    size_t sourceVertexCount = vertices.size();
+    float acmrBefore = MeshOptimizer::analyzeACMR(indices, vertices.size());
+
+    // fold identical vertices (Assimp emits unshared vertices per face for most formats)
+    std::vector<unsigned int> remap;
+    size_t uniqueCount = MeshOptimizer::generateVertexRemap(remap, vertices.data(), vertices.size(), sizeof(Vertex));
+    MeshOptimizer::remapIndices(indices, remap);
+    MeshOptimizer::remapVertices(vertices, remap, uniqueCount);
+
+    // the dominant bone of each vertex keeps collapses from dragging skin across bone regions
+    std::vector<unsigned int> dominantBone(vertices.size(), MeshOptimizer::INVALID_INDEX);
+    bool skinned = false;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        float bestWeight = 0.0f;
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            if (vertices[i].m_BoneIDs[j] >= 0 && vertices[i].m_Weights[j] > bestWeight) {
+                bestWeight = vertices[i].m_Weights[j];
+                dominantBone[i] = vertices[i].m_BoneIDs[j];
+                skinned = true;
+            }
+        }
+    }
+
+    // each level targets half the triangles of the previous one, all sharing one index buffer
+    MeshOptimizer::buildLodChain(indices, lods, &vertices[0].Position.x, sizeof(Vertex), vertices.size(),
+        MeshOptimizer::MAX_LODS, MeshOptimizer::LOD_MAX_ERROR, skinned ? dominantBone.data() : nullptr);
+    float acmrAfter = MeshOptimizer::analyzeACMR(std::vector<unsigned int>(indices.begin(), indices.begin() + lods[0].indexCount), vertices.size());
+
+    // vertex order for fetch locality, this also drops unreferenced vertices
+    size_t fetchCount = MeshOptimizer::generateVertexFetchRemap(remap, indices, vertices.size());
+    MeshOptimizer::remapIndices(indices, remap);
+    MeshOptimizer::remapVertices(vertices, remap, fetchCount);
+
+    std::cout << "Optimized mesh '" << name << "': " << sourceVertexCount << " -> " << vertices.size() << " vertices, "
+        << lods[0].indexCount / 3 << " triangles, ACMR " << acmrBefore << " -> " << acmrAfter
+        << (vertices.size() <= 65536 ? ", 16-bit indices" : ", 32-bit indices") << std::endl;
+    for (size_t i = 1; i < lods.size(); i++) {
+        std::cout << "  LOD " << i << ": " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+    }
+}
+
 void AssimpModel::calculateBoundingBox() {
-    // Iterate over all meshes and their vertices to find the min and max coordinates
+    // Meshes keep their bounds even after CPU geometry is released
     for (const auto& mesh : meshes) {
-        for (const auto& vertex : mesh.vertices) {
-            boundingBoxMin = glm::min(boundingBoxMin, vertex.Position);
-            boundingBoxMax = glm::max(boundingBoxMax, vertex.Position);
-        }
+        boundingBoxMin = glm::min(boundingBoxMin, mesh.boundsMin);
+        boundingBoxMax = glm::max(boundingBoxMax, mesh.boundsMax);
     }
 }
 
@@ -486,7 +971,7 @@ int AssimpModel::getMeshCount() const {
 
 int AssimpModel::getMeshSize(int meshIndex) const {
     if (meshIndex >= 0 && meshIndex < meshes.size()) {
-        return meshes[meshIndex].vertices.size();
+        return meshes[meshIndex].getVertexCount();
     }
     return 0; // Return 0 if mesh index is out of bounds
 }
@@ -12,6 +12,8 @@
 #include <assimp/postprocess.h>
 
 #include "AssimpMesh.h" // Include AssimpMesh.h to use AssimpMesh class
+#include "InstanceBuffer.h"
+#include "ShaderVariants.h"
 
 using namespace glm;
 
@@ -25,12 +27,36 @@ struct BoneInfo {
     mat4 offset;
 };
 
+// Per-instance fields of DrawInstanced besides the transform, as in DrawRecords
+struct InstanceParams {
+    GLint materialIndex = 0;
+    GLuint flags = 0;
+    GLint layer = 0;
+    glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
 class AssimpModel {
     public:
-        AssimpModel(std::string const &path, bool gamma = false);
+        // retention controls which CPU-side geometry the meshes keep after upload
+        AssimpModel(std::string const &path, bool gamma = false, MeshRetention retention = RETAIN_ALL);
         ~AssimpModel();
 
-        void Draw(const std::shared_ptr<Program> prog) const;
+        void Draw(const std::shared_ptr<Program> prog, int lod = 0) const;
+        // draws at the level of detail chosen from the model's projected size on screen
+        void Draw(const std::shared_ptr<Program> prog, const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight) const;
+        // draws every mesh with the variant matching its ShaderFeature mask
+        void Draw(ShaderVariants& variants, int lod = 0) const;
+        // Draws count copies of the model, one instanced draw per mesh. params holds count
+        // entries or is nullptr for InstanceParams() everywhere. prog has to be built with
+        // INSTANCED; the ShaderVariants overload adds SHADER_FEATURE_INSTANCED itself.
+        void DrawInstanced(const std::shared_ptr<Program> prog, InstanceBuffer& instances, const glm::mat4* transforms, size_t count,
+                           const InstanceParams* params = nullptr, int lod = 0) const;
+        void DrawInstanced(ShaderVariants& variants, InstanceBuffer& instances, const glm::mat4* transforms, size_t count,
+                           const InstanceParams* params = nullptr, int lod = 0) const;
+
+        // picks a LOD from the projected screen-space height (in pixels) of the model's bounding sphere
+        int selectLod(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight) const;
+        int getLodCount() const;
 
 
         auto& GetBoneInfoMap() { return m_BoneInfoMap; }
@@ -40,9 +66,10 @@ class AssimpModel {
         std::string directory;
         std::vector<AssimpTexture> textures_loaded;
         bool gammaCorrection;
+        MeshRetention meshRetention;
 
         glm::vec3 boundingBoxMin = glm::vec3(std::numeric_limits<float>::infinity());
-        glm::vec3 boundingBoxMax;
+        glm::vec3 boundingBoxMax = glm::vec3(-std::numeric_limits<float>::infinity());
 
         void assignTexture(const std::string& type, const std::string& path);
 
@@ -54,6 +81,11 @@ class AssimpModel {
 
     private:
         void loadModel(std::string const &path);
+        // builds the model from the cooked .mesh of path in the mounted pack, see
+        // tools/AssetCooker.cpp; false when there is none or it cannot be used
+        bool loadCookedModel(std::string const &path);
+        // writes the instances once for every mesh, -1 when nothing could be written
+        long writeInstances(InstanceBuffer& instances, const glm::mat4* transforms, size_t count, const InstanceParams* params) const;
         void processNode(aiNode *node, const aiScene *scene);
         AssimpMesh processMesh(aiMesh *mesh, const aiScene *scene);
         std::vector<AssimpTexture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, const aiScene *scene);
@@ -67,6 +99,7 @@ class AssimpModel {
         void SetVertexBoneDataToDefault(Vertex& vertex);
         void SetVertexBoneData(Vertex& vertex, int boneID, float weight);
         void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh *mesh, const aiScene *scene);
+        void optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, const std::string& name);
         void calculateBoundingBox();
 
         std::vector<aiAABB> m_BoundingBoxes;
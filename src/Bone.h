@@ -34,7 +34,7 @@ class Bone
         Bone(const std::string& name, int ID, const aiNodeAnim* channel);
         void Update(float animationTime);
         glm::mat4 GetLocalTransform() { return m_LocalTransform; }
-        std::string GetBoneName() const { return m_Name; }
+        const std::string& GetBoneName() const { return m_Name; }
         int GetID() { return m_ID; }
         int GetPositionIndex(float animationTime);
         int GetRotationIndex(float animationTime);
@@ -0,0 +1,39 @@
+#include "BoneUniforms.h"
+
+#include <algorithm>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+
+BoneUniforms::~BoneUniforms()
+{
+	if (ubo)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+}
+
+void BoneUniforms::init()
+{
+	Program::setUniformBlockBinding("Bones", BINDING);
+
+	// the block always declares MAX_BONES matrices, so the buffer backs all of them
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW));
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
+
+void BoneUniforms::upload(const std::vector<glm::mat4> &bones)
+{
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	size_t count = std::min<size_t>(bones.size(), MAX_BONES);
+	if (count > 0)
+	{
+		// orphan like the per-frame block, last frame's skinning may still be reading
+		glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat4), bones.data());
+	}
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
@@ -0,0 +1,42 @@
+#pragma  once
+
+#ifndef BONEUNIFORMS_H_INCLUDED
+#define BONEUNIFORMS_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Skinning palette in a std140 uniform buffer, so every skinned shader variant
+// reads the same bones without a per-program upload. Shaders declare:
+//
+//	layout(std140) uniform Bones {
+//		mat4 finalBonesMatrices[MAX_BONES];
+//	};
+class BoneUniforms
+{
+
+public:
+
+	static const GLuint BINDING = 3;
+	// 12.8 KB, inside the 16 KB every GL 4.1 driver allows per block
+	static const int MAX_BONES = 200;
+
+	BoneUniforms() = default;
+	~BoneUniforms();
+	BoneUniforms(const BoneUniforms&) = delete;
+	BoneUniforms& operator=(const BoneUniforms&) = delete;
+
+	// Creates the buffer and registers the block binding; call before linking programs
+	void init();
+	// Writes the palette and binds it to BINDING; bones past MAX_BONES are dropped
+	void upload(const std::vector<glm::mat4> &bones);
+
+private:
+
+	GLuint ubo = 0;
+
+};
+
+#endif // BONEUNIFORMS_H_INCLUDED
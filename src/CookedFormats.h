@@ -0,0 +1,98 @@
+#ifndef COOKEDFORMATS_H
+#define COOKEDFORMATS_H
+
+#include <cstdint>
+
+// Binary layouts written by the AssetCooker tool (tools/AssetCooker.cpp).
+//
+// Every file starts with a CookedHeader. All values are little endian, strings
+// are stored as a uint32_t length followed by the bytes without a terminator.
+// Bump COOKED_FORMAT_VERSION whenever a layout changes; the cooker hashes it
+// into every manifest entry so old outputs are rebuilt automatically, and the
+// game ignores outputs of any other version.
+namespace Cooked
+{
+    const uint32_t COOKED_FORMAT_VERSION = 2;
+
+    // cooked outputs are packed under this prefix, followed by the source path
+    // relative to the resource directory and the output suffix
+    const char *const PACK_PREFIX = "cooked/";
+
+    const uint32_t MESH_MAGIC = 0x4853454d; // "MESH"
+    const uint32_t TEXTURE_MAGIC = 0x58455454; // "TTEX"
+
+    struct CookedHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    // Same memory layout as the runtime Vertex in AssimpMesh.h, so cooked
+    // vertices are copied into a mesh without conversion
+    struct CookedVertex {
+        float position[3];
+        float normal[3];
+        float texCoords[2];
+        float tangent[3];
+        float bitangent[3];
+        int32_t boneIds[4];
+        float weights[4];
+    };
+
+    // .mesh file:
+    //   CookedHeader
+    //   MeshFileHeader
+    //   boneCount x { string name, uint32_t id, float offset[16] (column major) }
+    //   meshCount x {
+    //     MeshHeader
+    //     string name
+    //     textureCount x { string type, string path (relative to the model), int32_t embedded }
+    //     lodCount x LodRecord
+    //     vertexCount x CookedVertex
+    //     indexCount x uint16_t when vertexCount <= 65536, uint32_t otherwise
+    //   }
+    // embedded is the n of the model's <source>.emb<n>.tex output, -1 for image files.
+    struct MeshFileHeader {
+        uint32_t meshCount;
+        uint32_t boneCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct MeshHeader {
+        uint32_t vertexCount;
+        // all LODs concatenated, LOD 0 first
+        uint32_t indexCount;
+        uint32_t lodCount;
+        uint32_t textureCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct LodRecord {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        float error;
+    };
+
+    // .tex file:
+    //   CookedHeader
+    //   TextureHeader
+    //   mipCount x { uint32_t byteSize, compressed blocks }
+    // Level 0 comes first, block rows run top-down as in the source image.
+    enum TextureFormat : uint32_t {
+        TEXTURE_BC1 = 1, // RGB, 8 bytes per 4x4 block (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        TEXTURE_BC3 = 2, // RGBA, 16 bytes per 4x4 block (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        TEXTURE_BC4 = 3  // single channel, 8 bytes per 4x4 block (GL_COMPRESSED_RED_RGTC1)
+    };
+
+    struct TextureHeader {
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+        uint32_t format;
+        // channel count of the source image
+        uint32_t sourceChannels;
+    };
+}
+
+#endif // COOKEDFORMATS_H
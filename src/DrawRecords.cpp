@@ -0,0 +1,139 @@
+#include "DrawRecords.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+
+static_assert(sizeof(DrawRecords::Record) == 96, "Record must match its std140 layout");
+
+DrawRecords::~DrawRecords()
+{
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+		}
+	}
+	if (ubo)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+}
+
+void DrawRecords::init(size_t maxDrawsPerFrame)
+{
+	Program::setUniformBlockBinding("PerDraw", BINDING);
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = ((GLsizeiptr) sizeof(Record) + alignment - 1) / alignment * alignment;
+
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	allocate(maxDrawsPerFrame);
+}
+
+void DrawRecords::allocate(size_t drawsPerFrame)
+{
+	// a fresh store replaces every region, so no earlier fence applies to it
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	capacity = drawsPerFrame;
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, stride * capacity * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW));
+}
+
+void DrawRecords::beginFrame()
+{
+	records.clear();
+
+	GLsync &fence = fences[frame];
+	if (fence)
+	{
+		// normally long signalled, the CPU only stalls here when it runs FRAMES_IN_FLIGHT frames ahead
+		GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (status == GL_TIMEOUT_EXPIRED)
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+DrawRecords::Record DrawRecords::makeRecord(const glm::mat4 &M, int materialIndex, GLuint flags, GLint layer, const glm::vec4 &uvTransform)
+{
+	Record record;
+	record.M = M;
+	record.materialIndex = materialIndex;
+	record.flags = flags;
+	record.layer = layer;
+	record.padding = 0;
+	record.uvTransform = uvTransform;
+	return record;
+}
+
+GLuint DrawRecords::push(const glm::mat4 &M, int materialIndex, GLuint flags, GLint layer, const glm::vec4 &uvTransform)
+{
+	records.push_back(makeRecord(M, materialIndex, flags, layer, uvTransform));
+	return (GLuint) records.size() - 1;
+}
+
+GLuint DrawRecords::push(const std::vector<Record> &frameRecords)
+{
+	GLuint first = (GLuint) records.size();
+	records.insert(records.end(), frameRecords.begin(), frameRecords.end());
+	return first;
+}
+
+void DrawRecords::upload()
+{
+	if (records.empty())
+	{
+		return;
+	}
+	if (records.size() > capacity)
+	{
+		std::cout << "Growing per-draw ring to " << records.size() * 2 << " draws per frame" << std::endl;
+		allocate(records.size() * 2);
+	}
+
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	// the region's fence already passed in beginFrame(), nothing on the GPU reads it
+	GLintptr regionOffset = stride * capacity * frame;
+	unsigned char *dst = (unsigned char *) glMapBufferRange(GL_UNIFORM_BUFFER, regionOffset, stride * records.size(),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst)
+	{
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			std::memcpy(dst + i * stride, &records[i], sizeof(Record));
+		}
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	else
+	{
+		std::cerr << "Could not map the per-draw ring" << std::endl;
+	}
+}
+
+void DrawRecords::bind(GLuint index) const
+{
+	GLintptr offset = stride * (capacity * frame + index);
+	GLState::bindBufferRange(GL_UNIFORM_BUFFER, BINDING, ubo, offset, sizeof(Record));
+}
+
+void DrawRecords::endFrame()
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame = (frame + 1) % FRAMES_IN_FLIGHT;
+}
@@ -0,0 +1,91 @@
+#pragma  once
+
+#ifndef DRAWRECORDS_H_INCLUDED
+#define DRAWRECORDS_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-draw data (model matrix, material index, flags) for a whole frame, written
+// to a uniform buffer in one go and selected per draw with a single
+// glBindBufferRange instead of a handful of glUniform calls. Shaders declare:
+//
+//	layout(std140) uniform PerDraw {
+//		mat4 M;
+//		ivec4 drawParams;  // x material index, y flags, z texture array layer
+//		vec4 uvTransform;  // xy scale, zw offset into the layer
+//	};
+//
+// The buffer is split into FRAMES_IN_FLIGHT regions used round robin. Each region
+// is fenced after its frame is submitted and only rewritten once the GPU has passed
+// the fence, so the mapping can skip the driver's own synchronization.
+//
+// Usage per frame: beginFrame(), push() every draw, upload(), then bind(index)
+// before each draw call, and endFrame() once the frame's draws are issued.
+class DrawRecords
+{
+
+public:
+
+	static const GLuint BINDING = 1;
+	static const int FRAMES_IN_FLIGHT = 3;
+
+	enum Flags
+	{
+		FLAG_TEXTURED = 1 << 0,
+		// UVs wrap inside an atlas entry instead of the whole layer
+		FLAG_ATLASED = 1 << 1
+	};
+
+	struct Record
+	{
+		glm::mat4 M;
+		GLint materialIndex;
+		GLuint flags;
+		GLint layer;
+		GLint padding;
+		glm::vec4 uvTransform;
+	};
+
+	DrawRecords() = default;
+	~DrawRecords();
+	DrawRecords(const DrawRecords&) = delete;
+	DrawRecords& operator=(const DrawRecords&) = delete;
+
+	// Creates the buffer and registers the block binding; call before linking programs.
+	// The ring grows on upload() if a frame pushes more than maxDrawsPerFrame records.
+	void init(size_t maxDrawsPerFrame);
+
+	// Waits until the GPU is done with the region this frame will write
+	void beginFrame();
+	static Record makeRecord(const glm::mat4 &M, int materialIndex, GLuint flags = 0,
+		GLint layer = 0, const glm::vec4 &uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+	// Returns the index to pass to bind()
+	GLuint push(const glm::mat4 &M, int materialIndex, GLuint flags = 0,
+		GLint layer = 0, const glm::vec4 &uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+	// Appends records built elsewhere, e.g. on another thread; returns the index of the first
+	GLuint push(const std::vector<Record> &frameRecords);
+	void upload();
+	void bind(GLuint index) const;
+	void endFrame();
+
+	const Record &getRecord(GLuint index) const { return records[index]; }
+	size_t getRecordCount() const { return records.size(); }
+
+private:
+
+	void allocate(size_t drawsPerFrame);
+
+	std::vector<Record> records;
+	GLuint ubo = 0;
+	// bytes between records, sizeof(Record) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	GLsizeiptr stride = 0;
+	size_t capacity = 0;
+	int frame = 0;
+	GLsync fences[FRAMES_IN_FLIGHT] = {};
+
+};
+
+#endif // DRAWRECORDS_H_INCLUDED
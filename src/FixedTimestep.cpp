@@ -0,0 +1,40 @@
+#include "FixedTimestep.h"
+
+#include <iostream>
+
+FixedTimestep::FixedTimestep(double rate, int maxTicks) : step(1.0 / 60.0), maxTicks(maxTicks)
+{
+	setRate(rate);
+}
+
+void FixedTimestep::setRate(double rate)
+{
+	if (rate <= 0.0)
+	{
+		std::cerr << "FixedTimestep: ignoring tick rate " << rate << std::endl;
+		return;
+	}
+	step = 1.0 / rate;
+	accumulator = 0.0;
+}
+
+int FixedTimestep::advance(double elapsed)
+{
+	accumulator += elapsed > 0.0 ? elapsed : 0.0;
+	int count = (int) (accumulator / step);
+	if (count > maxTicks)
+	{
+		// keep the fraction, so interpolation does not jump
+		dropped += count - maxTicks;
+		accumulator -= (count - maxTicks) * step;
+		count = maxTicks;
+	}
+	accumulator -= count * step;
+	if (accumulator < 0.0)
+	{
+		// rounding can leave a tiny negative remainder
+		accumulator = 0.0;
+	}
+	ticks += count;
+	return count;
+}
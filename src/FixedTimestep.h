@@ -0,0 +1,50 @@
+#pragma  once
+
+#ifndef FIXEDTIMESTEP_H_INCLUDED
+#define FIXEDTIMESTEP_H_INCLUDED
+
+#include <cstdint>
+
+// Turns the real time between frames into whole simulation ticks of a fixed
+// length, so the simulation behaves the same at any frame rate.
+//
+// Time left over after the last whole tick carries into the next frame;
+// getAlpha() says how far it reaches into the next tick, for interpolating
+// what is drawn between the last two simulated states. After a long stall
+// (e.g. a breakpoint) at most maxTicks run and the rest of the time is dropped,
+// rather than the simulation falling further behind every frame.
+class FixedTimestep
+{
+
+public:
+
+	explicit FixedTimestep(double rate = 60.0, int maxTicks = 8);
+
+	// Ticks per second
+	void setRate(double rate);
+	double getRate() const { return 1.0 / step; }
+	// Seconds per tick
+	double getStep() const { return step; }
+
+	// Adds elapsed seconds of real time, returns how many ticks to run now
+	int advance(double elapsed);
+	// Fraction of a tick accumulated past the last one, in [0, 1)
+	float getAlpha() const { return (float) (accumulator / step); }
+
+	uint64_t getTickCount() const { return ticks; }
+	// Simulated seconds, ticks times step
+	double getTime() const { return ticks * step; }
+	// Ticks skipped after stalls
+	uint64_t getDroppedTicks() const { return dropped; }
+
+private:
+
+	double step;
+	int maxTicks;
+	double accumulator = 0.0;
+	uint64_t ticks = 0;
+	uint64_t dropped = 0;
+
+};
+
+#endif // FIXEDTIMESTEP_H_INCLUDED
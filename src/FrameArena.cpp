@@ -0,0 +1,86 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// blocks come from operator new[], aligned for any fundamental type
+static unsigned char *allocateBlock(size_t size)
+{
+	return new unsigned char[size];
+}
+
+FrameArena::FrameArena(size_t capacity) : capacity(capacity)
+{
+	block = allocateBlock(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+	for (unsigned char *extra : overflow)
+	{
+		delete[] extra;
+	}
+	delete[] block;
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+	uintptr_t base = (uintptr_t) block;
+	size_t start = alignUp(base + offset, alignment) - base;
+	if (start + size <= capacity)
+	{
+		offset = start + size;
+		return block + start;
+	}
+
+	// a block of its own; the slack covers alignments past the one new[] guarantees
+	size_t extraSize = size + alignment;
+	unsigned char *extra = allocateBlock(extraSize);
+	overflow.push_back(extra);
+	overflowBytes += extraSize;
+	peak = std::max(peak, getUsed());
+	uintptr_t address = (uintptr_t) extra;
+	return extra + (alignUp(address, alignment) - address);
+}
+
+void FrameArena::reset()
+{
+	peak = std::max(peak, getUsed());
+	if (!overflow.empty())
+	{
+		for (unsigned char *extra : overflow)
+		{
+			delete[] extra;
+		}
+		overflow.clear();
+		overflowBytes = 0;
+
+		// room for the frame that overflowed, with some to spare
+		delete[] block;
+		capacity = std::max(2 * capacity, alignUp(peak + peak / 2, 4096));
+		block = allocateBlock(capacity);
+	}
+	offset = 0;
+}
+
+void FrameArena::rewind(size_t mark, size_t overflowMark)
+{
+	peak = std::max(peak, getUsed());
+	offset = mark;
+	// the outermost scope closing is the end of this thread's work on the frame
+	if (mark == 0 && overflowMark == 0 && !overflow.empty())
+	{
+		reset();
+	}
+}
+
+FrameArena &FrameArena::local()
+{
+	thread_local FrameArena arena;
+	return arena;
+}
@@ -0,0 +1,119 @@
+#pragma  once
+
+#ifndef FRAMEARENA_H_INCLUDED
+#define FRAMEARENA_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator for data that lives no longer than a frame, one per thread.
+//
+// allocate() only moves an offset through one block; nothing is freed on its
+// own, reset() at the end of the frame drops everything at once. A frame that
+// runs out of block takes extra blocks from the heap, and the next reset()
+// replaces the block with one large enough for that frame, so a steady
+// workload stops touching the heap after its first few frames.
+//
+// Threads that never see a frame end (e.g. thread pool workers) wrap their
+// temporaries in a Scope instead, which rewinds the arena when it closes.
+//
+// Memory from the arena must not outlive the reset() or Scope after it, nor be
+// handed to another thread that keeps it past that point.
+class FrameArena
+{
+
+public:
+
+	static const size_t DEFAULT_CAPACITY = 256 * 1024;
+
+	// Rewinds the arena to where it was when the scope opened
+	class Scope
+	{
+
+	public:
+
+		explicit Scope(FrameArena &arena) : arena(arena), mark(arena.offset), overflowMark(arena.overflow.size()) {}
+		~Scope() { arena.rewind(mark, overflowMark); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+
+		FrameArena &arena;
+		size_t mark;
+		size_t overflowMark;
+
+	};
+
+	explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// alignment must be a power of two
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	template <typename T>
+	T *allocateArray(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+	// Frees everything allocated since the last reset
+	void reset();
+
+	size_t getCapacity() const { return capacity; }
+	// bytes handed out since the last reset, including what overflowed the block
+	size_t getUsed() const { return offset + overflowBytes; }
+	// most bytes any frame used
+	size_t getPeak() const { return peak; }
+
+	// The arena of the calling thread, created on first use
+	static FrameArena &local();
+
+private:
+
+	void rewind(size_t mark, size_t overflowMark);
+
+	unsigned char *block = nullptr;
+	size_t capacity = 0;
+	size_t offset = 0;
+	// blocks taken when the block ran out, freed by the next reset()
+	std::vector<unsigned char*> overflow;
+	size_t overflowBytes = 0;
+	size_t peak = 0;
+
+};
+
+// Lets standard containers allocate from a FrameArena; deallocate() does
+// nothing, the memory comes back with the arena's reset. Default constructed,
+// it uses the calling thread's arena.
+template <typename T>
+class ArenaAllocator
+{
+
+public:
+
+	typedef T value_type;
+
+	ArenaAllocator() : arena(&FrameArena::local()) {}
+	explicit ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.getArena()) {}
+
+	T *allocate(size_t count) { return arena->allocateArray<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	FrameArena *getArena() const { return arena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.getArena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.getArena(); }
+
+private:
+
+	FrameArena *arena;
+
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // FRAMEARENA_H_INCLUDED
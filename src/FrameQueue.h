@@ -0,0 +1,104 @@
+#pragma  once
+
+#ifndef FRAMEQUEUE_H_INCLUDED
+#define FRAMEQUEUE_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// Hands frames from one producer thread to one consumer thread through a
+// fixed ring of SLOTS reusable frames.
+//
+// The producer fills the slot acquireWrite() returns and publish()es it; the
+// consumer reads the slot acquireRead() returns and release()s it back. Both
+// sides only exchange two counters with acquire/release atomics, neither ever
+// takes a lock. With two slots the producer records frame N+1 while the
+// consumer draws frame N, and can never get more than one frame ahead.
+//
+// A side with nothing to do spins briefly, then sleeps in short steps; close()
+// wakes both and makes the acquire calls return nullptr once nothing is left.
+template <typename Frame, size_t SLOTS = 2>
+class FrameQueue
+{
+
+public:
+
+	FrameQueue() = default;
+	FrameQueue(const FrameQueue&) = delete;
+	FrameQueue& operator=(const FrameQueue&) = delete;
+
+	// Producer: the next free slot, waiting for the consumer to release one; nullptr once closed.
+	// The slot still holds an old frame, for reusing its storage
+	Frame *acquireWrite()
+	{
+		uint64_t head = written.load(std::memory_order_relaxed);
+		if (isClosed() || !waitFor([&] { return head - read.load(std::memory_order_acquire) < SLOTS; }))
+		{
+			return nullptr;
+		}
+		return &slots[head % SLOTS];
+	}
+
+	// Producer: makes the slot from acquireWrite() visible to the consumer
+	void publish()
+	{
+		written.fetch_add(1, std::memory_order_release);
+	}
+
+	// Consumer: the oldest published frame, waiting for one; nullptr once closed and drained
+	const Frame *acquireRead()
+	{
+		uint64_t tail = read.load(std::memory_order_relaxed);
+		if (!waitFor([&] { return written.load(std::memory_order_acquire) > tail; }))
+		{
+			return nullptr;
+		}
+		return &slots[tail % SLOTS];
+	}
+
+	// Consumer: hands the slot from acquireRead() back to the producer
+	void release()
+	{
+		read.fetch_add(1, std::memory_order_release);
+	}
+
+	void close() { closed.store(true, std::memory_order_release); }
+	bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+private:
+
+	// true once ready() holds, false if the queue closed first
+	template <typename Ready>
+	bool waitFor(Ready ready)
+	{
+		for (int spins = 0; !ready(); spins++)
+		{
+			if (isClosed())
+			{
+				return ready();
+			}
+			if (spins < 64)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				// a vsync-bound consumer can keep the producer waiting for most of a frame
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+		return true;
+	}
+
+	Frame slots[SLOTS];
+	// frames published and released so far; the slot of frame n is n % SLOTS
+	std::atomic<uint64_t> written{0};
+	std::atomic<uint64_t> read{0};
+	std::atomic<bool> closed{false};
+
+};
+
+#endif // FRAMEQUEUE_H_INCLUDED
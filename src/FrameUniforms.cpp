@@ -0,0 +1,44 @@
+#include "FrameUniforms.h"
+
+#include <cstddef>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+
+// std140 offsets: mat4s are tightly packed
+static_assert(offsetof(FrameUniforms::Block, V) == 64, "PerFrame.V offset");
+static_assert(sizeof(FrameUniforms::Block) == 128, "PerFrame size");
+
+FrameUniforms::~FrameUniforms()
+{
+	if (ubo)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+}
+
+void FrameUniforms::init()
+{
+	Program::setUniformBlockBinding("PerFrame", BINDING);
+
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW));
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
+
+void FrameUniforms::setCamera(const glm::mat4 &projection, const glm::mat4 &view)
+{
+	block.P = projection;
+	block.V = view;
+}
+
+void FrameUniforms::upload()
+{
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	// orphan the previous frame's storage so the write never waits on draws still reading it
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
@@ -0,0 +1,53 @@
+#pragma  once
+
+#ifndef FRAMEUNIFORMS_H_INCLUDED
+#define FRAMEUNIFORMS_H_INCLUDED
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Camera state shared by every program, kept in one std140 uniform buffer that
+// is written once per frame. Shaders declare the matching block:
+//
+//	layout(std140) uniform PerFrame {
+//		mat4 P;
+//		mat4 V;
+//	};
+//
+// Program binds any linked "PerFrame" block to BINDING, so new programs only have
+// to declare the block to see the frame's camera. Lights are in LightClusters.
+class FrameUniforms
+{
+
+public:
+
+	static const GLuint BINDING = 0;
+
+	// CPU mirror of the block, laid out by std140 rules
+	struct Block
+	{
+		glm::mat4 P;
+		glm::mat4 V;
+	};
+
+	FrameUniforms() = default;
+	~FrameUniforms();
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	// Creates the buffer and registers the block binding; call before linking programs
+	void init();
+
+	void setCamera(const glm::mat4 &projection, const glm::mat4 &view);
+
+	// Writes the block to the buffer and binds it to BINDING
+	void upload();
+
+private:
+
+	Block block = {};
+	GLuint ubo = 0;
+
+};
+
+#endif // FRAMEUNIFORMS_H_INCLUDED
@@ -0,0 +1,162 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#include "ThreadPool.h"
+
+// SSE2 is part of every x86-64 target, other targets take the scalar loop
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+void FrustumCuller::clear()
+{
+	count = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void FrustumCuller::reserve(size_t capacity)
+{
+	// room for the padding cull() adds
+	capacity = (capacity + 3) & ~(size_t) 3;
+	for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+	{
+		array->reserve(capacity);
+	}
+	visible.reserve(capacity);
+}
+
+size_t FrustumCuller::add(const glm::vec3 &localMin, const glm::vec3 &localMax, const glm::mat4 &model)
+{
+	// drop the padding of the last cull()
+	if (centerX.size() > count)
+	{
+		for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+		{
+			array->resize(count);
+		}
+	}
+
+	// the box around the transformed box: the centre moves with the matrix, each
+	// world extent sums the local extents scaled by the absolute matrix entries
+	glm::vec3 center = glm::vec3(model * glm::vec4(0.5f * (localMin + localMax), 1.0f));
+	glm::vec3 extent = 0.5f * (localMax - localMin);
+	glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y
+		+ glm::abs(glm::vec3(model[2])) * extent.z;
+
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(worldExtent.x);
+	extentY.push_back(worldExtent.y);
+	extentZ.push_back(worldExtent.z);
+	return count++;
+}
+
+void FrustumCuller::cull(const glm::mat4 &viewProjection, ThreadPool *pool)
+{
+	// planes from the rows of the matrix (Gribb and Hartmann), glm is column major
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (glm::vec4 &plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	// whole lanes of four; padded boxes are empty and their flags never read
+	size_t padded = (count + 3) & ~(size_t) 3;
+	for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+	{
+		array->resize(padded, 0.0f);
+	}
+	visible.resize(padded);
+
+	if (pool && count >= PARALLEL_THRESHOLD)
+	{
+		pool->parallelFor(padded, BATCH_SIZE, [this](size_t begin, size_t end) {
+			cullRange(begin, end);
+		});
+	}
+	else
+	{
+		cullRange(0, padded);
+	}
+
+	stats.visible = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		stats.visible += visible[i];
+	}
+	stats.culled = count - stats.visible;
+}
+
+void FrustumCuller::cullRange(size_t begin, size_t end)
+{
+#ifdef FRUSTUM_CULLER_SSE
+	const __m128 zero = _mm_setzero_ps();
+	// clears the sign bit, for the absolute plane normals
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[i]);
+		__m128 cy = _mm_loadu_ps(&centerY[i]);
+		__m128 cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]);
+		__m128 ey = _mm_loadu_ps(&extentY[i]);
+		__m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			// signed distance of the centre, and how far the box reaches towards the plane
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, planeX[p]), _mm_mul_ps(cy, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(cz, planeZ[p]), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_and_ps(planeX[p], absMask)), _mm_mul_ps(ey, _mm_and_ps(planeY[p], absMask))),
+				_mm_mul_ps(ez, _mm_and_ps(planeZ[p], absMask)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		visible[i] = mask & 1;
+		visible[i + 1] = (mask >> 1) & 1;
+		visible[i + 2] = (mask >> 2) & 1;
+		visible[i + 3] = (mask >> 3) & 1;
+	}
+#else
+	for (size_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4 &plane = planes[p];
+			float distance = centerX[i] * plane.x + centerY[i] * plane.y + centerZ[i] * plane.z + plane.w;
+			float radius = extentX[i] * std::fabs(plane.x) + extentY[i] * std::fabs(plane.y) + extentZ[i] * std::fabs(plane.z);
+			inside = distance + radius >= 0.0f;
+		}
+		visible[i] = inside;
+	}
+#endif
+}
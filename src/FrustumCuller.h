@@ -0,0 +1,65 @@
+#pragma  once
+
+#ifndef FRUSTUMCULLER_H_INCLUDED
+#define FRUSTUMCULLER_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+// Tests world-space bounding boxes against a view frustum, four at a time.
+//
+// Boxes are added from their local bounds and model matrix and stored as
+// centres and half extents in separate arrays (structure of arrays), so each SSE
+// lane holds one box and every plane test is a few multiply-adds. Without SSE
+// (e.g. on ARM) the same loop runs one box at a time. Large sets are split into
+// batches over the thread pool; each batch only writes its own flags.
+//
+// A box is visible unless it lies entirely behind one of the six planes, which
+// keeps a few boxes near the frustum corners that are actually outside.
+class FrustumCuller
+{
+
+public:
+
+	// smaller sets are tested on the calling thread, a job costs more than it saves
+	static const size_t PARALLEL_THRESHOLD = 4096;
+	// boxes per job, a multiple of 4
+	static const size_t BATCH_SIZE = 1024;
+
+	struct Stats
+	{
+		size_t visible = 0;
+		size_t culled = 0;
+	};
+
+	void clear();
+	void reserve(size_t capacity);
+	// Adds the box localMin..localMax transformed by model, returns its index
+	size_t add(const glm::vec3 &localMin, const glm::vec3 &localMax, const glm::mat4 &model);
+	size_t getCount() const { return count; }
+
+	// Tests every box against the frustum of viewProjection; pool may be null
+	void cull(const glm::mat4 &viewProjection, ThreadPool *pool);
+	bool isVisible(size_t index) const { return visible[index] != 0; }
+	// counts of the last cull()
+	const Stats &getStats() const { return stats; }
+
+private:
+
+	void cullRange(size_t begin, size_t end);
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<unsigned char> visible;
+	size_t count = 0;
+	// xyz normal pointing into the frustum, w distance
+	glm::vec4 planes[6];
+	Stats stats;
+
+};
+
+#endif // FRUSTUMCULLER_H_INCLUDED
@@ -60,6 +60,118 @@ void checkError(const char *str)
 	}
 }
 
+static bool debugOutput = false;
+static bool debugSynchronous = false;
+
+static const char *debugSourceString(GLenum source)
+{
+	switch (source) {
+	case GL_DEBUG_SOURCE_API:
+		return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+		return "window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER:
+		return "shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY:
+		return "third party";
+	case GL_DEBUG_SOURCE_APPLICATION:
+		return "application";
+	default:
+		return "other";
+	}
+}
+
+static const char *debugTypeString(GLenum type)
+{
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR:
+		return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+		return "deprecated behavior";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+		return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY:
+		return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE:
+		return "performance";
+	default:
+		return "other";
+	}
+}
+
+static const char *debugSeverityString(GLenum severity)
+{
+	switch (severity) {
+	case GL_DEBUG_SEVERITY_HIGH:
+		return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM:
+		return "medium";
+	case GL_DEBUG_SEVERITY_LOW:
+		return "low";
+	default:
+		return "notification";
+	}
+}
+
+// with asynchronous output this may run on a driver thread, so it only prints
+static void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *)
+{
+	size_t messageLength = length < 0 ? strlen(message) : (size_t) length;
+	std::cerr << "OpenGL " << debugSourceString(source) << " " << debugTypeString(type) << " (" << debugSeverityString(severity)
+		<< " severity, id " << id << "): " << std::string(message, messageLength) << std::endl;
+}
+
+bool enableDebugOutput(bool synchronous)
+{
+	if (!GLAD_GL_KHR_debug)
+	{
+		std::cout << "KHR_debug is not available, GL errors are polled with glGetError in debug builds" << std::endl;
+		return false;
+	}
+
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+	{
+		std::cout << "Not a debug context, the driver may report fewer GL errors" << std::endl;
+	}
+
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(debugCallback, nullptr);
+	// notifications (buffer placement and the like) would flood the log
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	debugOutput = true;
+	setDebugOutputSynchronous(synchronous);
+	return true;
+}
+
+void setDebugOutputSynchronous(bool synchronous)
+{
+	if (!debugOutput)
+	{
+		return;
+	}
+	if (synchronous)
+	{
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+	else
+	{
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+	debugSynchronous = synchronous;
+}
+
+bool isDebugOutputSynchronous()
+{
+	return debugSynchronous;
+}
+
+bool isPollingErrors()
+{
+	return !debugOutput;
+}
+
 void printShaderInfoLog(GLuint shader)
 {
 	GLint infologLength = 0;
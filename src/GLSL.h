@@ -25,13 +25,29 @@ namespace GLSL
 	void enableVertexAttribArray(const GLint handle);
 	void disableVertexAttribArray(const GLint handle);
 	void vertexAttribPointer(const GLint handle, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+
+	// Reports GL errors and warnings through a KHR_debug callback instead of glGetError.
+	// Asynchronous output lets the driver report whenever it finds a problem without
+	// stalling; synchronous output reports from inside the offending call, so a
+	// breakpoint in the callback shows who made it. Returns false without KHR_debug
+	// (e.g. macOS), in which case CHECKED_GL_CALL keeps polling in debug builds.
+	bool enableDebugOutput(bool synchronous = false);
+	// The runtime switch for synchronous reporting; no effect before enableDebugOutput()
+	void setDebugOutputSynchronous(bool synchronous);
+	bool isDebugOutputSynchronous();
+	// True while CHECKED_GL_CALL has to poll glGetError, i.e. without debug output
+	bool isPollingErrors();
 }
 
 
-#ifndef DISABLE_OPENGL_ERROR_CHECKS
-#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
-#else
+// Release builds (NDEBUG) and DISABLE_OPENGL_ERROR_CHECKS compile to the bare call.
+// Debug builds only poll glGetError around it when debug output is unavailable, since
+// each poll waits for the driver to catch up.
+#if defined(NDEBUG) || defined(DISABLE_OPENGL_ERROR_CHECKS)
 #define CHECKED_GL_CALL(x) (x)
+#else
+#define CHECKED_GL_CALL(x) do { bool pollGL = GLSL::isPollingErrors(); if (pollGL) GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); \
+	(x); if (pollGL) GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
 #endif
 
 #endif // LAB471_GLSL_H_INCLUDED
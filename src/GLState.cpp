@@ -0,0 +1,369 @@
+#include "GLState.h"
+
+#include <map>
+
+namespace GLState
+{
+	// never handed out by glGen*/glCreate*, used for "not known yet"
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	static const GLuint MAX_UNITS = 32;
+	static const GLuint MAX_UNIFORM_BINDINGS = 16;
+
+	// texture targets with a shadow per unit, others are always issued
+	static const GLenum TEXTURE_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER};
+	static const int TEXTURE_TARGET_COUNT = sizeof(TEXTURE_TARGETS) / sizeof(TEXTURE_TARGETS[0]);
+
+	static const GLenum BUFFER_TARGETS[] = {GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER,
+		GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER};
+	static const int BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]);
+	static const int ELEMENT_ARRAY_SLOT = 1;
+
+	struct IndexedBinding
+	{
+		GLuint buffer;
+		GLintptr offset;
+		// -1 for a whole-buffer glBindBufferBase
+		GLsizeiptr size;
+	};
+
+	struct Shadow
+	{
+		GLuint program;
+		GLuint vertexArray;
+		GLuint activeUnit;
+		GLuint textures[MAX_UNITS][TEXTURE_TARGET_COUNT];
+		GLuint buffers[BUFFER_TARGET_COUNT];
+		IndexedBinding uniformBindings[MAX_UNIFORM_BINDINGS];
+		std::map<GLenum, GLboolean> capabilities;
+		GLenum blendSource;
+		GLenum blendDestination;
+		GLenum depthFunction;
+		GLuint depthWrite;
+	};
+
+	static Shadow shadowState;
+	static bool shadowKnown = false;
+
+	static Shadow &shadow()
+	{
+		// nothing is known about a fresh context
+		if (!shadowKnown)
+		{
+			shadowKnown = true;
+			invalidate();
+		}
+		return shadowState;
+	}
+
+	static Counters counters;
+
+	// true when the call can be skipped, counting it either way
+	static bool unchanged(bool same)
+	{
+		if (same)
+		{
+			counters.skipped++;
+		}
+		else
+		{
+			counters.issued++;
+		}
+		return same;
+	}
+
+	static int textureSlot(GLenum target)
+	{
+		for (int i = 0; i < TEXTURE_TARGET_COUNT; i++)
+		{
+			if (TEXTURE_TARGETS[i] == target)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	static int bufferSlot(GLenum target)
+	{
+		for (int i = 0; i < BUFFER_TARGET_COUNT; i++)
+		{
+			if (BUFFER_TARGETS[i] == target)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	static void activeTexture(GLuint unit)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.activeUnit == unit))
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			state.activeUnit = unit;
+		}
+	}
+
+	void invalidate()
+	{
+		Shadow &state = shadow();
+		state.program = UNKNOWN;
+		state.vertexArray = UNKNOWN;
+		state.activeUnit = UNKNOWN;
+		for (GLuint unit = 0; unit < MAX_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				state.textures[unit][target] = UNKNOWN;
+			}
+		}
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			state.buffers[target] = UNKNOWN;
+		}
+		for (GLuint index = 0; index < MAX_UNIFORM_BINDINGS; index++)
+		{
+			state.uniformBindings[index] = {UNKNOWN, 0, 0};
+		}
+		state.capabilities.clear();
+		state.blendSource = UNKNOWN;
+		state.blendDestination = UNKNOWN;
+		state.depthFunction = UNKNOWN;
+		state.depthWrite = UNKNOWN;
+	}
+
+	void useProgram(GLuint program)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.program == program))
+		{
+			glUseProgram(program);
+			state.program = program;
+		}
+	}
+
+	void bindVertexArray(GLuint vertexArray)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.vertexArray == vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			state.vertexArray = vertexArray;
+			// each vertex array has its own element buffer binding
+			state.buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+		}
+	}
+
+	void bindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		Shadow &state = shadow();
+		int slot = textureSlot(target);
+		if (unit < MAX_UNITS && slot >= 0)
+		{
+			if (unchanged(state.textures[unit][slot] == texture))
+			{
+				return;
+			}
+			state.textures[unit][slot] = texture;
+		}
+		else
+		{
+			counters.issued++;
+		}
+		activeTexture(unit);
+		glBindTexture(target, texture);
+	}
+
+	void bindTextureForEdit(GLenum target, GLuint texture)
+	{
+		bindTexture(EDIT_UNIT, target, texture);
+		activeTexture(EDIT_UNIT);
+	}
+
+	void bindBuffer(GLenum target, GLuint buffer)
+	{
+		Shadow &state = shadow();
+		int slot = bufferSlot(target);
+		if (slot >= 0)
+		{
+			if (unchanged(state.buffers[slot] == buffer))
+			{
+				return;
+			}
+			state.buffers[slot] = buffer;
+		}
+		else
+		{
+			counters.issued++;
+		}
+		glBindBuffer(target, buffer);
+	}
+
+	static void bindIndexed(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		Shadow &state = shadow();
+		if (target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS)
+		{
+			IndexedBinding &binding = state.uniformBindings[index];
+			if (unchanged(binding.buffer == buffer && binding.offset == offset && binding.size == size))
+			{
+				return;
+			}
+			binding = {buffer, offset, size};
+		}
+		else
+		{
+			counters.issued++;
+		}
+
+		if (size < 0)
+		{
+			glBindBufferBase(target, index, buffer);
+		}
+		else
+		{
+			glBindBufferRange(target, index, buffer, offset, size);
+		}
+		// indexed binds also replace the generic binding of the target
+		int slot = bufferSlot(target);
+		if (slot >= 0)
+		{
+			state.buffers[slot] = buffer;
+		}
+	}
+
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		bindIndexed(target, index, buffer, 0, -1);
+	}
+
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		bindIndexed(target, index, buffer, offset, size);
+	}
+
+	static void setCapability(GLenum capability, GLboolean enabled)
+	{
+		Shadow &state = shadow();
+		auto known = state.capabilities.find(capability);
+		if (unchanged(known != state.capabilities.end() && known->second == enabled))
+		{
+			return;
+		}
+		state.capabilities[capability] = enabled;
+		if (enabled)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+	}
+
+	void enable(GLenum capability)
+	{
+		setCapability(capability, GL_TRUE);
+	}
+
+	void disable(GLenum capability)
+	{
+		setCapability(capability, GL_FALSE);
+	}
+
+	void blendFunc(GLenum source, GLenum destination)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.blendSource == source && state.blendDestination == destination))
+		{
+			glBlendFunc(source, destination);
+			state.blendSource = source;
+			state.blendDestination = destination;
+		}
+	}
+
+	void depthFunc(GLenum function)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.depthFunction == function))
+		{
+			glDepthFunc(function);
+			state.depthFunction = function;
+		}
+	}
+
+	void depthMask(GLboolean flag)
+	{
+		Shadow &state = shadow();
+		if (!unchanged(state.depthWrite == flag))
+		{
+			glDepthMask(flag);
+			state.depthWrite = flag;
+		}
+	}
+
+	void deleteProgram(GLuint program)
+	{
+		// a current program is only flagged for deletion and stays current, so the shadow still holds
+		glDeleteProgram(program);
+	}
+
+	void deleteVertexArray(GLuint vertexArray)
+	{
+		Shadow &state = shadow();
+		glDeleteVertexArrays(1, &vertexArray);
+		// deleting the bound vertex array reverts to 0
+		if (state.vertexArray == vertexArray)
+		{
+			state.vertexArray = 0;
+			state.buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+		}
+	}
+
+	void deleteTexture(GLuint texture)
+	{
+		Shadow &state = shadow();
+		glDeleteTextures(1, &texture);
+		for (GLuint unit = 0; unit < MAX_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				if (state.textures[unit][target] == texture)
+				{
+					state.textures[unit][target] = 0;
+				}
+			}
+		}
+	}
+
+	void deleteBuffer(GLuint buffer)
+	{
+		Shadow &state = shadow();
+		glDeleteBuffers(1, &buffer);
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			if (state.buffers[target] == buffer)
+			{
+				state.buffers[target] = 0;
+			}
+		}
+		for (GLuint index = 0; index < MAX_UNIFORM_BINDINGS; index++)
+		{
+			if (state.uniformBindings[index].buffer == buffer)
+			{
+				state.uniformBindings[index] = {0, 0, -1};
+			}
+		}
+	}
+
+	const Counters &getCounters()
+	{
+		return counters;
+	}
+
+	void resetCounters()
+	{
+		counters = Counters();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma  once
+
+#ifndef GLSTATE_H_INCLUDED
+#define GLSTATE_H_INCLUDED
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL binding and fixed-function state the renderer touches.
+// Each call compares against the shadow and only reaches the driver when the
+// state actually changes. Binds are lazy: nothing is reset to 0 after drawing,
+// the next user simply binds what it needs.
+//
+// Everything that binds programs, vertex arrays, textures or buffers has to go
+// through here, otherwise the shadow goes stale; call invalidate() after code
+// that bypasses it. Deleted names can be handed out again by glGen*, so deleting
+// code must use the delete functions below (or forget the name itself).
+namespace GLState
+{
+	struct Counters
+	{
+		// calls that reached the driver
+		uint64_t issued = 0;
+		// calls dropped because the state was already set
+		uint64_t skipped = 0;
+	};
+
+	// Texture unit used by bindTextureForEdit()
+	const GLuint EDIT_UNIT = 0;
+
+	// Marks every shadowed value unknown, so the next call of each kind is issued
+	void invalidate();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	// Binds texture on unit for drawing; the active texture unit is left unspecified
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	// Binds texture on EDIT_UNIT and makes it the active unit, for glTex* calls
+	void bindTextureForEdit(GLenum target, GLuint texture);
+	// GL_ELEMENT_ARRAY_BUFFER belongs to the bound vertex array and is tracked per bind of it
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void blendFunc(GLenum source, GLenum destination);
+	void depthFunc(GLenum function);
+	void depthMask(GLboolean flag);
+
+	void deleteProgram(GLuint program);
+	void deleteVertexArray(GLuint vertexArray);
+	void deleteTexture(GLuint texture);
+	void deleteBuffer(GLuint buffer);
+
+	const Counters &getCounters();
+	void resetCounters();
+}
+
+#endif // GLSTATE_H_INCLUDED
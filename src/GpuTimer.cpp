@@ -0,0 +1,126 @@
+#include "GpuTimer.h"
+
+#include "GLSL.h"
+
+GpuTimer::~GpuTimer()
+{
+	for (Frame &frame : frames)
+	{
+		if (!frame.queries.empty())
+		{
+			glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+		}
+	}
+}
+
+void GpuTimer::init(const std::string &trackName)
+{
+	this->trackName = trackName;
+}
+
+void GpuTimer::beginFrame()
+{
+	recording = false;
+	if (!Profiler::isEnabled())
+	{
+		return;
+	}
+	if (!track)
+	{
+		track = Profiler::createTrack(trackName);
+	}
+
+	// oldest first, so the rows get their zones in order
+	for (int i = 1; i <= FRAMES_IN_FLIGHT; i++)
+	{
+		Frame &frame = frames[(current + i) % FRAMES_IN_FLIGHT];
+		if (frame.pending && !collect(frame))
+		{
+			break;
+		}
+	}
+
+	Frame &frame = frames[current];
+	if (frame.pending)
+	{
+		// the GPU is more than FRAMES_IN_FLIGHT frames behind; reusing the queries discards their results
+		frame.pending = false;
+		droppedFrames++;
+	}
+	frame.count = 0;
+	frame.names.clear();
+	recording = true;
+}
+
+void GpuTimer::endFrame()
+{
+	if (!recording)
+	{
+		return;
+	}
+	while (depth > 0)
+	{
+		end();
+	}
+	Frame &frame = frames[current];
+	frame.pending = frame.count > 0;
+	current = (current + 1) % FRAMES_IN_FLIGHT;
+	recording = false;
+}
+
+void GpuTimer::begin(const char *name)
+{
+	if (!recording || depth++ > 0)
+	{
+		return;
+	}
+
+	Frame &frame = frames[current];
+	if (frame.count == frame.queries.size())
+	{
+		GLuint query = 0;
+		CHECKED_GL_CALL(glGenQueries(1, &query));
+		frame.queries.push_back(query);
+	}
+	if (frame.count == 0)
+	{
+		frame.issued = Profiler::now();
+	}
+	frame.names.push_back(name);
+	CHECKED_GL_CALL(glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.count]));
+	frame.count++;
+}
+
+void GpuTimer::end()
+{
+	if (!recording || depth == 0 || --depth > 0)
+	{
+		return;
+	}
+	CHECKED_GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+}
+
+bool GpuTimer::collect(Frame &frame)
+{
+	for (size_t i = 0; i < frame.count; i++)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			return false;
+		}
+	}
+
+	uint64_t start = frame.issued;
+	for (size_t i = 0; i < frame.count; i++)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+		Profiler::record(track, frame.names[i], start, start + elapsed);
+		start += elapsed;
+	}
+	lastFrameTime = start - frame.issued;
+	frame.pending = false;
+	return true;
+}
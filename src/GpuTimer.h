@@ -0,0 +1,107 @@
+#pragma  once
+
+#ifndef GPUTIMER_H_INCLUDED
+#define GPUTIMER_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Profiler.h"
+
+// GPU time of render passes, measured with a GL_TIME_ELAPSED query around each
+// pass and added to the profiler's trace on a row of its own.
+//
+// Results are read back FRAMES_IN_FLIGHT frames later at the latest, and only
+// once the driver has them, so the timer never waits for the GPU; a frame whose
+// results are still missing when its queries are needed again is dropped. Only
+// durations are measured: a frame's passes are laid end to end from the time
+// its first pass was issued.
+//
+// Time elapsed queries cannot nest, a Zone inside another is folded into the
+// outer one. Usage: beginFrame(), Zone per pass, endFrame(), all on the GL thread.
+// Like Profiler::Zone, everything is one branch while the profiler is disabled.
+class GpuTimer
+{
+
+public:
+
+	static const int FRAMES_IN_FLIGHT = 4;
+
+	class Zone
+	{
+
+	public:
+
+		Zone(GpuTimer &timer, const char *name) : timer(Profiler::isEnabled() ? &timer : nullptr)
+		{
+			if (this->timer)
+			{
+				this->timer->begin(name);
+			}
+		}
+		~Zone()
+		{
+			if (timer)
+			{
+				timer->end();
+			}
+		}
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+
+		GpuTimer *timer;
+
+	};
+
+	GpuTimer() = default;
+	~GpuTimer();
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// Names the trace row, which is created once the profiler is enabled;
+	// queries are created as passes first need them
+	void init(const std::string &trackName = "GPU");
+
+	// Reads back the frames whose results are ready and starts a new one
+	void beginFrame();
+	void endFrame();
+
+	// nanoseconds the GPU spent in the passes of the last frame read back
+	uint64_t getLastFrameTime() const { return lastFrameTime; }
+	uint64_t getDroppedFrames() const { return droppedFrames; }
+
+private:
+
+	struct Frame
+	{
+		std::vector<GLuint> queries;
+		std::vector<const char*> names;
+		// passes issued this time round, the first count queries
+		size_t count = 0;
+		uint64_t issued = 0;
+		bool pending = false;
+	};
+
+	void begin(const char *name);
+	void end();
+	// false while any result of frame is still missing
+	bool collect(Frame &frame);
+
+	std::string trackName;
+	Profiler::Track *track = nullptr;
+	Frame frames[FRAMES_IN_FLIGHT];
+	int current = 0;
+	bool recording = false;
+	// open Zones; only the outermost has a query running
+	int depth = 0;
+	uint64_t lastFrameTime = 0;
+	uint64_t droppedFrames = 0;
+
+};
+
+#endif // GPUTIMER_H_INCLUDED
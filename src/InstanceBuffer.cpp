@@ -0,0 +1,102 @@
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLSL.h"
+#include "GLState.h"
+
+// room for a few thousand instances before the first orphan
+static const size_t INITIAL_CAPACITY = 1 << 20;
+
+InstanceBuffer::~InstanceBuffer()
+{
+	if (buffer)
+	{
+		GLState::deleteBuffer(buffer);
+	}
+}
+
+InstanceBuffer::Instance *InstanceBuffer::map(size_t count)
+{
+	size_t bytes = count * sizeof(Instance);
+	if (bytes == 0)
+	{
+		return nullptr;
+	}
+	if (!buffer)
+	{
+		CHECKED_GL_CALL(glGenBuffers(1, &buffer));
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (cursor + bytes > capacity)
+	{
+		// a fresh store, draws in flight keep reading the old one
+		capacity = std::max(std::max(capacity, INITIAL_CAPACITY), bytes);
+		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW));
+		cursor = 0;
+	}
+
+	// nothing before cursor is written again until the next orphan
+	void *data = glMapBufferRange(GL_ARRAY_BUFFER, cursor, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!data)
+	{
+		std::cerr << "Could not map the instance buffer" << std::endl;
+		return nullptr;
+	}
+	mapped = bytes;
+	isMapped = true;
+	return (Instance *) data;
+}
+
+long InstanceBuffer::unmap()
+{
+	if (!isMapped)
+	{
+		return -1;
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+	isMapped = false;
+	if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+	{
+		// the store was lost while mapped, start over on a new one
+		capacity = 0;
+		return -1;
+	}
+	long offset = (long) cursor;
+	cursor += mapped;
+	return offset;
+}
+
+long InstanceBuffer::write(const Instance *instances, size_t count)
+{
+	Instance *data = map(count);
+	if (data)
+	{
+		std::memcpy(data, instances, count * sizeof(Instance));
+	}
+	return unmap();
+}
+
+void InstanceBuffer::bindAttributes(GLuint vertexArray, long offset) const
+{
+	const GLsizei stride = sizeof(Instance);
+
+	// attribute pointers belong to the vertex array and are set for every draw,
+	// divisors and enables with them since deleted vertex array names are reused
+	GLState::bindVertexArray(vertexArray);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, stride,
+			(void*) (offset + offsetof(Instance, M) + column * sizeof(glm::vec4)));
+	}
+	glVertexAttribIPointer(ATTRIBUTE + 4, 4, GL_INT, stride, (void*) (offset + offsetof(Instance, materialIndex)));
+	glVertexAttribPointer(ATTRIBUTE + 5, 4, GL_FLOAT, GL_FALSE, stride, (void*) (offset + offsetof(Instance, uvTransform)));
+	for (GLuint location = ATTRIBUTE; location < ATTRIBUTE + ATTRIBUTE_COUNT; location++)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+}
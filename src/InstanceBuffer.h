@@ -0,0 +1,61 @@
+#pragma  once
+
+#ifndef INSTANCEBUFFER_H_INCLUDED
+#define INSTANCEBUFFER_H_INCLUDED
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "DrawRecords.h"
+
+// Per-instance copies of the PerDraw record, streamed into one vertex buffer and
+// read by instanced shaders as attributes instead of the PerDraw block:
+//
+//	layout(location = 7) in mat4 M;
+//	layout(location = 11) in ivec4 instanceDrawParams;
+//	layout(location = 12) in vec4 instanceUvTransform;
+//
+// Writes are appended behind each other with unsynchronized maps, so a draw
+// still reading earlier instances never stalls the CPU; when the buffer is full
+// its store is orphaned and writing starts over at the front.
+//
+// GL 4.1 has no base instance, so bindAttributes() points the attributes of a
+// vertex array at the instances of the next draw.
+class InstanceBuffer
+{
+
+public:
+
+	typedef DrawRecords::Record Instance;
+
+	// first attribute location, a mat4 takes four
+	static const GLuint ATTRIBUTE = 7;
+	static const GLuint ATTRIBUTE_COUNT = 6;
+
+	InstanceBuffer() = default;
+	~InstanceBuffer();
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	// Maps room for count instances; fill all of them, then call unmap()
+	Instance *map(size_t count);
+	// Returns the offset to pass to bindAttributes(), or -1 if the map failed
+	long unmap();
+	// Copies count instances, returns the same as unmap()
+	long write(const Instance *instances, size_t count);
+
+	// Binds vertexArray and points its instance attributes at offset
+	void bindAttributes(GLuint vertexArray, long offset) const;
+
+private:
+
+	GLuint buffer = 0;
+	size_t capacity = 0;
+	size_t cursor = 0;
+	size_t mapped = 0;
+	bool isMapped = false;
+
+};
+
+#endif // INSTANCEBUFFER_H_INCLUDED
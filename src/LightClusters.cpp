@@ -0,0 +1,289 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "GLSL.h"
+#include "FrameArena.h"
+#include "GLState.h"
+#include "Program.h"
+#include "ThreadPool.h"
+
+static_assert(sizeof(LightClusters::Block) == 48, "Block must match its std140 layout");
+
+// must match clusterAttenuation in resources/cluster_lights.glsl
+static const float ATTENUATION_LINEAR = 0.045f;
+static const float ATTENUATION_QUADRATIC = 0.0075f;
+static const float RADIUS_CUTOFF = 1.0f / 256.0f;
+
+enum BufferIndex
+{
+	LIGHT_BUFFER,
+	RANGE_BUFFER,
+	INDEX_BUFFER
+};
+
+LightClusters::~LightClusters()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (textures[i])
+		{
+			GLState::deleteTexture(textures[i]);
+		}
+		if (buffers[i])
+		{
+			GLState::deleteBuffer(buffers[i]);
+		}
+	}
+	if (ubo)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+}
+
+void LightClusters::init()
+{
+	Program::setUniformBlockBinding("Clusters", BINDING);
+	Program::setSamplerUnit("clusterLights", LIGHT_UNIT);
+	Program::setSamplerUnit("clusterRanges", RANGE_UNIT);
+	Program::setSamplerUnit("clusterLightIndices", INDEX_UNIT);
+
+	// GL 4.1 only guarantees 65536 texels per buffer texture, which bounds the index list
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW));
+
+	const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+	CHECKED_GL_CALL(glGenBuffers(3, buffers));
+	CHECKED_GL_CALL(glGenTextures(3, textures));
+	for (int i = 0; i < 3; i++)
+	{
+		GLState::bindTextureForEdit(GL_TEXTURE_BUFFER, textures[i]);
+		CHECKED_GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]));
+	}
+
+	ranges.resize(2 * CLUSTER_COUNT);
+	sliceIndices.resize(GRID_Z);
+}
+
+void LightClusters::clearLights()
+{
+	lights.clear();
+}
+
+void LightClusters::addLight(const glm::vec3 &position, const glm::vec3 &color, float intensity, float radius)
+{
+	if ((int) lights.size() >= MAX_LIGHTS)
+	{
+		return;
+	}
+
+	if (radius <= 0.0f)
+	{
+		// solve intensityScale * intensity * attenuation(d) = RADIUS_CUTOFF for d
+		float brightness = intensityScale * intensity * std::max(color.x, std::max(color.y, color.z)) / RADIUS_CUTOFF;
+		if (brightness <= 1.0f)
+		{
+			return;
+		}
+		radius = (-ATTENUATION_LINEAR + std::sqrt(ATTENUATION_LINEAR * ATTENUATION_LINEAR + 4.0f * ATTENUATION_QUADRATIC * (brightness - 1.0f)))
+			/ (2.0f * ATTENUATION_QUADRATIC);
+	}
+	lights.push_back({position, color, intensity, radius});
+}
+
+void LightClusters::buildBounds(const glm::mat4 &projection, float far)
+{
+	bounds.resize(CLUSTER_COUNT);
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	// view-space direction through each tile corner, scaled so z is -1
+	FrameArena::Scope scope(FrameArena::local());
+	ArenaVector<glm::vec3> corners((GRID_X + 1) * (GRID_Y + 1));
+	for (int y = 0; y <= GRID_Y; y++)
+	{
+		for (int x = 0; x <= GRID_X; x++)
+		{
+			glm::vec4 point = inverseProjection * glm::vec4(-1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * y / GRID_Y, -1.0f, 1.0f);
+			glm::vec3 direction = glm::vec3(point) / point.w;
+			corners[y * (GRID_X + 1) + x] = direction / -direction.z;
+		}
+	}
+
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		float nearDepth = z == 0 ? 0.0f : SLICE_NEAR * std::pow(far / SLICE_NEAR, (float) z / GRID_Z);
+		float farDepth = SLICE_NEAR * std::pow(far / SLICE_NEAR, (float) (z + 1) / GRID_Z);
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			for (int x = 0; x < GRID_X; x++)
+			{
+				Bounds &cluster = bounds[x + GRID_X * (y + GRID_Y * z)];
+				cluster.min = glm::vec3(std::numeric_limits<float>::max());
+				cluster.max = glm::vec3(std::numeric_limits<float>::lowest());
+				for (int corner = 0; corner < 4; corner++)
+				{
+					const glm::vec3 &direction = corners[(y + corner / 2) * (GRID_X + 1) + x + corner % 2];
+					for (float depth : {nearDepth, farDepth})
+					{
+						cluster.min = glm::min(cluster.min, direction * depth);
+						cluster.max = glm::max(cluster.max, direction * depth);
+					}
+				}
+			}
+		}
+	}
+
+	boundsProjection = projection;
+	boundsFar = far;
+}
+
+void LightClusters::binSlice(int slice, std::vector<unsigned short> &clusterIndices, GLuint *sliceCounts) const
+{
+	clusterIndices.clear();
+
+	// lights whose depth range overlaps the slice, before the per-tile test
+	const Bounds &first = bounds[GRID_X * GRID_Y * slice];
+	float sliceNear = -first.max.z, sliceFar = -first.min.z;
+	// slices run on pool workers, which never reset their arena themselves
+	FrameArena::Scope scope(FrameArena::local());
+	ArenaVector<unsigned short> candidates;
+	candidates.reserve(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const glm::vec4 &light = viewLights[2 * i];
+		if (-light.z + light.w >= sliceNear && -light.z - light.w <= sliceFar)
+		{
+			candidates.push_back((unsigned short) i);
+		}
+	}
+
+	for (int tile = 0; tile < GRID_X * GRID_Y; tile++)
+	{
+		const Bounds &cluster = bounds[GRID_X * GRID_Y * slice + tile];
+		GLuint count = 0;
+		for (unsigned short i : candidates)
+		{
+			// sphere against box: distance from the centre to the closest point of the box
+			const glm::vec4 &light = viewLights[2 * i];
+			glm::vec3 closest = glm::clamp(glm::vec3(light), cluster.min, cluster.max);
+			glm::vec3 offset = closest - glm::vec3(light);
+			if (glm::dot(offset, offset) <= light.w * light.w)
+			{
+				clusterIndices.push_back(i);
+				count++;
+			}
+		}
+		sliceCounts[tile] = count;
+	}
+}
+
+void LightClusters::build(const glm::mat4 &projection, const glm::mat4 &view, float far, int viewportWidth, int viewportHeight, ThreadPool *pool)
+{
+	if (projection != boundsProjection || far != boundsFar)
+	{
+		buildBounds(projection, far);
+	}
+
+	viewLights.resize(2 * lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		viewLights[2 * i] = glm::vec4(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+		viewLights[2 * i + 1] = glm::vec4(lights[i].color, lights[i].intensity);
+	}
+
+	// each slice is binned by one thread into its own index list and counts
+	FrameArena::Scope scope(FrameArena::local());
+	ArenaVector<GLuint> counts(CLUSTER_COUNT);
+	auto binSlices = [this, &counts](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; slice++)
+		{
+			binSlice((int) slice, sliceIndices[slice], &counts[GRID_X * GRID_Y * slice]);
+		}
+	};
+	if (pool)
+	{
+		pool->parallelFor(GRID_Z, 1, binSlices);
+	}
+	else
+	{
+		binSlices(0, GRID_Z);
+	}
+
+	// concatenate the slices in cluster order, so every cluster's lights are contiguous
+	indices.clear();
+	maxClusterLights = 0;
+	bool truncated = false;
+	for (int slice = 0; slice < GRID_Z; slice++)
+	{
+		const std::vector<unsigned short> &source = sliceIndices[slice];
+		size_t read = 0;
+		for (int tile = 0; tile < GRID_X * GRID_Y; tile++)
+		{
+			int cluster = GRID_X * GRID_Y * slice + tile;
+			GLuint count = counts[cluster];
+			GLuint kept = (GLuint) std::min<size_t>(count, (size_t) maxTexels - indices.size());
+			truncated = truncated || kept < count;
+			ranges[2 * cluster] = (GLuint) indices.size();
+			ranges[2 * cluster + 1] = kept;
+			indices.insert(indices.end(), source.begin() + read, source.begin() + read + kept);
+			read += count;
+			maxClusterLights = std::max(maxClusterLights, kept);
+		}
+	}
+	if (truncated)
+	{
+		std::cerr << "LightClusters: more than " << maxTexels << " light references, some clusters lost lights" << std::endl;
+	}
+
+	float sliceScale = GRID_Z / std::log(far / SLICE_NEAR);
+	block.grid[0] = GRID_X;
+	block.grid[1] = GRID_Y;
+	block.grid[2] = GRID_Z;
+	block.grid[3] = (GLint) lights.size();
+	block.depth = glm::vec4(SLICE_NEAR, far, sliceScale, std::log(SLICE_NEAR) * sliceScale);
+	block.tile = glm::vec4((float) viewportWidth / GRID_X, (float) viewportHeight / GRID_Y, 0.0f, 0.0f);
+}
+
+void LightClusters::upload()
+{
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	// orphaned like the per-frame block
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+
+	// glBufferData with the new contents replaces the store without waiting on last
+	// frame's draws; never empty, so the texture always has a store attached
+	static const glm::vec4 noLight[2] = {};
+	static const unsigned short noIndex = 0;
+	GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[LIGHT_BUFFER]);
+	if (viewLights.empty())
+	{
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(noLight), noLight, GL_STREAM_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_TEXTURE_BUFFER, viewLights.size() * sizeof(glm::vec4), viewLights.data(), GL_STREAM_DRAW);
+	}
+	GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[RANGE_BUFFER]);
+	glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(GLuint), ranges.data(), GL_STREAM_DRAW);
+	GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[INDEX_BUFFER]);
+	if (indices.empty())
+	{
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(noIndex), &noIndex, GL_STREAM_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STREAM_DRAW);
+	}
+
+	GLState::bindTexture(LIGHT_UNIT, GL_TEXTURE_BUFFER, textures[LIGHT_BUFFER]);
+	GLState::bindTexture(RANGE_UNIT, GL_TEXTURE_BUFFER, textures[RANGE_BUFFER]);
+	GLState::bindTexture(INDEX_UNIT, GL_TEXTURE_BUFFER, textures[INDEX_BUFFER]);
+}
@@ -0,0 +1,125 @@
+#pragma  once
+
+#ifndef LIGHTCLUSTERS_H_INCLUDED
+#define LIGHTCLUSTERS_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+// Clustered forward lighting. The view frustum is split into a GRID_X x GRID_Y
+// grid of screen tiles and GRID_Z depth slices (exponential in view depth). Each
+// frame the lights are binned into the clusters their range touches, on the
+// thread pool, and three buffer textures are uploaded:
+//
+//	clusterLights        RGBA32F, two texels per light: view-space position and
+//	                     radius, then color and intensity
+//	clusterRanges        RG32UI, per cluster: first entry in the index list, count
+//	clusterLightIndices  R16UI, light indices of every cluster back to back
+//
+// plus the "Clusters" uniform block (see build()) that fragment shaders use to
+// find their cluster from gl_FragCoord and view depth. A fragment then only loops
+// over the lights whose range reaches its cluster. The shader side of all this
+// is resources/cluster_lights.glsl, which lit programs get as their fragment prelude.
+class LightClusters
+{
+
+public:
+
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	// clusterLightIndices is R16UI
+	static const int MAX_LIGHTS = 4096;
+	static const GLuint BINDING = 4;
+	// buffer texture units, after the material batcher's array unit
+	static const GLint LIGHT_UNIT = 8;
+	static const GLint RANGE_UNIT = 9;
+	static const GLint INDEX_UNIT = 10;
+	// the first slice spans everything closer than this, so the log slicing is
+	// not spent on the few centimetres in front of the camera
+	static constexpr float SLICE_NEAR = 0.5f;
+
+	// CPU mirror of the Clusters block, laid out by std140 rules
+	struct Block
+	{
+		GLint grid[4];        // xyz cluster counts, w light count
+		glm::vec4 depth;      // x slice near, y far, z slice scale, w slice bias
+		glm::vec4 tile;       // xy tile size in pixels
+	};
+
+	// as passed to addLight()
+	struct Light
+	{
+		glm::vec3 position;
+		glm::vec3 color;
+		float intensity;
+		float radius;
+	};
+
+	LightClusters() = default;
+	~LightClusters();
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Creates the buffers and registers the block binding and sampler units; call before linking programs
+	void init();
+
+	void clearLights();
+	// World-space position. radius 0 picks the distance at which the shaders'
+	// attenuation has faded the light below 1/256 at the intensity scale. Lights
+	// past MAX_LIGHTS are dropped.
+	void addLight(const glm::vec3 &position, const glm::vec3 &color, float intensity, float radius = 0.0f);
+	int getLightCount() const { return (int) lights.size(); }
+	// The largest lightIntensityScale a program multiplies light colors by, so
+	// automatic radii reach as far as the brightest program lights
+	void setIntensityScale(float scale) { intensityScale = scale; }
+	float getIntensityScale() const { return intensityScale; }
+
+	// Bins the lights for this camera; pool may be null to bin on the calling thread
+	void build(const glm::mat4 &projection, const glm::mat4 &view, float far, int viewportWidth, int viewportHeight, ThreadPool *pool);
+	// Writes the buffers and binds them to their units and BINDING
+	void upload();
+
+	// light references over all clusters, and the most any one cluster holds
+	size_t getIndexCount() const { return indices.size(); }
+	unsigned int getMaxClusterLights() const { return maxClusterLights; }
+
+private:
+
+	struct Bounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	void buildBounds(const glm::mat4 &projection, float far);
+	void binSlice(int slice, std::vector<unsigned short> &clusterIndices, GLuint *sliceCounts) const;
+
+	std::vector<Light> lights;
+	float intensityScale = 1.0f;
+	// view-space lights packed as the clusterLights texels
+	std::vector<glm::vec4> viewLights;
+	// view-space bounds of every cluster, rebuilt when the projection changes
+	std::vector<Bounds> bounds;
+	glm::mat4 boundsProjection = glm::mat4(0.0f);
+	float boundsFar = 0.0f;
+
+	std::vector<GLuint> ranges;
+	std::vector<unsigned short> indices;
+	std::vector<std::vector<unsigned short>> sliceIndices;
+	unsigned int maxClusterLights = 0;
+	GLint maxTexels = 65536;
+
+	Block block = {};
+	GLuint ubo = 0;
+	GLuint buffers[3] = {};
+	GLuint textures[3] = {};
+
+};
+
+#endif // LIGHTCLUSTERS_H_INCLUDED
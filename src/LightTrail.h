@@ -8,6 +8,7 @@
 #include <vector>
 #include <deque>
 #include "Program.h"
+#include "GLState.h"
 
 using namespace glm;
 using namespace std;
@@ -54,9 +55,9 @@ public:
     }
 
     ~LightTrail() {
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glDeleteVertexArrays(1, &VAO);
+        GLState::deleteBuffer(VBO);
+        GLState::deleteBuffer(EBO);
+        GLState::deleteVertexArray(VAO);
     }
 
     void initBuffers() {
@@ -65,20 +66,18 @@ public:
         indices.clear();
 
         glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
 
         glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
 
         glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
-
-        glBindVertexArray(0);
     }
 
     void setStartPos(const vec3& pos) {
@@ -243,15 +242,13 @@ public:
         }
 
         // Update the GPU buffers
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), vertices.data(), GL_DYNAMIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
-
-        glBindVertexArray(0);
     }
 
     void draw() {
@@ -270,9 +267,8 @@ public:
         //     glUniform4fv(shaderProg->getUniform("trailColor"), 1, value_ptr(trailColor));
         // }
 
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
 
         // shaderProg->unbind();
     }
@@ -0,0 +1,205 @@
+#include "MaterialBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+
+MaterialBatcher::~MaterialBatcher()
+{
+	for (GLuint array : arrays)
+	{
+		GLState::deleteTexture(array);
+	}
+}
+
+void MaterialBatcher::registerSamplerUnits()
+{
+	Program::setSamplerUnit("TextureArray0", ARRAY_UNIT);
+}
+
+void MaterialBatcher::add(GLuint texture)
+{
+	if (texture == 0 || placements.count(texture) || std::find(pending.begin(), pending.end(), texture) != pending.end())
+	{
+		return;
+	}
+	pending.push_back(texture);
+}
+
+const MaterialBatcher::Placement *MaterialBatcher::find(GLuint texture) const
+{
+	auto placement = placements.find(texture);
+	return placement != placements.end() ? &placement->second : nullptr;
+}
+
+bool MaterialBatcher::readBack(GLuint texture, Image &image) const
+{
+	GLState::bindTextureForEdit(GL_TEXTURE_2D, texture);
+	GLint width = 0, height = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	if (width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	image.source = texture;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize((size_t) width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	return true;
+}
+
+void MaterialBatcher::build()
+{
+	std::vector<Image> images(pending.size());
+	std::vector<Image*> large, small;
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		if (!readBack(pending[i], images[i]))
+		{
+			std::cerr << "MaterialBatcher: texture " << pending[i] << " has no level 0, left unbatched" << std::endl;
+			continue;
+		}
+		if (images[i].width > ATLAS_MAX_ENTRY || images[i].height > ATLAS_MAX_ENTRY)
+		{
+			large.push_back(&images[i]);
+		}
+		else
+		{
+			small.push_back(&images[i]);
+		}
+	}
+	pending.clear();
+
+	int arraysBefore = getArrayCount();
+	buildLayers(large);
+	buildAtlas(small);
+	std::cout << "MaterialBatcher: packed " << large.size() << " textures as layers and " << small.size()
+		<< " into atlases, " << getArrayCount() - arraysBefore << " texture arrays" << std::endl;
+}
+
+void MaterialBatcher::buildLayers(std::vector<Image*> &images)
+{
+	// one array per distinct size, layers in the order the textures were added
+	std::stable_sort(images.begin(), images.end(), [](const Image *a, const Image *b) {
+		return a->width != b->width ? a->width < b->width : a->height < b->height;
+	});
+
+	size_t begin = 0;
+	while (begin < images.size())
+	{
+		size_t end = begin;
+		while (end < images.size() && images[end]->width == images[begin]->width && images[end]->height == images[begin]->height)
+		{
+			end++;
+		}
+
+		GLsizei width = images[begin]->width;
+		GLsizei height = images[begin]->height;
+		GLuint array;
+		glGenTextures(1, &array);
+		GLState::bindTextureForEdit(GL_TEXTURE_2D_ARRAY, array);
+		CHECKED_GL_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei) (end - begin), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t i = begin; i < end; i++)
+		{
+			GLint layer = (GLint) (i - begin);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, images[i]->pixels.data());
+
+			Placement &placement = placements[images[i]->source];
+			placement.array = (int) arrays.size();
+			placement.layer = layer;
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		arrays.push_back(array);
+
+		begin = end;
+	}
+}
+
+void MaterialBatcher::buildAtlas(std::vector<Image*> &images)
+{
+	if (images.empty())
+	{
+		return;
+	}
+
+	// shelf packing, tallest first so each shelf wastes little height
+	std::stable_sort(images.begin(), images.end(), [](const Image *a, const Image *b) {
+		return a->height > b->height;
+	});
+
+	const size_t pageBytes = (size_t) ATLAS_SIZE * ATLAS_SIZE * 4;
+	std::vector<std::vector<unsigned char>> pages(1, std::vector<unsigned char>(pageBytes, 0));
+	GLsizei shelfX = 0, shelfY = 0, shelfHeight = 0;
+	int arrayIndex = (int) arrays.size();
+
+	for (Image *image : images)
+	{
+		GLsizei paddedWidth = image->width + 2 * ATLAS_GUTTER;
+		GLsizei paddedHeight = image->height + 2 * ATLAS_GUTTER;
+		if (shelfX + paddedWidth > ATLAS_SIZE)
+		{
+			shelfX = 0;
+			shelfY += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (shelfY + paddedHeight > ATLAS_SIZE)
+		{
+			pages.emplace_back(pageBytes, 0);
+			shelfX = shelfY = shelfHeight = 0;
+		}
+
+		// the gutter repeats the opposite edge, matching GL_REPEAT across the entry's border
+		unsigned char *page = pages.back().data();
+		for (GLsizei y = 0; y < paddedHeight; y++)
+		{
+			GLsizei sourceY = ((y - ATLAS_GUTTER) % image->height + image->height) % image->height;
+			unsigned char *row = page + ((size_t) (shelfY + y) * ATLAS_SIZE + shelfX) * 4;
+			for (GLsizei x = 0; x < paddedWidth; x++)
+			{
+				GLsizei sourceX = ((x - ATLAS_GUTTER) % image->width + image->width) % image->width;
+				std::memcpy(row + x * 4, &image->pixels[((size_t) sourceY * image->width + sourceX) * 4], 4);
+			}
+		}
+
+		Placement &placement = placements[image->source];
+		placement.array = arrayIndex;
+		placement.layer = (GLint) pages.size() - 1;
+		placement.uvTransform = glm::vec4(
+			(float) image->width / ATLAS_SIZE, (float) image->height / ATLAS_SIZE,
+			(float) (shelfX + ATLAS_GUTTER) / ATLAS_SIZE, (float) (shelfY + ATLAS_GUTTER) / ATLAS_SIZE);
+		placement.atlased = true;
+
+		shelfX += paddedWidth;
+		shelfHeight = std::max(shelfHeight, paddedHeight);
+	}
+
+	GLuint array;
+	glGenTextures(1, &array);
+	GLState::bindTextureForEdit(GL_TEXTURE_2D_ARRAY, array);
+	CHECKED_GL_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, (GLsizei) pages.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t layer = 0; layer < pages.size(); layer++)
+	{
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint) layer, ATLAS_SIZE, ATLAS_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, pages[layer].data());
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, ATLAS_MAX_LEVEL);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	arrays.push_back(array);
+}
@@ -0,0 +1,86 @@
+#pragma  once
+
+#ifndef MATERIALBATCHER_H_INCLUDED
+#define MATERIALBATCHER_H_INCLUDED
+
+#include <map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "AssimpMesh.h"
+
+// Repacks separately loaded 2D textures into a few GL_TEXTURE_2D_ARRAYs so meshes
+// with different materials can be drawn back to back without rebinding textures.
+//
+// Textures larger than ATLAS_MAX_ENTRY are grouped by size, one array per size
+// and one layer per texture. Smaller ones are packed into ATLAS_SIZE pages with a
+// gutter of repeated edge texels; the pages are the layers of one more array and
+// each entry gets a UV scale and offset. Draws pass the layer and UV transform in
+// their DrawRecords entry and sample with tex_array_frag.glsl.
+//
+// Everything is converted to RGBA8. The source textures are only read back and
+// stay valid.
+class MaterialBatcher
+{
+
+public:
+
+	static const GLsizei ATLAS_SIZE = 1024;
+	static const GLsizei ATLAS_MAX_ENTRY = 256;
+	static const GLsizei ATLAS_GUTTER = 8;
+	// coarser mips of an atlas page would blend neighbouring entries across the gutter
+	static const GLint ATLAS_MAX_LEVEL = 3;
+	// texture unit of the TextureArray0 sampler
+	static const GLuint ARRAY_UNIT = TEXTURE_SLOT_COUNT;
+
+	struct Placement
+	{
+		// index of the texture array, see getArrayTexture()
+		int array = -1;
+		GLint layer = 0;
+		// xy scale, zw offset applied to the mesh UVs
+		glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		bool atlased = false;
+	};
+
+	MaterialBatcher() = default;
+	~MaterialBatcher();
+	MaterialBatcher(const MaterialBatcher&) = delete;
+	MaterialBatcher& operator=(const MaterialBatcher&) = delete;
+
+	// Registers the array sampler's unit; call before linking programs
+	static void registerSamplerUnits();
+
+	// Queues a texture for packing; adding one twice is harmless
+	void add(GLuint texture);
+	// Packs everything added since the last build into new arrays
+	void build();
+
+	// nullptr when the texture was never added
+	const Placement *find(GLuint texture) const;
+	GLuint getArrayTexture(int array) const { return arrays[array]; }
+	int getArrayCount() const { return (int) arrays.size(); }
+
+private:
+
+	struct Image
+	{
+		GLuint source;
+		GLsizei width;
+		GLsizei height;
+		std::vector<unsigned char> pixels;
+	};
+
+	bool readBack(GLuint texture, Image &image) const;
+	void buildLayers(std::vector<Image*> &images);
+	void buildAtlas(std::vector<Image*> &images);
+
+	std::vector<GLuint> pending;
+	std::map<GLuint, Placement> placements;
+	std::vector<GLuint> arrays;
+
+};
+
+#endif // MATERIALBATCHER_H_INCLUDED
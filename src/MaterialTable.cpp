@@ -0,0 +1,48 @@
+#include "MaterialTable.h"
+
+#include <iostream>
+
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+
+static_assert(sizeof(MaterialTable::Material) == 48, "Material must match its std140 layout");
+
+MaterialTable::~MaterialTable()
+{
+	if (ubo)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+}
+
+void MaterialTable::init()
+{
+	Program::setUniformBlockBinding("Materials", BINDING);
+
+	// the block is declared with MAX_MATERIALS entries, so the whole array is always backed
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(Material), nullptr, GL_STATIC_DRAW));
+}
+
+int MaterialTable::add(const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess)
+{
+	if ((int) materials.size() >= MAX_MATERIALS)
+	{
+		std::cerr << "Material table is full (" << MAX_MATERIALS << " materials)" << std::endl;
+		return -1;
+	}
+	materials.push_back({glm::vec4(ambient, 1.0f), glm::vec4(diffuse, 1.0f), glm::vec4(specular, shininess)});
+	return (int) materials.size() - 1;
+}
+
+void MaterialTable::upload()
+{
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	if (!materials.empty())
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(Material), materials.data());
+	}
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
@@ -0,0 +1,60 @@
+#pragma  once
+
+#ifndef MATERIALTABLE_H_INCLUDED
+#define MATERIALTABLE_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Every material the scene uses, kept in one std140 uniform buffer so draws only
+// carry an index into it (see DrawRecords). Shaders declare:
+//
+//	struct Material {
+//		vec4 ambient;
+//		vec4 diffuse;
+//		vec4 specular;  // rgb specular, a shininess
+//	};
+//	layout(std140) uniform Materials {
+//		Material materials[MAX_MATERIALS];
+//	};
+class MaterialTable
+{
+
+public:
+
+	static const GLuint BINDING = 2;
+	static const int MAX_MATERIALS = 16;
+
+	struct Material
+	{
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+
+	MaterialTable() = default;
+	~MaterialTable();
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	// Creates the buffer and registers the block binding; call before linking programs
+	void init();
+
+	// Returns the material's index, or -1 when the table is full
+	int add(const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess);
+	int getCount() const { return (int) materials.size(); }
+
+	// Writes the table to the buffer and binds it to BINDING; materials rarely
+	// change, so this is called after adding them rather than every frame
+	void upload();
+
+private:
+
+	std::vector<Material> materials;
+	GLuint ubo = 0;
+
+};
+
+#endif // MATERIALTABLE_H_INCLUDED
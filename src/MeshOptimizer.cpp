@@ -0,0 +1,712 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    // Scoring parameters from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    const int SCORE_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRI_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // Clusters smaller than this are merged into their predecessor so the
+    // overdraw pass does not shred the vertex cache ordering
+    const size_t MIN_CLUSTER_TRIANGLES = 16;
+
+    float vertexScore(int cachePosition, unsigned int liveTriangles) {
+        if (liveTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the triangle that was just emitted, fixed score so strips are not favoured too much
+                score = LAST_TRI_SCORE;
+            } else {
+                const float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        // boost vertices with few triangles left so they get finished off
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    uint64_t hashBytes(const unsigned char *data, size_t size) {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    const float *positionAt(const float *positions, size_t stride, unsigned int index) {
+        return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + index * stride);
+    }
+
+    // Symmetric 3x3 matrix A, vector b and constant c of an area weighted plane quadric
+    struct Quadric {
+        double a00, a11, a22, a10, a20, a21;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    void quadricAdd(Quadric &q, const Quadric &r) {
+        q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+        q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+        q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+        q.c += r.c;
+        q.weight += r.weight;
+    }
+
+    void quadricFromTriangle(Quadric &q, const float *p0, const float *p1, const float *p2) {
+        double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        q = Quadric();
+        if (area <= 0.0) {
+            return;
+        }
+
+        double a = n[0] / area, b = n[1] / area, c = n[2] / area;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+
+        q.a00 = area * a * a; q.a11 = area * b * b; q.a22 = area * c * c;
+        q.a10 = area * a * b; q.a20 = area * a * c; q.a21 = area * b * c;
+        q.b0 = area * a * d; q.b1 = area * b * d; q.b2 = area * c * d;
+        q.c = area * d * d;
+        q.weight = area;
+    }
+
+    // Weighted mean squared distance of p to the planes accumulated in q
+    double quadricError(const Quadric &q, const float *p) {
+        double x = p[0], y = p[1], z = p[2];
+        double r = x * (q.a00 * x + q.a10 * y + q.a20 * z)
+                 + y * (q.a10 * x + q.a11 * y + q.a21 * z)
+                 + z * (q.a20 * x + q.a21 * y + q.a22 * z)
+                 + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+                 + q.c;
+        return q.weight > 0.0 ? std::fabs(r) / q.weight : 0.0;
+    }
+
+    void triangleNormal(float *n, const float *p0, const float *p1, const float *p2) {
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double error;
+    };
+}
+
+namespace MeshOptimizer
+{
+
+size_t generateVertexRemap(std::vector<unsigned int> &remap, const void *vertices, size_t vertexCount, size_t vertexSize) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(vertices);
+    remap.assign(vertexCount, INVALID_INDEX);
+
+    // open addressing table holding the first vertex seen for each unique key
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2) {
+        tableSize *= 2;
+    }
+    std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < vertexCount; i++) {
+        const unsigned char *vertex = bytes + i * vertexSize;
+        size_t slot = hashBytes(vertex, vertexSize) & (tableSize - 1);
+
+        while (table[slot] != INVALID_INDEX &&
+               std::memcmp(bytes + table[slot] * vertexSize, vertex, vertexSize) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == INVALID_INDEX) {
+            table[slot] = static_cast<unsigned int>(i);
+            remap[i] = static_cast<unsigned int>(uniqueCount++);
+        } else {
+            remap[i] = remap[table[slot]];
+        }
+    }
+
+    return uniqueCount;
+}
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangle adjacency in compressed rows; the live part of each row shrinks as triangles are emitted
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices) {
+        liveTriangles[index]++;
+    }
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    }
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+    }
+
+    int best = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        float score = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        if (score > bestScore) {
+            bestScore = score;
+            best = static_cast<int>(t);
+        }
+    }
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    unsigned int cache[SCORE_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t inputCursor = 0;
+
+    while (best >= 0) {
+        const unsigned int tri[3] = { indices[best * 3 + 0], indices[best * 3 + 1], indices[best * 3 + 2] };
+        emitted[best] = 1;
+        result.insert(result.end(), tri, tri + 3);
+
+        // the emitted triangle moves to the front of the cache
+        unsigned int newCache[SCORE_CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; k++) {
+            newCache[newCount++] = tri[k];
+        }
+        for (int i = 0; i < cacheCount; i++) {
+            unsigned int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // drop the triangle from its vertices' live adjacency
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            unsigned int *row = &adjacency[adjacencyOffset[v]];
+            for (unsigned int i = 0; i < liveTriangles[v]; i++) {
+                if (row[i] == static_cast<unsigned int>(best)) {
+                    row[i] = row[liveTriangles[v] - 1];
+                    liveTriangles[v]--;
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < newCount; i++) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < SCORE_CACHE_SIZE ? i : -1;
+            vertexScores[v] = vertexScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        // only triangles touching the cache can have changed score
+        best = -1;
+        bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++) {
+            unsigned int v = newCache[i];
+            const unsigned int *row = &adjacency[adjacencyOffset[v]];
+            for (unsigned int j = 0; j < liveTriangles[v]; j++) {
+                unsigned int t = row[j];
+                float score = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = static_cast<int>(t);
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, SCORE_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        if (best < 0) {
+            // cache is exhausted, continue with the next triangle in input order
+            while (inputCursor < triangleCount && emitted[inputCursor]) {
+                inputCursor++;
+            }
+            if (inputCursor < triangleCount) {
+                best = static_cast<int>(inputCursor);
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int> &indices, const float *positions, size_t positionStride, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < MIN_CLUSTER_TRIANGLES * 2) {
+        return;
+    }
+
+    // split the cache optimized order where the cache runs cold, reordering at those points is free
+    std::vector<size_t> clusterStart;
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = DEFAULT_CACHE_SIZE + 1;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (timestamp - cacheTimestamps[v] > DEFAULT_CACHE_SIZE) {
+                cacheTimestamps[v] = timestamp++;
+                misses++;
+            }
+        }
+
+        if (t == 0 || (misses == 3 && t - clusterStart.back() >= MIN_CLUSTER_TRIANGLES)) {
+            clusterStart.push_back(t);
+        }
+    }
+
+    if (clusterStart.size() < 2) {
+        return;
+    }
+    clusterStart.push_back(triangleCount);
+
+    // area weighted centroid and normal of each cluster
+    const size_t clusterCount = clusterStart.size() - 1;
+    std::vector<float> clusterData(clusterCount * 6, 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++) {
+        float *data = &clusterData[c * 6];
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+            const float *p0 = positionAt(positions, positionStride, indices[t * 3 + 0]);
+            const float *p1 = positionAt(positions, positionStride, indices[t * 3 + 1]);
+            const float *p2 = positionAt(positions, positionStride, indices[t * 3 + 2]);
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; k++) {
+                data[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                data[3 + k] += n[k];
+            }
+            clusterArea += area;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            meshCentroid[k] += data[k];
+            data[k] = clusterArea > 0.0f ? data[k] / clusterArea : 0.0f;
+        }
+        meshArea += clusterArea;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+    }
+
+    // clusters facing away from the center are likely occluders, draw them first
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        const float *data = &clusterData[c * 6];
+        float length = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        float dot = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            dot += (data[k] - meshCentroid[k]) * data[3 + k];
+        }
+        sortKey[c] = length > 0.0f ? dot / length : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order) {
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+size_t generateVertexFetchRemap(std::vector<unsigned int> &remap, const std::vector<unsigned int> &indices, size_t vertexCount) {
+    remap.assign(vertexCount, INVALID_INDEX);
+
+    unsigned int next = 0;
+    for (unsigned int index : indices) {
+        if (remap[index] == INVALID_INDEX) {
+            remap[index] = next++;
+        }
+    }
+
+    return next;
+}
+
+float analyzeACMR(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return 0.0f;
+    }
+
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    size_t misses = 0;
+
+    for (unsigned int index : indices) {
+        if (timestamp - cacheTimestamps[index] > cacheSize) {
+            cacheTimestamps[index] = timestamp++;
+            misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(triangleCount);
+}
+
+void remapIndices(std::vector<unsigned int> &indices, const std::vector<unsigned int> &remap) {
+    for (unsigned int &index : indices) {
+        index = remap[index];
+    }
+}
+
+size_t simplify(std::vector<unsigned int> &destination, const std::vector<unsigned int> &indices,
+                const float *positions, size_t positionStride, size_t vertexCount,
+                size_t targetIndexCount, float targetError,
+                const unsigned int *attributeClass, float *resultError) {
+    destination = indices;
+    if (resultError) {
+        *resultError = 0.0f;
+    }
+    if (indices.size() <= targetIndexCount || vertexCount == 0) {
+        return destination.size();
+    }
+
+    // errors are relative to the largest extent of the mesh
+    std::vector<float> compactPositions(vertexCount * 3);
+    float minP[3] = { positions[0], positions[1], positions[2] };
+    float maxP[3] = { positions[0], positions[1], positions[2] };
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float *p = positionAt(positions, positionStride, static_cast<unsigned int>(v));
+        for (int k = 0; k < 3; k++) {
+            compactPositions[v * 3 + k] = p[k];
+            minP[k] = std::min(minP[k], p[k]);
+            maxP[k] = std::max(maxP[k], p[k]);
+        }
+    }
+    float extent = std::max(maxP[0] - minP[0], std::max(maxP[1] - minP[1], maxP[2] - minP[2]));
+    if (extent <= 0.0f) {
+        return destination.size();
+    }
+    const double maxError = static_cast<double>(targetError) * extent * targetError * extent;
+
+    // Vertices sharing a position but not attributes are wedges of one position class; a UV or
+    // normal seam runs along edges whose wedges differ on either side. Collapses are decided per
+    // class and applied to every wedge, so both sides of a seam move together and it stays closed
+    std::vector<unsigned int> positionClass;
+    size_t positionCount = generateVertexRemap(positionClass, compactPositions.data(), vertexCount, sizeof(float) * 3);
+    // wedges of a class as a circular list
+    std::vector<unsigned int> nextWedge(vertexCount);
+    std::vector<unsigned int> lastWedge(positionCount, INVALID_INDEX);
+    for (size_t v = 0; v < vertexCount; v++) {
+        unsigned int c = positionClass[v];
+        if (lastWedge[c] == INVALID_INDEX) {
+            nextWedge[v] = static_cast<unsigned int>(v);
+        } else {
+            nextWedge[v] = nextWedge[lastWedge[c]];
+            nextWedge[lastWedge[c]] = static_cast<unsigned int>(v);
+        }
+        lastWedge[c] = static_cast<unsigned int>(v);
+    }
+
+    // open border edges are used by a single triangle, lock their endpoints so holes do not grow
+    std::unordered_map<uint64_t, unsigned int> edgeUse;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = positionClass[indices[i + k]];
+            uint64_t b = positionClass[indices[i + (k + 1) % 3]];
+            edgeUse[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    }
+
+    std::vector<char> lockedClass(positionCount, 0);
+    for (const auto &edge : edgeUse) {
+        if (edge.second == 1) {
+            lockedClass[edge.first >> 32] = 1;
+            lockedClass[edge.first & 0xffffffffull] = 1;
+        }
+    }
+
+    // per class, the wedges share the position and so the error
+    std::vector<Quadric> quadrics(positionCount, Quadric());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        Quadric q;
+        quadricFromTriangle(q, &compactPositions[indices[i + 0] * 3], &compactPositions[indices[i + 1] * 3], &compactPositions[indices[i + 2] * 3]);
+        for (int k = 0; k < 3; k++) {
+            quadricAdd(quadrics[positionClass[indices[i + k]]], q);
+        }
+    }
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<char> touched(positionCount);
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> collapses;
+    // wedge of the target class each wedge of the collapsing class moves onto
+    std::vector<std::pair<unsigned int, unsigned int>> wedgeMoves;
+    double collapsedError = 0.0;
+
+    while (destination.size() > targetIndexCount) {
+        const size_t triangleCount = destination.size() / 3;
+
+        // vertex -> triangle adjacency for the current level
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (unsigned int index : destination) {
+            adjacencyOffset[index + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        adjacency.resize(destination.size());
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[destination[t * 3 + k]]++] = static_cast<unsigned int>(t);
+            }
+        }
+
+        // cheapest direction for every edge
+        collapses.clear();
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = destination[i + k];
+                unsigned int b = destination[i + (k + 1) % 3];
+
+                Collapse best = { 0, 0, -1.0 };
+                for (int dir = 0; dir < 2; dir++) {
+                    unsigned int from = dir == 0 ? a : b;
+                    unsigned int to = dir == 0 ? b : a;
+                    if (lockedClass[positionClass[from]] || (attributeClass && attributeClass[from] != attributeClass[to])) {
+                        continue;
+                    }
+
+                    Quadric q = quadrics[positionClass[from]];
+                    quadricAdd(q, quadrics[positionClass[to]]);
+                    double error = quadricError(q, &compactPositions[to * 3]);
+                    if (best.error < 0.0 || error < best.error) {
+                        best = { from, to, error };
+                    }
+                }
+
+                if (best.error >= 0.0) {
+                    collapses.push_back(best);
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.error < b.error;
+        });
+
+        for (size_t v = 0; v < vertexCount; v++) {
+            remap[v] = static_cast<unsigned int>(v);
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+
+        const size_t trianglesToRemove = (destination.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+        size_t collapseCount = 0;
+
+        for (const Collapse &collapse : collapses) {
+            if (collapse.error > maxError || removedTriangles >= trianglesToRemove) {
+                break;
+            }
+            const unsigned int fromClass = positionClass[collapse.from];
+            const unsigned int toClass = positionClass[collapse.to];
+            if (touched[fromClass] || touched[toClass]) {
+                continue;
+            }
+
+            // Every wedge still in use has to move onto the one wedge of the target it shares an
+            // edge with. A wedge with none would leave the surface (e.g. sliding a seam vertex off
+            // its seam), one with several sits where seams branch; either rejects the collapse
+            bool valid = true;
+            wedgeMoves.clear();
+            unsigned int wedge = collapse.from;
+            do {
+                unsigned int partner = INVALID_INDEX;
+                for (unsigned int j = adjacencyOffset[wedge]; j < adjacencyOffset[wedge + 1] && valid; j++) {
+                    const unsigned int *tri = &destination[adjacency[j] * 3];
+                    for (int k = 0; k < 3; k++) {
+                        if (positionClass[tri[k]] != toClass) {
+                            continue;
+                        }
+                        if (partner != INVALID_INDEX && partner != tri[k]) {
+                            valid = false;
+                        }
+                        partner = tri[k];
+                    }
+                }
+                if (adjacencyOffset[wedge] != adjacencyOffset[wedge + 1]) {
+                    valid = valid && partner != INVALID_INDEX &&
+                            (!attributeClass || attributeClass[wedge] == attributeClass[partner]);
+                    wedgeMoves.push_back({ wedge, partner });
+                }
+                wedge = nextWedge[wedge];
+            } while (wedge != collapse.from && valid);
+
+            // reject collapses that would flip a surviving triangle
+            size_t dying = 0;
+            for (size_t m = 0; m < wedgeMoves.size() && valid; m++) {
+                const unsigned int from = wedgeMoves[m].first, to = wedgeMoves[m].second;
+                for (unsigned int j = adjacencyOffset[from]; j < adjacencyOffset[from + 1] && valid; j++) {
+                    const unsigned int *tri = &destination[adjacency[j] * 3];
+                    if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                        dying++;
+                        continue;
+                    }
+
+                    const float *before[3];
+                    const float *after[3];
+                    for (int k = 0; k < 3; k++) {
+                        before[k] = &compactPositions[tri[k] * 3];
+                        after[k] = tri[k] == from ? &compactPositions[to * 3] : before[k];
+                    }
+
+                    float n0[3], n1[3];
+                    triangleNormal(n0, before[0], before[1], before[2]);
+                    triangleNormal(n1, after[0], after[1], after[2]);
+                    valid = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] > 0.0f;
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+
+            for (const auto &move : wedgeMoves) {
+                remap[move.first] = move.second;
+            }
+            quadricAdd(quadrics[toClass], quadrics[fromClass]);
+            collapsedError = std::max(collapsedError, collapse.error);
+
+            // the one-rings of the collapsed wedges changed, leave them alone for the rest of this pass
+            for (const auto &move : wedgeMoves) {
+                for (unsigned int j = adjacencyOffset[move.first]; j < adjacencyOffset[move.first + 1]; j++) {
+                    const unsigned int *tri = &destination[adjacency[j] * 3];
+                    for (int k = 0; k < 3; k++) {
+                        touched[positionClass[tri[k]]] = 1;
+                    }
+                }
+            }
+
+            removedTriangles += dying;
+            collapseCount++;
+        }
+
+        if (collapseCount == 0) {
+            break;
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(destination.size());
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            unsigned int a = remap[destination[i + 0]];
+            unsigned int b = remap[destination[i + 1]];
+            unsigned int c = remap[destination[i + 2]];
+            if (a != b && b != c && c != a) {
+                result.push_back(a);
+                result.push_back(b);
+                result.push_back(c);
+            }
+        }
+        destination.swap(result);
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(collapsedError) / extent);
+    }
+    return destination.size();
+}
+
+void buildLodChain(std::vector<unsigned int> &indices, std::vector<LodRange> &lods,
+                   const float *positions, size_t positionStride, size_t vertexCount,
+                   size_t maxLods, float maxError, const unsigned int *attributeClass) {
+    lods.clear();
+    if (indices.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<unsigned int>> levels;
+    levels.push_back(std::move(indices));
+    std::vector<float> levelErrors(1, 0.0f);
+    while (levels.size() < maxLods) {
+        const std::vector<unsigned int> &previous = levels.back();
+        std::vector<unsigned int> level;
+        float error = 0.0f;
+        simplify(level, previous, positions, positionStride, vertexCount,
+                 previous.size() / 6 * 3, maxError, attributeClass, &error);
+
+        if (level.empty() || level.size() * 10 > previous.size() * 9) {
+            break;
+        }
+        levels.push_back(std::move(level));
+        levelErrors.push_back(error);
+    }
+
+    // triangle order for the post-transform cache, then coarse cluster order for overdraw
+    for (auto &level : levels) {
+        optimizeVertexCache(level, vertexCount);
+    }
+    optimizeOverdraw(levels[0], positions, positionStride, vertexCount);
+
+    size_t totalIndices = 0;
+    for (const auto &level : levels) {
+        totalIndices += level.size();
+    }
+    indices.clear();
+    indices.reserve(totalIndices);
+    for (size_t i = 0; i < levels.size(); i++) {
+        lods.push_back({ static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(levels[i].size()), levelErrors[i] });
+        indices.insert(indices.end(), levels[i].begin(), levels[i].end());
+    }
+}
+
+}
@@ -0,0 +1,92 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+// Load-time mesh optimization passes for indexed triangle lists.
+//
+// All passes work on plain index buffers and raw vertex memory so they can be
+// shared between the runtime importer and offline tools. Remap tables map an
+// old vertex index to its new index, with INVALID_INDEX for unused vertices.
+namespace MeshOptimizer
+{
+    const unsigned int INVALID_INDEX = ~0u;
+
+    // Size of the FIFO post-transform cache used when reporting ACMR
+    const unsigned int DEFAULT_CACHE_SIZE = 16;
+
+    // LOD chain settings shared by the runtime importer and the asset cooker,
+    // so cooked and imported models get the same levels
+    const size_t MAX_LODS = 4;
+    // maximum simplification error for generated LODs, relative to the mesh extent
+    const float LOD_MAX_ERROR = 0.05f;
+
+    // A range of a shared index buffer holding one level of detail
+    struct LodRange {
+        unsigned int indexOffset;
+        unsigned int indexCount;
+        // simplification error relative to the mesh extent
+        float error;
+    };
+
+    // Builds a remap table that folds bitwise identical vertices onto the first
+    // occurrence. Returns the number of unique vertices.
+    size_t generateVertexRemap(std::vector<unsigned int> &remap, const void *vertices, size_t vertexCount, size_t vertexSize);
+
+    // Reorders triangles for post-transform cache locality (Forsyth's algorithm)
+    void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Reorders clusters of cache-friendly triangles so outward facing clusters are
+    // drawn first, reducing overdraw while keeping most of the cache efficiency.
+    // positions points at the first float of vertex 0, stride is in bytes.
+    void optimizeOverdraw(std::vector<unsigned int> &indices, const float *positions, size_t positionStride, size_t vertexCount);
+
+    // Builds a remap table that orders vertices by first use in the index buffer.
+    // Returns the number of referenced vertices.
+    size_t generateVertexFetchRemap(std::vector<unsigned int> &remap, const std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Average cache miss ratio (transformed vertices per triangle) for a FIFO cache
+    float analyzeACMR(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+    // Quadric error edge collapse simplification of a triangle list into destination.
+    // Collapses stop at targetIndexCount or when the error, relative to the mesh
+    // extent, would exceed targetError. Vertices on open borders are locked.
+    // Vertices sharing a position but not attributes (seams) collapse together:
+    // each moves onto the vertex of the target position it shares an edge with,
+    // so seams slide along themselves and stay closed, and a collapse that would
+    // pull a seam apart is rejected. When attributeClass is given (one value per
+    // vertex, e.g. the dominant bone) an edge only collapses between vertices of
+    // the same class. Collapses
+    // move a vertex onto an existing one, so the vertex buffer is shared by all
+    // levels. Returns the resulting index count; resultError receives the error.
+    size_t simplify(std::vector<unsigned int> &destination, const std::vector<unsigned int> &indices,
+                    const float *positions, size_t positionStride, size_t vertexCount,
+                    size_t targetIndexCount, float targetError,
+                    const unsigned int *attributeClass = nullptr, float *resultError = nullptr);
+
+    // Builds up to maxLods levels from indices, each targeting half the triangles
+    // of the previous one, orders every level for the vertex cache (LOD 0 also for
+    // overdraw) and concatenates them back into indices, LOD 0 first. Stops early
+    // once a level would save less than 10% of the triangles.
+    void buildLodChain(std::vector<unsigned int> &indices, std::vector<LodRange> &lods,
+                       const float *positions, size_t positionStride, size_t vertexCount,
+                       size_t maxLods, float maxError, const unsigned int *attributeClass = nullptr);
+
+    void remapIndices(std::vector<unsigned int> &indices, const std::vector<unsigned int> &remap);
+
+    // Compacts a vertex array according to a remap table produced above
+    template <typename T>
+    void remapVertices(std::vector<T> &vertices, const std::vector<unsigned int> &remap, size_t newVertexCount)
+    {
+        std::vector<T> result(newVertexCount);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (remap[i] != INVALID_INDEX) {
+                result[remap[i]] = vertices[i];
+            }
+        }
+        vertices.swap(result);
+    }
+}
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,60 @@
+#include "PackIOSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t PackIOStream::Read(void *buffer, size_t size, size_t count) {
+    if (size == 0 || count == 0) {
+        return 0;
+    }
+    size_t available = (view.size - position) / size;
+    count = std::min(count, available);
+    std::memcpy(buffer, view.data + position, size * count);
+    position += size * count;
+    return count;
+}
+
+aiReturn PackIOStream::Seek(size_t offset, aiOrigin origin) {
+    size_t target;
+    switch (origin) {
+        case aiOrigin_SET:
+            target = offset;
+            break;
+        case aiOrigin_CUR:
+            target = position + offset;
+            break;
+        case aiOrigin_END:
+            target = view.size - offset;
+            break;
+        default:
+            return aiReturn_FAILURE;
+    }
+    if (target > view.size) {
+        return aiReturn_FAILURE;
+    }
+    position = target;
+    return aiReturn_SUCCESS;
+}
+
+bool PackIOSystem::Exists(const char *file) const {
+    return ResourcePack::find(file) || DefaultIOSystem::Exists(file);
+}
+
+Assimp::IOStream *PackIOSystem::Open(const char *file, const char *mode) {
+    // the pack is read-only, writes always go to the file system
+    if (std::strchr(mode, 'w') == nullptr && std::strchr(mode, 'a') == nullptr) {
+        ResourceView view = ResourcePack::find(file);
+        if (view) {
+            return new PackIOStream(view);
+        }
+    }
+    return DefaultIOSystem::Open(file, mode);
+}
+
+void PackIOSystem::Close(Assimp::IOStream *stream) {
+    if (dynamic_cast<PackIOStream *>(stream)) {
+        delete stream;
+        return;
+    }
+    DefaultIOSystem::Close(stream);
+}
@@ -0,0 +1,36 @@
+#ifndef PACKIOSYSTEM_H
+#define PACKIOSYSTEM_H
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
+
+#include "ResourcePack.h"
+
+// Read-only Assimp stream over a resource pack view
+class PackIOStream : public Assimp::IOStream {
+    public:
+        explicit PackIOStream(ResourceView view) : view(view) {}
+
+        size_t Read(void *buffer, size_t size, size_t count) override;
+        size_t Write(const void *buffer, size_t size, size_t count) override { return 0; }
+        aiReturn Seek(size_t offset, aiOrigin origin) override;
+        size_t Tell() const override { return position; }
+        size_t FileSize() const override { return view.size; }
+        void Flush() override {}
+
+    private:
+        ResourceView view;
+        size_t position = 0;
+};
+
+// Lets Assimp importers read models and their side files (.mtl, textures) from
+// the mounted resource pack, falling back to the file system for anything else.
+// Install with Importer::SetIOHandler, which takes ownership.
+class PackIOSystem : public Assimp::DefaultIOSystem {
+    public:
+        bool Exists(const char *file) const override;
+        Assimp::IOStream *Open(const char *file, const char *mode = "rb") override;
+        void Close(Assimp::IOStream *stream) override;
+};
+
+#endif // PACKIOSYSTEM_H
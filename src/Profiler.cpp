@@ -0,0 +1,191 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Profiler::Track
+{
+
+public:
+
+	// fields are atomic only so an export can read a ring while its thread writes it
+	struct Event
+	{
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> start;
+		std::atomic<uint64_t> end;
+	};
+
+	Track(int id, const std::string &name) : id(id), name(name), events(new Event[RING_SIZE]) {}
+
+	int id;
+	// guarded by the registry mutex
+	std::string name;
+	std::unique_ptr<Event[]> events;
+	// zones recorded so far; zone n is in events[n % RING_SIZE]
+	std::atomic<uint64_t> written{0};
+
+};
+
+std::atomic<bool> Profiler::enabled{false};
+
+namespace
+{
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Every track ever created; tracks are never destroyed, a thread's row outlives the thread
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Profiler::Track>> tracks;
+
+thread_local Profiler::Track *threadTrack = nullptr;
+
+// unnamed tracks are called after their id until named
+Profiler::Track *addTrack(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	int id = (int) tracks.size() + 1;
+	tracks.emplace_back(new Profiler::Track(id, name.empty() ? "thread " + std::to_string(id) : name));
+	return tracks.back().get();
+}
+
+Profiler::Track *getThreadTrack()
+{
+	if (!threadTrack)
+	{
+		threadTrack = addTrack("");
+	}
+	return threadTrack;
+}
+
+void writeJsonString(std::ostream &out, const std::string &text)
+{
+	out << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if ((unsigned char) c < 0x20)
+		{
+			out << ' ';
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+}
+
+uint64_t Profiler::now()
+{
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::setThreadName(const std::string &name)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+	Track *track = getThreadTrack();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	track->name = name;
+}
+
+Profiler::Track *Profiler::createTrack(const std::string &name)
+{
+	return addTrack(name);
+}
+
+void Profiler::record(const char *name, uint64_t start, uint64_t end)
+{
+	record(getThreadTrack(), name, start, end);
+}
+
+void Profiler::record(Track *track, const char *name, uint64_t start, uint64_t end)
+{
+	uint64_t index = track->written.load(std::memory_order_relaxed);
+	Track::Event &event = track->events[index % RING_SIZE];
+	event.name.store(name, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.end.store(end, std::memory_order_relaxed);
+	track->written.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const std::string &path)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cerr << "Profiler: cannot write " << path << std::endl;
+		return false;
+	}
+
+	struct Zone
+	{
+		const char *name;
+		uint64_t start;
+		uint64_t end;
+	};
+	std::vector<Zone> zones;
+
+	// microseconds, the unit of the format
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (const std::unique_ptr<Track> &track : tracks)
+	{
+		out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->id << ",\"args\":{\"name\":";
+		writeJsonString(out, track->name);
+		out << "}}";
+		first = false;
+
+		uint64_t written = track->written.load(std::memory_order_acquire);
+		uint64_t begin = written > RING_SIZE ? written - RING_SIZE : 0;
+		zones.clear();
+		for (uint64_t i = begin; i < written; i++)
+		{
+			const Track::Event &event = track->events[i % RING_SIZE];
+			zones.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+				event.end.load(std::memory_order_relaxed)});
+		}
+		// the owner kept recording while we copied; drop what it may have overwritten,
+		// including the zone it may be writing right now
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = track->written.load(std::memory_order_relaxed);
+		size_t stale = 0;
+		if (after + 1 > begin + RING_SIZE)
+		{
+			stale = (size_t) std::min<uint64_t>(after + 1 - RING_SIZE - begin, zones.size());
+		}
+
+		for (size_t i = stale; i < zones.size(); i++)
+		{
+			out << ",\n{\"name\":";
+			writeJsonString(out, zones[i].name);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id << ",\"ts\":" << zones[i].start / 1000.0
+				<< ",\"dur\":" << (zones[i].end - zones[i].start) / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+
+	if (!out)
+	{
+		std::cerr << "Profiler: error writing " << path << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma  once
+
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU timing zones, kept per thread and exported as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev).
+//
+// A Zone records its name and its start and end in nanoseconds into the ring
+// of the thread it closes on; once a ring is full the oldest zones are
+// overwritten, so a trace always holds the most recent stretch of each thread.
+// Zones nest, the viewer stacks them by time.
+//
+// Disabled, a Zone costs one branch when it opens and one when it closes.
+// Names must be string literals or otherwise outlive the profiler.
+class Profiler
+{
+
+public:
+
+	// zones kept per thread before the oldest are overwritten
+	static const size_t RING_SIZE = 1 << 16;
+
+	// A row of the trace: every thread gets one, GpuTimer adds its own
+	class Track;
+
+	class Zone
+	{
+
+	public:
+
+		explicit Zone(const char *name) : name(Profiler::isEnabled() ? name : nullptr)
+		{
+			if (this->name)
+			{
+				start = Profiler::now();
+			}
+		}
+		~Zone()
+		{
+			if (name)
+			{
+				Profiler::record(name, start, Profiler::now());
+			}
+		}
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+
+		const char *name;
+		uint64_t start = 0;
+
+	};
+
+	static void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// nanoseconds since the profiler's clock started
+	static uint64_t now();
+
+	// Names the calling thread's row in the trace; does nothing while disabled, rows cost memory
+	static void setThreadName(const std::string &name);
+	// A row not tied to a thread, for times measured elsewhere; it lives as long as the program
+	static Track *createTrack(const std::string &name);
+
+	// Adds a zone to the calling thread's row
+	static void record(const char *name, uint64_t start, uint64_t end);
+	// Adds a zone to track; one thread at a time may record into a track
+	static void record(Track *track, const char *name, uint64_t start, uint64_t end);
+
+	// Writes the zones every row still holds as Chrome trace JSON; false if the file cannot be written.
+	// Rows being recorded into meanwhile only lose zones the writer overtook
+	static bool writeChromeTrace(const std::string &path);
+
+private:
+
+	static std::atomic<bool> enabled;
+
+};
+
+#endif // PROFILER_H_INCLUDED
@@ -1,15 +1,27 @@
 
 #include "Program.h"
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <fstream>
 
 #include "GLSL.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "ResourcePack.h"
 
 
 std::string readFileAsString(const std::string &fileName)
 {
 	std::string result;
+
+	ResourceView packed = ResourcePack::find(fileName);
+	if (packed)
+	{
+		result.assign(reinterpret_cast<const char *>(packed.data), packed.size);
+		return result;
+	}
+
 	std::ifstream fileHandle(fileName);
 
 	if (fileHandle.is_open())
@@ -36,73 +48,230 @@ void Program::setShaderNames(const std::string &v, const std::string &f)
 
 bool Program::init()
 {
-	GLint rc;
+	return startInit() && finishInit();
+}
 
-	// Create shader handles
-	GLuint VS = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FS = glCreateShader(GL_FRAGMENT_SHADER);
+bool Program::startInit()
+{
+	// Read shader sources; the defines and prelude are part of the source, so each variant gets its own cache key
+	std::string fPrelude = fPreludeName.empty() ? std::string() : readFileAsString(fPreludeName);
+	std::string vShaderString = injectDefines(readFileAsString(vShaderName));
+	std::string fShaderString = injectDefines(readFileAsString(fShaderName), fPrelude);
 
-	// Read shader sources
-	std::string vShaderString = readFileAsString(vShaderName);
-	std::string fShaderString = readFileAsString(fShaderName);
+	pid = glCreateProgram();
+	loadedFromCache = false;
+	if (ProgramCache::isEnabled())
+	{
+		cacheKey = ProgramCache::makeKey(vShaderString, fShaderString);
+		loadedFromCache = ProgramCache::load(pid, cacheKey);
+		if (loadedFromCache)
+		{
+			return true;
+		}
+		glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Compile and link without querying any status; the first status query
+	// is what makes the driver wait, and that happens in finishInit()
+	vsPending = glCreateShader(GL_VERTEX_SHADER);
+	fsPending = glCreateShader(GL_FRAGMENT_SHADER);
 	const char *vshader = vShaderString.c_str();
 	const char *fshader = fShaderString.c_str();
-	CHECKED_GL_CALL(glShaderSource(VS, 1, &vshader, NULL));
-	CHECKED_GL_CALL(glShaderSource(FS, 1, &fshader, NULL));
+	glShaderSource(vsPending, 1, &vshader, NULL);
+	glShaderSource(fsPending, 1, &fshader, NULL);
+	glCompileShader(vsPending);
+	glCompileShader(fsPending);
+	glAttachShader(pid, vsPending);
+	glAttachShader(pid, fsPending);
+	glLinkProgram(pid);
 
-	// Compile vertex shader
-	CHECKED_GL_CALL(glCompileShader(VS));
-	CHECKED_GL_CALL(glGetShaderiv(VS, GL_COMPILE_STATUS, &rc));
-	if (!rc)
+	return true;
+}
+
+bool Program::finishInit()
+{
+	if (loadedFromCache)
 	{
-		if (isVerbose())
+		bindUniformBlocks();
+		reflectUniforms();
+		assignSamplerUnits();
+		return true;
+	}
+
+	GLint rc;
+	glGetProgramiv(pid, GL_LINK_STATUS, &rc);
+	if (!rc && isVerbose())
+	{
+		// report the failing stage the same way a synchronous compile would
+		GLint compiled;
+		glGetShaderiv(vsPending, GL_COMPILE_STATUS, &compiled);
+		if (!compiled)
 		{
-			GLSL::printShaderInfoLog(VS);
+			GLSL::printShaderInfoLog(vsPending);
 			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
 		}
-		return false;
+		glGetShaderiv(fsPending, GL_COMPILE_STATUS, &compiled);
+		if (!compiled)
+		{
+			GLSL::printShaderInfoLog(fsPending);
+			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+		}
+		GLSL::printProgramInfoLog(pid);
+		std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
 	}
 
-	// Compile fragment shader
-	CHECKED_GL_CALL(glCompileShader(FS));
-	CHECKED_GL_CALL(glGetShaderiv(FS, GL_COMPILE_STATUS, &rc));
+	// the linked program keeps its code, the shader objects are no longer needed
+	glDetachShader(pid, vsPending);
+	glDetachShader(pid, fsPending);
+	glDeleteShader(vsPending);
+	glDeleteShader(fsPending);
+	vsPending = 0;
+	fsPending = 0;
+
 	if (!rc)
 	{
-		if (isVerbose())
+		return false;
+	}
+
+	if (ProgramCache::isEnabled())
+	{
+		ProgramCache::store(pid, cacheKey);
+	}
+	bindUniformBlocks();
+	reflectUniforms();
+	assignSamplerUnits();
+	return true;
+}
+
+std::string Program::injectDefines(const std::string &source, const std::string &prelude) const
+{
+	if (defines.empty() && prelude.empty())
+	{
+		return source;
+	}
+
+	std::string block;
+	for (const std::string &define : defines)
+	{
+		block += "#define " + define + "\n";
+	}
+	// errors in the prelude are reported as source string 1, the shader's own as 0
+	if (!prelude.empty())
+	{
+		block += "#line 1 1\n" + prelude + "\n";
+	}
+
+	// #version has to stay first; #line keeps compile errors pointing at the file's own lines
+	size_t lineEnd = source.find('\n');
+	if (source.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+	{
+		return block + "#line 1 0\n" + source;
+	}
+	return source.substr(0, lineEnd + 1) + block + "#line 2 0\n" + source.substr(lineEnd + 1);
+}
+
+// block bindings shared by all programs, e.g. the per-frame camera and lights
+static std::map<std::string, GLuint> &uniformBlockBindings()
+{
+	static std::map<std::string, GLuint> bindings;
+	return bindings;
+}
+
+void Program::setUniformBlockBinding(const std::string &blockName, GLuint binding)
+{
+	uniformBlockBindings()[blockName] = binding;
+}
+
+void Program::bindUniformBlocks()
+{
+	// GL 4.1 has no layout(binding = N) for blocks, and loading a binary resets
+	// the bindings, so they are assigned after every link or load
+	for (const auto &block : uniformBlockBindings())
+	{
+		GLuint index = glGetUniformBlockIndex(pid, block.first.c_str());
+		if (index != GL_INVALID_INDEX)
 		{
-			GLSL::printShaderInfoLog(FS);
-			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			glUniformBlockBinding(pid, index, block.second);
 		}
-		return false;
 	}
+}
 
-	// Create the program and link
-	pid = glCreateProgram();
-	CHECKED_GL_CALL(glAttachShader(pid, VS));
-	CHECKED_GL_CALL(glAttachShader(pid, FS));
-	CHECKED_GL_CALL(glLinkProgram(pid));
-	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
-	if (!rc)
+// sampler units shared by all programs, so drawing only binds textures
+static std::map<std::string, GLint> &samplerUnits()
+{
+	static std::map<std::string, GLint> units;
+	return units;
+}
+
+void Program::setSamplerUnit(const std::string &samplerName, GLint unit)
+{
+	samplerUnits()[samplerName] = unit;
+}
+
+void Program::assignSamplerUnits()
+{
+	// set once per link; glProgramUniform needs no bind
+	for (const auto &sampler : samplerUnits())
 	{
-		if (isVerbose())
+		const UniformInfo *info = findUniform(sampler.first);
+		if (info)
 		{
-			GLSL::printProgramInfoLog(pid);
-			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			glProgramUniform1i(pid, info->location, sampler.second);
 		}
-		return false;
 	}
+}
 
-	return true;
+void Program::reflectUniforms()
+{
+	uniforms.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(pid, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(pid, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::string name(std::max(maxLength, 1), '\0');
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		UniformInfo info;
+		glGetActiveUniform(pid, i, (GLsizei) name.size(), &length, &info.size, &info.type, &name[0]);
+		std::string uniformName(name.data(), length);
+		info.location = glGetUniformLocation(pid, uniformName.c_str());
+		// members of uniform blocks have no location
+		if (info.location < 0)
+		{
+			continue;
+		}
+
+		// arrays are reported as "name[0]"
+		std::string base = uniformName;
+		if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+		{
+			base.erase(base.size() - 3);
+		}
+		uniforms[base] = info;
+		if (info.size > 1 || base != uniformName)
+		{
+			for (GLint element = 0; element < info.size; element++)
+			{
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				UniformInfo elementInfo = info;
+				elementInfo.location = glGetUniformLocation(pid, elementName.c_str());
+				elementInfo.size = info.size - element;
+				uniforms[elementName] = elementInfo;
+			}
+		}
+	}
 }
 
 void Program::bind()
 {
-	CHECKED_GL_CALL(glUseProgram(pid));
+	GLState::useProgram(pid);
 }
 
 void Program::unbind()
 {
-	CHECKED_GL_CALL(glUseProgram(0));
+	// binds are lazy, the next bind() switches programs only if it has to
 }
 
 void Program::addAttribute(const std::string &name)
@@ -112,7 +281,13 @@ void Program::addAttribute(const std::string &name)
 
 void Program::addUniform(const std::string &name)
 {
-	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+	// already known from reflection unless the uniform is inactive
+	if (uniforms.find(name) == uniforms.end())
+	{
+		UniformInfo info;
+		info.location = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+		uniforms[name] = info;
+	}
 }
 
 GLint Program::getAttribute(const std::string &name) const
@@ -131,7 +306,7 @@ GLint Program::getAttribute(const std::string &name) const
 
 GLint Program::getUniform(const std::string &name) const
 {
-	std::map<std::string, GLint>::const_iterator uniform = uniforms.find(name.c_str());
+	std::map<std::string, UniformInfo>::const_iterator uniform = uniforms.find(name);
 	if (uniform == uniforms.end())
 	{
 		if (isVerbose())
@@ -140,5 +315,11 @@ GLint Program::getUniform(const std::string &name) const
 		}
 		return -1;
 	}
-	return uniform->second;
+	return uniform->second.location;
+}
+
+const Program::UniformInfo *Program::findUniform(const std::string &name) const
+{
+	std::map<std::string, UniformInfo>::const_iterator uniform = uniforms.find(name);
+	return uniform == uniforms.end() ? nullptr : &uniform->second;
 }
@@ -4,8 +4,10 @@
 #ifndef LAB471_PROGRAM_H_INCLUDED
 #define LAB471_PROGRAM_H_INCLUDED
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 
@@ -17,11 +19,32 @@ class Program
 
 public:
 
+	// An active uniform found by reflection after linking
+	struct UniformInfo
+	{
+		GLint location = -1;
+		GLenum type = GL_NONE;
+		// element count for arrays, 1 otherwise
+		GLint size = 1;
+	};
+
 	void setVerbose(const bool v) { verbose = v; }
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+	// Each entry becomes "#define <entry>" right after the #version line of both
+	// stages, e.g. "SKINNED" or "INSTANCED"; set before init()
+	void setDefines(const std::vector<std::string> &v) { defines = v; }
+	// Source file inserted after the defines of the fragment stage, for code several
+	// fragment shaders share, e.g. the clustered light lookup; set before init()
+	void setFragmentPrelude(const std::string &f) { fPreludeName = f; }
+	// Compiles and links, or loads a cached binary. Same as startInit() followed by finishInit().
 	virtual bool init();
+	// Issues compile and link without waiting on the driver, so several programs
+	// can be started back to back and compiled in parallel
+	bool startInit();
+	// Waits for the link started by startInit(); false if compiling or linking failed
+	bool finishInit();
 	virtual void bind();
 	virtual void unbind();
 
@@ -29,18 +52,39 @@ public:
 	void addUniform(const std::string &name);
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
+	// Every active uniform is registered after linking: arrays under their base
+	// name, "name[0]" and each "name[i]". Returns nullptr for inactive names.
+	// Meant for resolving handles once at init, not for per-draw lookups.
+	const UniformInfo *findUniform(const std::string &name) const;
 	GLuint getPid() const { return pid; }
 
+	// Every program linked afterwards binds a uniform block with this name to binding
+	static void setUniformBlockBinding(const std::string &blockName, GLuint binding);
+	// Every program linked afterwards samples this sampler uniform from unit
+	static void setSamplerUnit(const std::string &samplerName, GLint unit);
+
 protected:
 
 	std::string vShaderName;
 	std::string fShaderName;
+	std::vector<std::string> defines;
+	std::string fPreludeName;
 
 private:
 
 	GLuint pid = 0;
+	// shaders of a link in flight, released by finishInit()
+	GLuint vsPending = 0;
+	GLuint fsPending = 0;
+	uint64_t cacheKey = 0;
+	bool loadedFromCache = false;
+
+	std::string injectDefines(const std::string &source, const std::string &prelude = std::string()) const;
+	void reflectUniforms();
+	void bindUniformBlocks();
+	void assignSamplerUnits();
 	std::map<std::string, GLint> attributes;
-	std::map<std::string, GLint> uniforms;
+	std::map<std::string, UniformInfo> uniforms;
 	bool verbose = true;
 
 };
@@ -0,0 +1,138 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x4e494250; // "PBIN"
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	std::string cacheDirectory;
+	// -1 until the driver has been asked for its binary formats
+	int binaryFormatCount = -1;
+	std::string driverString;
+
+	uint64_t fnv1a(const std::string &text, uint64_t hash)
+	{
+		for (unsigned char c : text)
+		{
+			hash ^= c;
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	std::string cachePath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+		return cacheDirectory + "/" + name;
+	}
+}
+
+void ProgramCache::setDirectory(const std::string &directory)
+{
+	cacheDirectory = directory;
+}
+
+bool ProgramCache::isEnabled()
+{
+	if (cacheDirectory.empty())
+	{
+		return false;
+	}
+	if (binaryFormatCount < 0)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+		binaryFormatCount = count;
+		if (count == 0)
+		{
+			std::cout << "Driver exposes no program binary formats, shader cache disabled" << std::endl;
+		}
+	}
+	return binaryFormatCount > 0;
+}
+
+uint64_t ProgramCache::makeKey(const std::string &vertexSource, const std::string &fragmentSource)
+{
+	if (driverString.empty())
+	{
+		driverString = std::string((const char *) glGetString(GL_VENDOR)) + '\n' +
+			(const char *) glGetString(GL_RENDERER) + '\n' +
+			(const char *) glGetString(GL_VERSION);
+	}
+	uint64_t hash = fnv1a(driverString, 0xcbf29ce484222325ull);
+	hash = fnv1a(vertexSource, hash);
+	// separator so moving text between the stages changes the key
+	hash = fnv1a(std::string(1, '\0'), hash);
+	return fnv1a(fragmentSource, hash);
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key)
+{
+	if (!isEnabled())
+	{
+		return false;
+	}
+	std::ifstream file(cachePath(key), std::ios::binary);
+	CacheHeader header;
+	if (!file || !file.read((char *) &header, sizeof(header)) || header.magic != CACHE_MAGIC)
+	{
+		return false;
+	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+	{
+		return false;
+	}
+
+	glProgramBinary(program, header.format, binary.data(), header.length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	return linked == GL_TRUE;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	std::string path = cachePath(key);
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		CacheHeader header = { CACHE_MAGIC, format, (uint32_t) length };
+		file.write((const char *) &header, sizeof(header));
+		file.write(binary.data(), binary.size());
+		if (!file)
+		{
+			std::cerr << "Could not write shader cache entry " << temporary << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(temporary, path, error);
+}
@@ -0,0 +1,30 @@
+#pragma  once
+
+#ifndef PROGRAMCACHE_H_INCLUDED
+#define PROGRAMCACHE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+//
+// Binaries are keyed by a hash of the shader sources and the GL vendor, renderer
+// and version strings, so editing a shader or updating the driver simply misses
+// the cache. Drivers that expose no binary formats (GL_NUM_PROGRAM_BINARY_FORMATS
+// is 0, e.g. macOS) disable the cache.
+namespace ProgramCache
+{
+	// Directory holding cached binaries; empty disables the cache
+	void setDirectory(const std::string &directory);
+	bool isEnabled();
+
+	uint64_t makeKey(const std::string &vertexSource, const std::string &fragmentSource);
+
+	// Returns false when there is no binary for key or the driver rejects it
+	bool load(GLuint program, uint64_t key);
+	void store(GLuint program, uint64_t key);
+}
+
+#endif // PROGRAMCACHE_H_INCLUDED
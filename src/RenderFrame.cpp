@@ -0,0 +1,29 @@
+#include "RenderFrame.h"
+
+void RenderFrame::clear()
+{
+	lights.clear();
+	records.clear();
+	packets.clear();
+	bones.clear();
+	batchCount = 0;
+	stats = Stats();
+}
+
+GLuint RenderFrame::addRecord(const glm::mat4 &M, int materialIndex, GLuint flags, GLint layer, const glm::vec4 &uvTransform)
+{
+	records.push_back(DrawRecords::makeRecord(M, materialIndex, flags, layer, uvTransform));
+	return (GLuint) records.size() - 1;
+}
+
+RenderFrame::InstancedBatch &RenderFrame::addBatch()
+{
+	if (batchCount == batches.size())
+	{
+		batches.emplace_back();
+	}
+	InstancedBatch &batch = batches[batchCount++];
+	batch.transforms.clear();
+	batch.params.clear();
+	return batch;
+}
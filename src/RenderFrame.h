@@ -0,0 +1,78 @@
+#pragma  once
+
+#ifndef RENDERFRAME_H_INCLUDED
+#define RENDERFRAME_H_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AssimpModel.h"
+#include "DrawRecords.h"
+#include "LightClusters.h"
+#include "RenderQueue.h"
+
+class Program;
+
+// Everything the GL thread needs to draw one frame, recorded without any GL
+// call: camera, lights, per-draw records, the unsorted render queue packets,
+// bone matrices and instanced batches. Once handed over it is only read.
+//
+// Frames are reused from slot to slot; clear() keeps the storage of the last
+// frame recorded into the same slot.
+struct RenderFrame
+{
+
+	struct InstancedBatch
+	{
+		const AssimpModel *model = nullptr;
+		std::shared_ptr<Program> program;
+		int lod = 0;
+		std::vector<glm::mat4> transforms;
+		std::vector<InstanceParams> params;
+	};
+
+	// what recording the frame did, for the periodic report
+	struct Stats
+	{
+		size_t visible = 0;
+		size_t culled = 0;
+		size_t transformsUpdated = 0;
+		size_t transformCount = 0;
+		size_t pickupTests = 0;
+		size_t pickupItems = 0;
+		uint64_t ticks = 0;
+		uint64_t droppedTicks = 0;
+		double tickRate = 0.0;
+		// seconds spent simulating and recording
+		double recordTime = 0.0;
+	};
+
+	void clear();
+	// Appends a DrawRecords entry, returns the index packets refer to it by
+	GLuint addRecord(const glm::mat4 &M, int materialIndex, GLuint flags = 0,
+		GLint layer = 0, const glm::vec4 &uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+	// An empty batch, reusing one of an earlier frame
+	InstancedBatch &addBatch();
+
+	glm::mat4 projection;
+	glm::mat4 view;
+	float far = 1.0f;
+	int width = 0;
+	int height = 0;
+
+	std::vector<LightClusters::Light> lights;
+	std::vector<DrawRecords::Record> records;
+	std::vector<RenderQueue::Packet> packets;
+	std::vector<glm::mat4> bones;
+	// only the first batchCount are this frame's
+	std::vector<InstancedBatch> batches;
+	size_t batchCount = 0;
+
+	Stats stats;
+
+};
+
+#endif // RENDERFRAME_H_INCLUDED
@@ -0,0 +1,246 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include "GLState.h"
+#include "Program.h"
+
+// opaque:      pass | program | material | geometry | depth
+// transparent: pass | inverted depth | program | material | geometry
+static const int PASS_SHIFT = 62;
+static const int PROGRAM_BITS = 10;
+static const int MATERIAL_BITS = 14;
+static const int GEOMETRY_BITS = 14;
+static const int DEPTH_BITS = 24;
+static const uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+
+static_assert(2 + PROGRAM_BITS + MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS <= 64, "Sort key fields must fit in 64 bits");
+
+static uint64_t hashCombine(uint64_t hash, uint64_t value)
+{
+	// FNV-1a over the bytes of value
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (8 * i)) & 0xff;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// dense id of key, new keys get the next one; ids past the field width share its
+// largest value, which only costs sort quality since execute() compares the real state
+template <typename Key>
+static uint64_t compactId(std::unordered_map<Key, uint32_t> &ids, const Key &key, int bits)
+{
+	auto found = ids.find(key);
+	uint32_t id;
+	if (found != ids.end())
+	{
+		id = found->second;
+	}
+	else
+	{
+		id = (uint32_t) ids.size();
+		ids.emplace(key, id);
+	}
+	return std::min<uint64_t>(id, (1ull << bits) - 1);
+}
+
+void RenderQueue::beginFrame(float far)
+{
+	packets.clear();
+	items.clear();
+	depthScale = far > 0.0f ? DEPTH_MAX / far : 0.0f;
+}
+
+void RenderQueue::submit(const Packet &packet)
+{
+	items.push_back({makeKey(packet), (uint32_t) packets.size()});
+	packets.push_back(packet);
+}
+
+uint64_t RenderQueue::makeKey(const Packet &packet)
+{
+	uint64_t material = hashCombine(14695981039346656037ull, packet.textureTarget);
+	for (int i = 0; i < packet.textureCount; i++)
+	{
+		material = hashCombine(material, ((uint64_t) packet.textures[i].unit << 32) | packet.textures[i].texture);
+	}
+	const IndexedGeometry &geometry = packet.geometry;
+	uint64_t geometryHash = hashCombine(hashCombine(hashCombine(14695981039346656037ull, geometry.vertexArray),
+		geometry.indexOffset), ((uint64_t) geometry.indexType << 32) | (uint32_t) geometry.indexCount);
+
+	uint64_t program = compactId(programIds, (const Program*) packet.program, PROGRAM_BITS);
+	uint64_t materialId = compactId(materialIds, material, MATERIAL_BITS);
+	uint64_t geometryId = compactId(geometryIds, geometryHash, GEOMETRY_BITS);
+	uint64_t depth = (uint64_t) std::min(std::max(packet.depth * depthScale, 0.0f), (float) DEPTH_MAX);
+
+	uint64_t key = (uint64_t) packet.pass << PASS_SHIFT;
+	if (packet.pass == PASS_TRANSPARENT)
+	{
+		// farthest first, so blending sees what is behind
+		key |= (DEPTH_MAX - depth) << (PROGRAM_BITS + MATERIAL_BITS + GEOMETRY_BITS);
+		key |= program << (MATERIAL_BITS + GEOMETRY_BITS);
+		key |= materialId << GEOMETRY_BITS;
+		key |= geometryId;
+	}
+	else
+	{
+		key |= program << (MATERIAL_BITS + GEOMETRY_BITS + DEPTH_BITS);
+		key |= materialId << (GEOMETRY_BITS + DEPTH_BITS);
+		key |= geometryId << DEPTH_BITS;
+		key |= depth;
+	}
+	return key;
+}
+
+void RenderQueue::sort()
+{
+	// LSD radix sort, one byte per pass; stable, so equal keys keep submission order
+	scratch.resize(items.size());
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (const SortItem &item : items)
+		{
+			counts[(item.key >> shift) & 0xff]++;
+		}
+		// a byte that is the same in every key would only copy the items
+		if (counts[(items[0].key >> shift) & 0xff] == items.size())
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (size_t &count : counts)
+		{
+			size_t bucket = count;
+			count = offset;
+			offset += bucket;
+		}
+		for (const SortItem &item : items)
+		{
+			scratch[counts[(item.key >> shift) & 0xff]++] = item;
+		}
+		items.swap(scratch);
+	}
+}
+
+bool RenderQueue::canMerge(const Packet &a, const Packet &b) const
+{
+	if (!a.instancedProgram || a.instancedProgram != b.instancedProgram || a.program != b.program || a.pass != b.pass)
+	{
+		return false;
+	}
+	if (a.geometry.vertexArray != b.geometry.vertexArray || a.geometry.indexOffset != b.geometry.indexOffset
+		|| a.geometry.indexCount != b.geometry.indexCount || a.geometry.indexType != b.geometry.indexType)
+	{
+		return false;
+	}
+	if (a.textureTarget != b.textureTarget || a.textureCount != b.textureCount)
+	{
+		return false;
+	}
+	for (int i = 0; i < a.textureCount; i++)
+	{
+		if (a.textures[i].unit != b.textures[i].unit || a.textures[i].texture != b.textures[i].texture)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void RenderQueue::bindPass(Pass pass)
+{
+	if (pass == PASS_TRANSPARENT)
+	{
+		GLState::enable(GL_BLEND);
+		GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLState::depthMask(GL_FALSE);
+	}
+	else
+	{
+		GLState::disable(GL_BLEND);
+		GLState::depthMask(GL_TRUE);
+	}
+}
+
+void RenderQueue::execute(const DrawRecords &records, InstanceBuffer &instances)
+{
+	stats = Stats();
+	stats.packets = packets.size();
+	if (packets.empty())
+	{
+		return;
+	}
+	sort();
+
+	// find the runs first, so every merged run's records go up in one upload
+	runs.clear();
+	instanceData.clear();
+	for (size_t i = 0; i < items.size();)
+	{
+		const Packet &first = packets[items[i].packet];
+		size_t count = 1;
+		while (i + count < items.size() && canMerge(first, packets[items[i + count].packet]))
+		{
+			count++;
+		}
+
+		Run run = {i, count, -1};
+		if (count > 1)
+		{
+			run.instance = (long) instanceData.size();
+			for (size_t k = i; k < i + count; k++)
+			{
+				instanceData.push_back(records.getRecord(packets[items[k].packet].record));
+			}
+		}
+		runs.push_back(run);
+		i += count;
+	}
+
+	long instanceOffset = instanceData.empty() ? -1 : instances.write(instanceData.data(), instanceData.size());
+
+	Pass pass = PASS_OPAQUE;
+	bindPass(pass);
+	for (const Run &run : runs)
+	{
+		const Packet &packet = packets[items[run.first].packet];
+		if (packet.pass != pass)
+		{
+			pass = packet.pass;
+			bindPass(pass);
+		}
+
+		// GLState drops the binds a run shares with the one before it
+		for (int i = 0; i < packet.textureCount; i++)
+		{
+			GLState::bindTexture(packet.textures[i].unit, packet.textureTarget, packet.textures[i].texture);
+		}
+
+		const IndexedGeometry &geometry = packet.geometry;
+		if (run.instance < 0 || instanceOffset < 0)
+		{
+			packet.program->bind();
+			records.bind(packet.record);
+			GLState::bindVertexArray(geometry.vertexArray);
+			glDrawElements(GL_TRIANGLES, geometry.indexCount, geometry.indexType, (void*) geometry.indexOffset);
+		}
+		else
+		{
+			packet.instancedProgram->bind();
+			instances.bindAttributes(geometry.vertexArray, instanceOffset + run.instance * (long) sizeof(InstanceBuffer::Instance));
+			glDrawElementsInstanced(GL_TRIANGLES, geometry.indexCount, geometry.indexType, (void*) geometry.indexOffset, (GLsizei) run.count);
+			stats.instancedDraws++;
+			stats.instancedPackets += run.count;
+		}
+		stats.drawCalls++;
+	}
+
+	if (pass != PASS_OPAQUE)
+	{
+		bindPass(PASS_OPAQUE);
+	}
+}
@@ -0,0 +1,121 @@
+#pragma  once
+
+#ifndef RENDERQUEUE_H_INCLUDED
+#define RENDERQUEUE_H_INCLUDED
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "AssimpMesh.h"
+#include "DrawRecords.h"
+#include "InstanceBuffer.h"
+
+class Program;
+
+// Collects the frame's draws as packets and issues them in an order chosen by a
+// 64-bit sort key instead of the order they were submitted in.
+//
+// Opaque keys hold, from the most significant bits down: pass, program,
+// material, geometry, then view depth, so state only changes between groups and
+// each group is drawn front to back. Transparent keys put the inverted depth
+// right after the pass, drawing back to front whatever the state costs. Program,
+// material and geometry are compacted to small ids the first time they are seen.
+//
+// Packets next to each other after sorting that share program, textures and
+// geometry, and have an instancedProgram, are merged into one
+// glDrawElementsInstanced. Their DrawRecords entries are copied into an
+// InstanceBuffer, which the instanced programs read instead of the PerDraw block.
+// GL 4.1 has no gl_DrawID or multi-draw indirect, so instancing is the only merge.
+//
+// Usage per frame: beginFrame(), submit() every packet, then execute() once the
+// DrawRecords of the frame are uploaded.
+class RenderQueue
+{
+
+public:
+
+	enum Pass
+	{
+		PASS_OPAQUE,
+		PASS_TRANSPARENT
+	};
+
+	struct Packet
+	{
+		Program *program = nullptr;
+		// same shading reading the record from the instance attributes; nullptr never merges
+		Program *instancedProgram = nullptr;
+		IndexedGeometry geometry;
+		// bound before drawing, all of textureTarget; must stay valid until execute()
+		const TextureBinding *textures = nullptr;
+		int textureCount = 0;
+		GLenum textureTarget = GL_TEXTURE_2D;
+		// DrawRecords index with the model matrix and material
+		GLuint record = 0;
+		// view-space distance from the camera
+		float depth = 0.0f;
+		Pass pass = PASS_OPAQUE;
+	};
+
+	struct Stats
+	{
+		size_t packets = 0;
+		size_t drawCalls = 0;
+		size_t instancedDraws = 0;
+		// packets drawn as part of an instanced draw
+		size_t instancedPackets = 0;
+	};
+
+	RenderQueue() = default;
+	RenderQueue(const RenderQueue&) = delete;
+	RenderQueue& operator=(const RenderQueue&) = delete;
+
+	// Clears the packets; depths are quantized over [0, far]
+	void beginFrame(float far);
+	void submit(const Packet &packet);
+	// Sorts and draws every packet, leaving opaque pass state behind
+	void execute(const DrawRecords &records, InstanceBuffer &instances);
+
+	const Stats &getStats() const { return stats; }
+
+private:
+
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	struct Run
+	{
+		size_t first;
+		size_t count;
+		// index of the first record in instanceData, or -1 for single draws
+		long instance;
+	};
+
+	uint64_t makeKey(const Packet &packet);
+	void sort();
+	bool canMerge(const Packet &a, const Packet &b) const;
+	void bindPass(Pass pass);
+
+	std::vector<Packet> packets;
+	std::vector<SortItem> items;
+	// radix sort scratch, kept so steady frames do not allocate
+	std::vector<SortItem> scratch;
+	std::vector<Run> runs;
+	std::vector<InstanceBuffer::Instance> instanceData;
+
+	std::unordered_map<const Program*, uint32_t> programIds;
+	std::unordered_map<uint64_t, uint32_t> materialIds;
+	std::unordered_map<uint64_t, uint32_t> geometryIds;
+
+	float depthScale = 1.0f;
+	Stats stats;
+
+};
+
+#endif // RENDERQUEUE_H_INCLUDED
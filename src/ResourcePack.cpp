@@ -0,0 +1,513 @@
+#include "ResourcePack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // average entries per hash bucket of the perfect hash
+    const uint32_t ENTRIES_PER_BUCKET = 4;
+    const uint32_t MAX_DISPLACEMENT = 1 << 20;
+
+    // LZ block format (LZ4 style): a token with the literal run length in the high
+    // nibble and the match length minus MIN_MATCH in the low nibble, either extended
+    // by 255-runs, the literals, then a 16 bit match offset. The last sequence has
+    // literals only.
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    const int LZ_HASH_BITS = 14;
+
+    std::unique_ptr<ResourcePack> mountedPack;
+    std::string mountedBase;
+
+    uint64_t mixHash(uint64_t hash, uint32_t displacement) {
+        // splitmix64 finalizer
+        hash ^= displacement * 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        return hash ^ (hash >> 31);
+    }
+
+    std::string normalizePath(const std::string &path) {
+        std::string result = path;
+        std::replace(result.begin(), result.end(), '\\', '/');
+        result = std::filesystem::path(result).lexically_normal().generic_string();
+        while (result.size() > 1 && result.back() == '/') {
+            result.pop_back();
+        }
+        return result;
+    }
+
+    void writeLength(std::vector<unsigned char> &out, size_t length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<unsigned char>(length));
+    }
+
+    void writeSequence(std::vector<unsigned char> &out, const unsigned char *literals, size_t literalLength, size_t matchLength, size_t offset) {
+        size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+        out.push_back(static_cast<unsigned char>((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literalLength >= 15) {
+            writeLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), literals, literals + literalLength);
+        if (matchLength) {
+            out.push_back(offset & 0xff);
+            out.push_back(offset >> 8);
+            if (matchCode >= 15) {
+                writeLength(out, matchCode - 15);
+            }
+        }
+    }
+
+    void compressLZ(const unsigned char *input, size_t size, std::vector<unsigned char> &out) {
+        std::vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, UINT32_MAX);
+        size_t anchor = 0, position = 0;
+        while (position + MIN_MATCH <= size) {
+            uint32_t sequence;
+            std::memcpy(&sequence, input + position, sizeof(sequence));
+            uint32_t slot = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+            uint32_t candidate = table[slot];
+            table[slot] = static_cast<uint32_t>(position);
+
+            if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET || std::memcmp(input + candidate, input + position, MIN_MATCH) != 0) {
+                position++;
+                continue;
+            }
+            size_t length = MIN_MATCH;
+            while (position + length < size && input[candidate + length] == input[position + length]) {
+                length++;
+            }
+            writeSequence(out, input + anchor, position - anchor, length, position - candidate);
+            position += length;
+            anchor = position;
+        }
+        writeSequence(out, input + anchor, size - anchor, 0, 0);
+    }
+
+    bool readLength(const unsigned char *&in, const unsigned char *end, size_t &length) {
+        unsigned char value;
+        do {
+            if (in >= end) {
+                return false;
+            }
+            value = *in++;
+            length += value;
+        } while (value == 255);
+        return true;
+    }
+
+    bool decompressLZ(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize) {
+        const unsigned char *end = in + inSize;
+        size_t written = 0;
+        while (in < end) {
+            unsigned char token = *in++;
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(in, end, literalLength)) {
+                return false;
+            }
+            if (literalLength > size_t(end - in) || literalLength > outSize - written) {
+                return false;
+            }
+            std::memcpy(out + written, in, literalLength);
+            in += literalLength;
+            written += literalLength;
+            if (in == end) {
+                break;
+            }
+
+            if (end - in < 2) {
+                return false;
+            }
+            size_t offset = in[0] | (in[1] << 8);
+            in += 2;
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(in, end, matchLength)) {
+                return false;
+            }
+            matchLength += MIN_MATCH;
+            if (offset == 0 || offset > written || matchLength > outSize - written) {
+                return false;
+            }
+            // byte by byte, matches may overlap their own output
+            for (size_t i = 0; i < matchLength; i++, written++) {
+                out[written] = out[written - offset];
+            }
+        }
+        return written == outSize;
+    }
+}
+
+ResourcePack::~ResourcePack() {
+    close();
+}
+
+bool ResourcePack::open(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (fileMapping) {
+            CloseHandle(fileMapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = fileMapping;
+    mapping = static_cast<const unsigned char *>(view);
+    mappingSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        ::close(file);
+        return false;
+    }
+    void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    mapping = static_cast<const unsigned char *>(view);
+    mappingSize = static_cast<size_t>(info.st_size);
+#endif
+
+    header = reinterpret_cast<const PackHeader *>(mapping);
+    uint64_t tocSize = 0;
+    if (mappingSize >= sizeof(PackHeader) && header->magic == PACK_MAGIC && header->version == PACK_VERSION && header->bucketCount > 0 &&
+        header->namesSize <= mappingSize) {
+        // every term fits in 64 bits, and so does their sum
+        tocSize = sizeof(PackHeader) + uint64_t(header->bucketCount) * sizeof(int32_t) + uint64_t(header->entryCount) * sizeof(PackEntry) + header->namesSize;
+    }
+    if (tocSize == 0 || tocSize > mappingSize) {
+        std::cerr << "Invalid resource pack: " << path << std::endl;
+        close();
+        return false;
+    }
+    displacements = reinterpret_cast<const int32_t *>(mapping + sizeof(PackHeader));
+    entries = reinterpret_cast<const PackEntry *>(displacements + header->bucketCount);
+    names = reinterpret_cast<const char *>(entries + header->entryCount);
+    if (!validate()) {
+        std::cerr << "Corrupt resource pack table of contents: " << path << std::endl;
+        close();
+        return false;
+    }
+    // only the table of contents is read ahead, blobs when they are looked up
+    prefetch(0, tocSize);
+    decompressed.resize(header->entryCount);
+    return true;
+}
+
+bool ResourcePack::validate() const {
+    // get() trusts the table of contents, so every slot and range it may use is checked once here
+    for (uint32_t bucket = 0; bucket < header->bucketCount; bucket++) {
+        int64_t displacement = displacements[bucket];
+        if (displacement < 0 && uint64_t(-displacement - 1) >= header->entryCount) {
+            return false;
+        }
+    }
+    for (uint32_t slot = 0; slot < header->entryCount; slot++) {
+        const PackEntry &entry = entries[slot];
+        if (uint64_t(entry.nameOffset) + entry.nameLength > header->namesSize) {
+            return false;
+        }
+        if (entry.offset > mappingSize || entry.storedSize > mappingSize - entry.offset) {
+            return false;
+        }
+        if (entry.compression == COMPRESSION_NONE ? entry.size > entry.storedSize : entry.compression != COMPRESSION_LZ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ResourcePack::prefetch(uint64_t offset, uint64_t size) const {
+#ifndef _WIN32
+    // madvise wants a page aligned start
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t start = offset / pageSize * pageSize;
+    madvise(const_cast<unsigned char *>(mapping) + start, offset + size - start, MADV_WILLNEED);
+#endif
+}
+
+void ResourcePack::close() {
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        fileHandle = mappingHandle = nullptr;
+#else
+        munmap(const_cast<unsigned char *>(mapping), mappingSize);
+#endif
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    displacements = nullptr;
+    entries = nullptr;
+    names = nullptr;
+    decompressed.clear();
+}
+
+uint64_t ResourcePack::hashName(const std::string &name) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+ResourceView ResourcePack::get(const std::string &name) const {
+    ResourceView view;
+    if (!header || header->entryCount == 0) {
+        return view;
+    }
+
+    uint64_t hash = hashName(name);
+    int32_t displacement = displacements[hash % header->bucketCount];
+    // negative displacements place single entry buckets directly
+    uint32_t slot = displacement < 0 ? static_cast<uint32_t>(-displacement - 1)
+                                     : static_cast<uint32_t>(mixHash(hash, displacement) % header->entryCount);
+    const PackEntry &entry = entries[slot];
+    if (entry.pathHash != hash || entry.nameLength != name.size() || std::memcmp(names + entry.nameOffset, name.data(), name.size()) != 0) {
+        return view;
+    }
+
+    if (entry.compression == COMPRESSION_NONE) {
+        // the caller is about to read all of it
+        prefetch(entry.offset, entry.storedSize);
+        view.data = mapping + entry.offset;
+        view.size = entry.size;
+        return view;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!decompressed[slot]) {
+        std::unique_ptr<unsigned char[]> buffer(new unsigned char[std::max<uint64_t>(entry.size, 1)]);
+        if (!decompressLZ(mapping + entry.offset, entry.storedSize, buffer.get(), entry.size)) {
+            std::cerr << "Corrupt resource pack entry: " << name << std::endl;
+            return view;
+        }
+        decompressed[slot] = std::move(buffer);
+    }
+    view.data = decompressed[slot].get();
+    view.size = entry.size;
+    return view;
+}
+
+bool ResourcePack::write(const std::string &path, const std::vector<Input> &inputs) {
+    uint32_t entryCount = static_cast<uint32_t>(inputs.size());
+    uint32_t bucketCount = std::max<uint32_t>(1, (entryCount + ENTRIES_PER_BUCKET - 1) / ENTRIES_PER_BUCKET);
+
+    std::vector<std::string> sortedNames;
+    for (const Input &input : inputs) {
+        sortedNames.push_back(input.name);
+    }
+    std::sort(sortedNames.begin(), sortedNames.end());
+    auto duplicate = std::adjacent_find(sortedNames.begin(), sortedNames.end());
+    if (duplicate != sortedNames.end()) {
+        std::cerr << "Duplicate resource pack entry " << *duplicate << " in " << path << std::endl;
+        return false;
+    }
+
+    std::vector<uint64_t> hashes(entryCount);
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        hashes[i] = hashName(inputs[i].name);
+        buckets[hashes[i] % bucketCount].push_back(i);
+    }
+
+    // place the largest buckets first while most slots are still free
+    std::vector<uint32_t> bucketOrder(bucketCount);
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        bucketOrder[i] = i;
+    }
+    std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    std::vector<int32_t> displacements(bucketCount, 0);
+    std::vector<uint32_t> slotInput(entryCount, UINT32_MAX);
+    uint32_t nextFree = 0;
+    for (uint32_t bucket : bucketOrder) {
+        const std::vector<uint32_t> &members = buckets[bucket];
+        if (members.empty()) {
+            continue;
+        }
+        if (members.size() == 1) {
+            while (slotInput[nextFree] != UINT32_MAX) {
+                nextFree++;
+            }
+            slotInput[nextFree] = members[0];
+            displacements[bucket] = -static_cast<int32_t>(nextFree) - 1;
+            continue;
+        }
+
+        bool placed = false;
+        std::vector<uint32_t> slots(members.size());
+        for (uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !placed; displacement++) {
+            placed = true;
+            for (size_t m = 0; m < members.size() && placed; m++) {
+                slots[m] = static_cast<uint32_t>(mixHash(hashes[members[m]], displacement) % entryCount);
+                placed = slotInput[slots[m]] == UINT32_MAX && std::find(slots.begin(), slots.begin() + m, slots[m]) == slots.begin() + m;
+            }
+            if (placed) {
+                for (size_t m = 0; m < members.size(); m++) {
+                    slotInput[slots[m]] = members[m];
+                }
+                displacements[bucket] = static_cast<int32_t>(displacement);
+            }
+        }
+        if (!placed) {
+            std::cerr << "Could not build a perfect hash for " << path << std::endl;
+            return false;
+        }
+    }
+
+    // names first so the table of contents size is known before any blob
+    std::string nameTable;
+    std::vector<PackEntry> entries(entryCount);
+    for (uint32_t slot = 0; slot < entryCount; slot++) {
+        const Input &input = inputs[slotInput[slot]];
+        entries[slot].pathHash = hashes[slotInput[slot]];
+        entries[slot].nameOffset = static_cast<uint32_t>(nameTable.size());
+        entries[slot].nameLength = static_cast<uint32_t>(input.name.size());
+        nameTable += input.name;
+    }
+
+    PackHeader header = { PACK_MAGIC, PACK_VERSION, entryCount, bucketCount, nameTable.size() };
+    uint64_t offset = sizeof(PackHeader) + bucketCount * sizeof(int32_t) + entryCount * sizeof(PackEntry) + nameTable.size();
+
+    // blobs are laid out in input order, so callers control what is read together
+    std::vector<uint32_t> inputSlot(entryCount);
+    for (uint32_t slot = 0; slot < entryCount; slot++) {
+        inputSlot[slotInput[slot]] = slot;
+    }
+    std::vector<std::vector<unsigned char>> blobs(entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        std::ifstream file(inputs[i].sourcePath, std::ios::binary);
+        if (!file) {
+            std::cerr << "Could not read " << inputs[i].sourcePath << " for " << path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        PackEntry &entry = entries[inputSlot[i]];
+        entry.size = contents.size();
+        entry.compression = COMPRESSION_NONE;
+        if (inputs[i].compress && !contents.empty()) {
+            std::vector<unsigned char> compressed;
+            compressLZ(contents.data(), contents.size(), compressed);
+            // not worth a decompression at load for less than an eighth saved
+            if (compressed.size() < contents.size() - contents.size() / 8) {
+                contents.swap(compressed);
+                entry.compression = COMPRESSION_LZ;
+            }
+        }
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        entry.offset = offset;
+        entry.storedSize = contents.size();
+        offset += contents.size();
+        blobs[i].swap(contents);
+    }
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(displacements.data()), displacements.size() * sizeof(int32_t));
+        out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PackEntry));
+        out.write(nameTable.data(), nameTable.size());
+        static const char padding[PACK_ALIGNMENT] = {};
+        for (uint32_t i = 0; i < entryCount; i++) {
+            const PackEntry &entry = entries[inputSlot[i]];
+            out.write(padding, entry.offset - static_cast<uint64_t>(out.tellp()));
+            out.write(reinterpret_cast<const char *>(blobs[i].data()), blobs[i].size());
+        }
+        if (!out) {
+            std::cerr << "Could not write " << temporary << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+bool ResourcePack::mount(const std::string &packPath, const std::string &baseDirectory) {
+    std::unique_ptr<ResourcePack> pack(new ResourcePack());
+    if (!pack->open(packPath)) {
+        return false;
+    }
+    std::cout << "Mounted resource pack " << packPath << " (" << pack->getEntryCount() << " entries) at " << baseDirectory << std::endl;
+    mountedPack = std::move(pack);
+    mountedBase = normalizePath(baseDirectory);
+    return true;
+}
+
+void ResourcePack::unmount() {
+    mountedPack.reset();
+    mountedBase.clear();
+}
+
+bool ResourcePack::isMounted() {
+    return mountedPack != nullptr;
+}
+
+ResourceView ResourcePack::find(const std::string &path) {
+    std::string name;
+    if (!getPackName(path, name)) {
+        return ResourceView();
+    }
+    return mountedPack->get(name);
+}
+
+bool ResourcePack::getPackName(const std::string &path, std::string &name) {
+    if (!mountedPack) {
+        return false;
+    }
+    name = normalizePath(path);
+    if (!mountedBase.empty() && mountedBase != ".") {
+        if (name.compare(0, mountedBase.size(), mountedBase) != 0 || name.size() <= mountedBase.size() || name[mountedBase.size()] != '/') {
+            return false;
+        }
+        name.erase(0, mountedBase.size() + 1);
+    }
+    return true;
+}
+
+ResourceView ResourcePack::findName(const std::string &name) {
+    if (!mountedPack) {
+        return ResourceView();
+    }
+    return mountedPack->get(name);
+}
@@ -0,0 +1,115 @@
+#ifndef RESOURCEPACK_H
+#define RESOURCEPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only view of a file stored in a resource pack. Views point straight into
+// the mapped pack (or into its decompression cache) and stay valid until the
+// pack is closed.
+struct ResourceView {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    explicit operator bool() const { return data != nullptr; }
+};
+
+// A single file holding many resources, memory mapped on open.
+//
+// Layout: a PackHeader, then the table of contents (one displacement per hash
+// bucket, one PackEntry per slot, the entry names), then every blob aligned to
+// PACK_ALIGNMENT. Lookups use a minimal perfect hash built with hash-and-displace:
+// the path hash picks a bucket, the bucket's displacement picks the slot, and the
+// slot's stored hash and name confirm the match. Entries can be stored LZ
+// compressed, in which case the first lookup decompresses them into a cache.
+class ResourcePack {
+    public:
+        static const uint32_t PACK_MAGIC = 0x4b415052; // "RPAK"
+        static const uint32_t PACK_VERSION = 1;
+        static const size_t PACK_ALIGNMENT = 64;
+
+        enum Compression : uint32_t {
+            COMPRESSION_NONE = 0,
+            COMPRESSION_LZ = 1
+        };
+
+        struct PackHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t entryCount;
+            uint32_t bucketCount;
+            uint64_t namesSize;
+        };
+
+        struct PackEntry {
+            uint64_t pathHash;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t storedSize;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            uint32_t compression;
+            uint32_t reserved;
+        };
+
+        // A file to put in a pack; compressed entries that do not shrink are stored raw
+        struct Input {
+            std::string name;
+            std::string sourcePath;
+            bool compress;
+        };
+
+        ResourcePack() = default;
+        ~ResourcePack();
+        ResourcePack(const ResourcePack&) = delete;
+        ResourcePack& operator=(const ResourcePack&) = delete;
+
+        bool open(const std::string &path);
+        void close();
+
+        // name is relative to the pack root, using '/' separators
+        ResourceView get(const std::string &name) const;
+        size_t getEntryCount() const { return header ? header->entryCount : 0; }
+
+        static bool write(const std::string &path, const std::vector<Input> &inputs);
+
+        // The mounted pack serves every path below baseDirectory
+        static bool mount(const std::string &packPath, const std::string &baseDirectory);
+        static void unmount();
+        static bool isMounted();
+        // Looks a loader path up in the mounted pack; empty view when not packed
+        static ResourceView find(const std::string &path);
+        // The name a loader path has in the mounted pack, false when it is outside the base directory
+        static bool getPackName(const std::string &path, std::string &name);
+        // Looks a name relative to the pack root up in the mounted pack
+        static ResourceView findName(const std::string &name);
+
+        static uint64_t hashName(const std::string &name);
+
+    private:
+        // checks every entry of the table of contents against the mapping
+        bool validate() const;
+        // asks the OS to start reading a range of the mapping
+        void prefetch(uint64_t offset, uint64_t size) const;
+
+        const unsigned char *mapping = nullptr;
+        size_t mappingSize = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#endif
+
+        const PackHeader *header = nullptr;
+        const int32_t *displacements = nullptr;
+        const PackEntry *entries = nullptr;
+        const char *names = nullptr;
+
+        mutable std::mutex cacheMutex;
+        mutable std::vector<std::unique_ptr<unsigned char[]>> decompressed;
+};
+
+#endif // RESOURCEPACK_H
@@ -0,0 +1,105 @@
+#include "ShaderVariants.h"
+
+#include <iostream>
+
+void ShaderVariants::setShaderNames(const std::string &v, const std::string &f)
+{
+	vShaderName = v;
+	fShaderName = f;
+}
+
+void ShaderVariants::addFeature(uint32_t feature, const std::string &define)
+{
+	features[feature] = define;
+}
+
+void ShaderVariants::addAttribute(const std::string &name)
+{
+	attributes.push_back(name);
+}
+
+std::shared_ptr<Program> ShaderVariants::create(uint32_t mask) const
+{
+	std::vector<std::string> defines;
+	for (const auto &feature : features)
+	{
+		if (mask & feature.first)
+		{
+			defines.push_back(feature.second);
+		}
+	}
+
+	std::shared_ptr<Program> program = std::make_shared<Program>();
+	program->setVerbose(verbose);
+	program->setShaderNames(vShaderName, fShaderName);
+	program->setFragmentPrelude(fPreludeName);
+	program->setDefines(defines);
+	return program;
+}
+
+bool ShaderVariants::finish(uint32_t mask, const std::shared_ptr<Program> &program)
+{
+	if (!program->finishInit())
+	{
+		std::cerr << "Shader variant 0x" << std::hex << mask << std::dec << " of " << fShaderName << " failed to build" << std::endl;
+		variants[mask] = nullptr;
+		return false;
+	}
+
+	for (const std::string &attribute : attributes)
+	{
+		program->addAttribute(attribute);
+	}
+	if (onLink)
+	{
+		onLink(*program);
+	}
+	variants[mask] = program;
+	return true;
+}
+
+void ShaderVariants::prepare(const std::vector<uint32_t> &masks)
+{
+	// start every compile before waiting on any, like the programs built in init
+	std::vector<std::pair<uint32_t, std::shared_ptr<Program>>> pending;
+	for (uint32_t mask : masks)
+	{
+		if (variants.count(mask))
+		{
+			continue;
+		}
+		std::shared_ptr<Program> program = create(mask);
+		program->startInit();
+		pending.emplace_back(mask, program);
+		// a mask listed twice is only compiled once
+		variants[mask] = nullptr;
+	}
+	for (const auto &variant : pending)
+	{
+		finish(variant.first, variant.second);
+	}
+}
+
+std::shared_ptr<Program> ShaderVariants::find(uint32_t mask) const
+{
+	auto variant = variants.find(mask);
+	return variant != variants.end() ? variant->second : nullptr;
+}
+
+std::shared_ptr<Program> ShaderVariants::get(uint32_t mask)
+{
+	auto variant = variants.find(mask);
+	if (variant != variants.end())
+	{
+		return variant->second;
+	}
+
+	// a mesh prepare() did not expect, compiled synchronously
+	if (verbose)
+	{
+		std::cout << "Compiling shader variant 0x" << std::hex << mask << std::dec << " of " << fShaderName << std::endl;
+	}
+	std::shared_ptr<Program> program = create(mask);
+	program->startInit();
+	return finish(mask, program) ? program : nullptr;
+}
@@ -0,0 +1,63 @@
+#pragma  once
+
+#ifndef SHADERVARIANTS_H_INCLUDED
+#define SHADERVARIANTS_H_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Program.h"
+
+// Compile-time permutations of one vertex/fragment shader pair.
+//
+// A variant is keyed by a feature mask, every feature bit maps to a #define (see
+// addFeature). Variants are compiled the first time they are asked for and kept
+// for the program's lifetime; prepare() compiles the expected ones up front so no
+// frame stalls on the driver.
+class ShaderVariants
+{
+
+public:
+
+	void setVerbose(const bool v) { verbose = v; }
+	void setShaderNames(const std::string &v, const std::string &f);
+	// See Program::setFragmentPrelude
+	void setFragmentPrelude(const std::string &f) { fPreludeName = f; }
+	// Sets define in every variant whose mask has feature
+	void addFeature(uint32_t feature, const std::string &define);
+	// Looked up in every variant after it links
+	void addAttribute(const std::string &name);
+	// Runs once per variant after it links, e.g. to set per-program constants
+	void setLinkCallback(const std::function<void(Program&)> &callback) { onLink = callback; }
+
+	// Compiles all missing masks in parallel
+	void prepare(const std::vector<uint32_t> &masks);
+	// The variant for a feature mask, compiled on first use; nullptr if it failed to build
+	std::shared_ptr<Program> get(uint32_t mask);
+	// The variant if it is already built, never compiles; safe without a GL context
+	std::shared_ptr<Program> find(uint32_t mask) const;
+
+	size_t getVariantCount() const { return variants.size(); }
+
+private:
+
+	std::shared_ptr<Program> create(uint32_t mask) const;
+	bool finish(uint32_t mask, const std::shared_ptr<Program> &program);
+
+	std::string vShaderName;
+	std::string fShaderName;
+	std::string fPreludeName;
+	std::map<uint32_t, std::string> features;
+	std::vector<std::string> attributes;
+	std::function<void(Program&)> onLink;
+	// failed variants stay in the map as nullptr so they are not rebuilt every draw
+	std::map<uint32_t, std::shared_ptr<Program>> variants;
+	bool verbose = true;
+
+};
+
+#endif // SHADERVARIANTS_H_INCLUDED
@@ -0,0 +1,430 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+// items per leaf of the static hierarchy
+static const uint32_t LEAF_SIZE = 4;
+// deeper than any hierarchy built from 32-bit slots with median splits
+static const int MAX_DEPTH = 64;
+
+static bool overlaps(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB, const glm::vec3 &maxB)
+{
+	return minA.x <= maxB.x && maxA.x >= minB.x &&
+		minA.y <= maxB.y && maxA.y >= minB.y &&
+		minA.z <= maxB.z && maxA.z >= minB.z;
+}
+
+// squared distance from point to the closest point of the box, 0 inside it
+static float distanceSquared(const glm::vec3 &point, const glm::vec3 &min, const glm::vec3 &max)
+{
+	glm::vec3 offset = glm::clamp(point, min, max) - point;
+	return glm::dot(offset, offset);
+}
+
+SpatialIndex::SpatialIndex(float cellSize) : cellSize(cellSize)
+{
+	clear();
+}
+
+SpatialIndex::CellKey SpatialIndex::cellKey(int x, int y, int z) const
+{
+	// 21 bits per axis, cells a million apart share keys but are still tested exactly
+	return ((CellKey) (x & 0x1fffff) << 42) | ((CellKey) (y & 0x1fffff) << 21) | (CellKey) (z & 0x1fffff);
+}
+
+glm::ivec3 SpatialIndex::cellOf(const glm::vec3 &point) const
+{
+	return glm::ivec3((int) std::floor(point.x / cellSize), (int) std::floor(point.y / cellSize), (int) std::floor(point.z / cellSize));
+}
+
+void SpatialIndex::addToCells(uint32_t slot)
+{
+	glm::ivec3 first = cellOf(items[slot].min), last = cellOf(items[slot].max);
+	for (int x = first.x; x <= last.x; x++)
+	{
+		for (int y = first.y; y <= last.y; y++)
+		{
+			for (int z = first.z; z <= last.z; z++)
+			{
+				cells[cellKey(x, y, z)].push_back(slot);
+			}
+		}
+	}
+}
+
+void SpatialIndex::removeFromCells(uint32_t slot)
+{
+	glm::ivec3 first = cellOf(items[slot].min), last = cellOf(items[slot].max);
+	for (int x = first.x; x <= last.x; x++)
+	{
+		for (int y = first.y; y <= last.y; y++)
+		{
+			for (int z = first.z; z <= last.z; z++)
+			{
+				auto cell = cells.find(cellKey(x, y, z));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+				std::vector<uint32_t> &cellSlots = cell->second;
+				auto found = std::find(cellSlots.begin(), cellSlots.end(), slot);
+				if (found != cellSlots.end())
+				{
+					*found = cellSlots.back();
+					cellSlots.pop_back();
+				}
+				if (cellSlots.empty())
+				{
+					cells.erase(cell);
+				}
+			}
+		}
+	}
+}
+
+void SpatialIndex::insert(int id, const glm::vec3 &min, const glm::vec3 &max, bool isStatic)
+{
+	if (slots.count(id))
+	{
+		std::cerr << "SpatialIndex: item " << id << " is already indexed" << std::endl;
+		return;
+	}
+
+	uint32_t slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t) items.size();
+		items.emplace_back();
+		stamps.push_back(0);
+	}
+	items[slot] = {id, min, max, isStatic, true, true};
+	slots[id] = slot;
+	extentMin = glm::min(extentMin, min);
+	extentMax = glm::max(extentMax, max);
+
+	// static items are found once buildStatic() has put them in the hierarchy
+	if (!isStatic)
+	{
+		addToCells(slot);
+		dynamicCount++;
+	}
+}
+
+void SpatialIndex::update(int id, const glm::vec3 &min, const glm::vec3 &max)
+{
+	auto found = slots.find(id);
+	if (found == slots.end())
+	{
+		return;
+	}
+	Item &item = items[found->second];
+	if (item.isStatic)
+	{
+		std::cerr << "SpatialIndex: static item " << id << " cannot move" << std::endl;
+		return;
+	}
+
+	// cheap when the item stays in the cells it covered
+	if (cellOf(min) == cellOf(item.min) && cellOf(max) == cellOf(item.max))
+	{
+		item.min = min;
+		item.max = max;
+		return;
+	}
+	removeFromCells(found->second);
+	item.min = min;
+	item.max = max;
+	addToCells(found->second);
+	extentMin = glm::min(extentMin, min);
+	extentMax = glm::max(extentMax, max);
+}
+
+void SpatialIndex::remove(int id)
+{
+	auto found = slots.find(id);
+	if (found == slots.end())
+	{
+		return;
+	}
+	uint32_t slot = found->second;
+	slots.erase(found);
+	items[slot].alive = false;
+	if (items[slot].isStatic)
+	{
+		// the hierarchy still points at the slot, it is reused after the next buildStatic()
+		return;
+	}
+	removeFromCells(slot);
+	dynamicCount--;
+	freeSlots.push_back(slot);
+}
+
+void SpatialIndex::setEnabled(int id, bool enabled)
+{
+	auto found = slots.find(id);
+	if (found != slots.end())
+	{
+		items[found->second].enabled = enabled;
+	}
+}
+
+void SpatialIndex::setAllEnabled(bool enabled)
+{
+	for (Item &item : items)
+	{
+		item.enabled = enabled;
+	}
+}
+
+void SpatialIndex::clear()
+{
+	items.clear();
+	freeSlots.clear();
+	slots.clear();
+	cells.clear();
+	nodes.clear();
+	staticSlots.clear();
+	stamps.clear();
+	dynamicCount = 0;
+	extentMin = glm::vec3(std::numeric_limits<float>::max());
+	extentMax = glm::vec3(std::numeric_limits<float>::lowest());
+}
+
+void SpatialIndex::buildStatic()
+{
+	staticSlots.clear();
+	for (uint32_t slot = 0; slot < items.size(); slot++)
+	{
+		const Item &item = items[slot];
+		if (item.isStatic && item.alive)
+		{
+			staticSlots.push_back(slot);
+		}
+		else if (item.isStatic && std::find(freeSlots.begin(), freeSlots.end(), slot) == freeSlots.end())
+		{
+			// removed since the last build, nothing points at it any more
+			items[slot].isStatic = false;
+			freeSlots.push_back(slot);
+		}
+	}
+
+	nodes.clear();
+	if (!staticSlots.empty())
+	{
+		nodes.reserve(2 * staticSlots.size() / LEAF_SIZE + 1);
+		buildNode(0, (uint32_t) staticSlots.size());
+	}
+}
+
+uint32_t SpatialIndex::buildNode(uint32_t first, uint32_t count)
+{
+	uint32_t index = (uint32_t) nodes.size();
+	nodes.emplace_back();
+
+	glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+	glm::vec3 centroidMin = min, centroidMax = max;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Item &item = items[staticSlots[i]];
+		min = glm::min(min, item.min);
+		max = glm::max(max, item.max);
+		glm::vec3 centroid = 0.5f * (item.min + item.max);
+		centroidMin = glm::min(centroidMin, centroid);
+		centroidMax = glm::max(centroidMax, centroid);
+	}
+	nodes[index].min = min;
+	nodes[index].max = max;
+
+	if (count <= LEAF_SIZE)
+	{
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return index;
+	}
+
+	// median split along the widest spread of centroids, so both halves stay balanced
+	glm::vec3 spread = centroidMax - centroidMin;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(staticSlots.begin() + first, staticSlots.begin() + first + half, staticSlots.begin() + first + count,
+		[this, axis](uint32_t a, uint32_t b) {
+			return items[a].min[axis] + items[a].max[axis] < items[b].min[axis] + items[b].max[axis];
+		});
+
+	// the left child follows its parent, the parent keeps the right one
+	buildNode(first, half);
+	uint32_t right = buildNode(first + half, count - half);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+bool SpatialIndex::firstVisit(uint32_t slot) const
+{
+	if (!items[slot].alive || !items[slot].enabled || stamps[slot] == stamp)
+	{
+		return false;
+	}
+	stamps[slot] = stamp;
+	return true;
+}
+
+template <typename Visit>
+void SpatialIndex::forEachCandidate(const glm::vec3 &min, const glm::vec3 &max, Visit visit) const
+{
+	if (++stamp == 0)
+	{
+		std::fill(stamps.begin(), stamps.end(), 0);
+		stamp = 1;
+	}
+	testCount = 0;
+
+	if (!nodes.empty())
+	{
+		uint32_t stack[MAX_DEPTH];
+		int depth = 0;
+		stack[depth++] = 0;
+		while (depth > 0)
+		{
+			const Node &node = nodes[stack[--depth]];
+			if (!overlaps(node.min, node.max, min, max))
+			{
+				continue;
+			}
+			if (node.count > 0)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					if (firstVisit(staticSlots[i]))
+					{
+						visit(staticSlots[i]);
+					}
+				}
+			}
+			else
+			{
+				stack[depth++] = node.first;
+				stack[depth++] = (uint32_t) (&node - nodes.data()) + 1;
+			}
+		}
+	}
+
+	if (dynamicCount > 0)
+	{
+		glm::ivec3 first = cellOf(min), last = cellOf(max);
+		glm::ivec3 span = last - first + 1;
+		if ((double) span.x * span.y * span.z > (double) cells.size())
+		{
+			// a box over more cells than are occupied, walking the occupied ones is cheaper
+			for (const auto &cell : cells)
+			{
+				for (uint32_t slot : cell.second)
+				{
+					if (firstVisit(slot))
+					{
+						visit(slot);
+					}
+				}
+			}
+			return;
+		}
+		for (int x = first.x; x <= last.x; x++)
+		{
+			for (int y = first.y; y <= last.y; y++)
+			{
+				for (int z = first.z; z <= last.z; z++)
+				{
+					auto cell = cells.find(cellKey(x, y, z));
+					if (cell == cells.end())
+					{
+						continue;
+					}
+					for (uint32_t slot : cell->second)
+					{
+						if (firstVisit(slot))
+						{
+							visit(slot);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void SpatialIndex::queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<int> &ids) const
+{
+	ids.clear();
+	forEachCandidate(min, max, [&](uint32_t slot) {
+		const Item &item = items[slot];
+		testCount++;
+		if (overlaps(item.min, item.max, min, max))
+		{
+			ids.push_back(item.id);
+		}
+	});
+}
+
+void SpatialIndex::queryRadius(const glm::vec3 &center, float radius, std::vector<int> &ids) const
+{
+	ids.clear();
+	forEachCandidate(center - glm::vec3(radius), center + glm::vec3(radius), [&](uint32_t slot) {
+		const Item &item = items[slot];
+		testCount++;
+		if (distanceSquared(center, item.min, item.max) <= radius * radius)
+		{
+			ids.push_back(item.id);
+		}
+	});
+}
+
+void SpatialIndex::queryNearest(const glm::vec3 &point, size_t k, std::vector<int> &ids) const
+{
+	ids.clear();
+	if (k == 0 || slots.empty())
+	{
+		return;
+	}
+
+	// every item within radius is found, so once k are inside it the k nearest are among them;
+	// otherwise the radius doubles until it reaches the farthest corner of everything indexed
+	glm::vec3 farthest = glm::max(glm::abs(point - extentMin), glm::abs(point - extentMax));
+	float reach = glm::length(farthest);
+
+	std::vector<std::pair<float, int>> found;
+	size_t tests = 0;
+	for (float radius = cellSize; ; radius *= 2.0f)
+	{
+		found.clear();
+		forEachCandidate(point - glm::vec3(radius), point + glm::vec3(radius), [&](uint32_t slot) {
+			const Item &item = items[slot];
+			testCount++;
+			float distance = distanceSquared(point, item.min, item.max);
+			if (distance <= radius * radius)
+			{
+				found.emplace_back(distance, item.id);
+			}
+		});
+		tests += testCount;
+		if (found.size() >= k || radius >= reach)
+		{
+			break;
+		}
+	}
+	testCount = tests;
+
+	size_t count = std::min(k, found.size());
+	std::partial_sort(found.begin(), found.begin() + count, found.end());
+	for (size_t i = 0; i < count; i++)
+	{
+		ids.push_back(found[i].second);
+	}
+}
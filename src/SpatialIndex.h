@@ -0,0 +1,108 @@
+#pragma  once
+
+#ifndef SPATIALINDEX_H_INCLUDED
+#define SPATIALINDEX_H_INCLUDED
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Answers "what is near here" for gameplay items (collectibles, triggers) by
+// their world-space boxes, without testing every item.
+//
+// Items that never move are static: buildStatic() puts them in a bounding volume
+// hierarchy, after which they can only be switched off and on (e.g. collected
+// and reset). Everything else is dynamic and lives in a spatial hash of cubic
+// cells, where insert(), update() and remove() only touch the cells an item
+// covers. Queries search both and report each enabled item once.
+//
+// Queries reuse scratch state, so one index must not be queried from several
+// threads at once.
+class SpatialIndex
+{
+
+public:
+
+	explicit SpatialIndex(float cellSize = 4.0f);
+
+	// id is the caller's handle, e.g. an index into its own array; ids are unique
+	void insert(int id, const glm::vec3 &min, const glm::vec3 &max, bool isStatic = false);
+	// Moves a dynamic item
+	void update(int id, const glm::vec3 &min, const glm::vec3 &max);
+	void remove(int id);
+	// Disabled items stay indexed but are skipped by queries
+	void setEnabled(int id, bool enabled);
+	void setAllEnabled(bool enabled);
+	void clear();
+
+	// Rebuilds the hierarchy over every static item inserted so far
+	void buildStatic();
+
+	// Items whose box overlaps min..max
+	void queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<int> &ids) const;
+	// Items whose box comes within radius of center
+	void queryRadius(const glm::vec3 &center, float radius, std::vector<int> &ids) const;
+	// Up to k items closest to point by distance to their box, nearest first
+	void queryNearest(const glm::vec3 &point, size_t k, std::vector<int> &ids) const;
+
+	// boxes tested by the last query, to compare against the item count
+	size_t getLastTestCount() const { return testCount; }
+	size_t getItemCount() const { return items.size() - freeSlots.size(); }
+
+private:
+
+	struct Item
+	{
+		int id;
+		glm::vec3 min;
+		glm::vec3 max;
+		bool isStatic;
+		bool enabled;
+		bool alive;
+	};
+
+	struct Node
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		// leaves: first entry in staticSlots and count; inner nodes: right child and 0
+		uint32_t first;
+		uint32_t count;
+	};
+
+	typedef int64_t CellKey;
+
+	CellKey cellKey(int x, int y, int z) const;
+	glm::ivec3 cellOf(const glm::vec3 &point) const;
+	void addToCells(uint32_t slot);
+	void removeFromCells(uint32_t slot);
+	uint32_t buildNode(uint32_t first, uint32_t count);
+	// calls visit(slot) for every enabled item whose box may overlap min..max, each once
+	template <typename Visit>
+	void forEachCandidate(const glm::vec3 &min, const glm::vec3 &max, Visit visit) const;
+	bool firstVisit(uint32_t slot) const;
+
+	float cellSize;
+	std::vector<Item> items;
+	std::vector<uint32_t> freeSlots;
+	std::unordered_map<int, uint32_t> slots;
+	std::unordered_map<CellKey, std::vector<uint32_t>> cells;
+
+	// grows with every insert and move, bounds the search of queryNearest()
+	glm::vec3 extentMin;
+	glm::vec3 extentMax;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> staticSlots;
+	size_t dynamicCount = 0;
+
+	// per-slot stamp of the last query that reported it, so items in several cells are reported once
+	mutable std::vector<uint32_t> stamps;
+	mutable uint32_t stamp = 0;
+	mutable size_t testCount = 0;
+
+};
+
+#endif // SPATIALINDEX_H_INCLUDED
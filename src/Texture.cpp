@@ -1,5 +1,7 @@
 #include "Texture.h"
 #include "GLSL.h"
+#include "GLState.h"
+#include "ResourcePack.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
@@ -25,7 +27,13 @@ void Texture::init()
 	// Load texture
 	int w, h, ncomps;
 	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(filename.c_str(), &w, &h, &ncomps, 0);
+	unsigned char *data;
+	ResourceView packed = ResourcePack::find(filename);
+	if(packed) {
+		data = stbi_load_from_memory(packed.data, (int)packed.size, &w, &h, &ncomps, 0);
+	} else {
+		data = stbi_load(filename.c_str(), &w, &h, &ncomps, 0);
+	}
 	if(!data) {
 		cerr << filename << " not found" << endl;
 	}
@@ -41,7 +49,7 @@ void Texture::init()
 	// Generate a texture buffer object
 	glGenTextures(1, &tid);
 	// Bind the current texture to be the newly generated texture object
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::bindTextureForEdit(GL_TEXTURE_2D, tid);
 	// Load the actual texture data
 	// Base level is 0, number of channels is 3, and border is 0.
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
@@ -53,8 +61,6 @@ void Texture::init()
 	// Set filtering mode for magnification and minimification
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	// Unbind
-	glBindTexture(GL_TEXTURE_2D, 0);
 	// Free image, since the data is now on the GPU
 	stbi_image_free(data);
 }
@@ -62,20 +68,18 @@ void Texture::init()
 void Texture::setWrapModes(GLint wrapS, GLint wrapT)
 {
 	// Must be called after init()
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::bindTextureForEdit(GL_TEXTURE_2D, tid);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
 }
 
 void Texture::bind(GLint handle)
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::bindTexture(unit, GL_TEXTURE_2D, tid);
 	glUniform1i(handle, unit);
 }
 
 void Texture::unbind()
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(unit, GL_TEXTURE_2D, 0);
 }
@@ -0,0 +1,125 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobsQueued == jobs.size()) {
+            // unroll the ring into a larger one, oldest job first
+            std::vector<std::function<void()>> grown(std::max<size_t>(16, 2 * jobs.size()));
+            for (size_t i = 0; i < jobsQueued; i++) {
+                grown[i] = std::move(jobs[(jobsHead + i) % jobs.size()]);
+            }
+            jobs.swap(grown);
+            jobsHead = 0;
+        }
+        jobs[(jobsHead + jobsQueued) % jobs.size()] = std::move(job);
+        jobsQueued++;
+        pendingJobs++;
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this]() { return pendingJobs == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &func)
+{
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t chunkCount = (count + grain - 1) / grain;
+    if (chunkCount == 1) {
+        func(0, count);
+        return;
+    }
+
+    // Shared between the caller and the helpers; helpers check in before the
+    // caller may return so the state can live on this stack frame.
+    struct LoopState {
+        std::atomic<size_t> nextChunk{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t activeHelpers = 0;
+    } state;
+
+    auto runChunks = [&state, &func, count, grain, chunkCount]() {
+        size_t chunk;
+        while ((chunk = state.nextChunk.fetch_add(1)) < chunkCount) {
+            size_t begin = chunk * grain;
+            func(begin, std::min(begin + grain, count));
+        }
+    };
+
+    size_t helperCount = std::min<size_t>(workers.size(), chunkCount - 1);
+    state.activeHelpers = helperCount;
+    for (size_t i = 0; i < helperCount; i++) {
+        submit([&state, &runChunks]() {
+            runChunks();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (--state.activeHelpers == 0) {
+                state.finished.notify_one();
+            }
+        });
+    }
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.finished.wait(lock, [&state]() { return state.activeHelpers == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || jobsQueued > 0; });
+            if (jobsQueued == 0) {
+                return;
+            }
+            job = std::move(jobs[jobsHead]);
+            jobs[jobsHead] = nullptr;
+            jobsHead = (jobsHead + 1) % jobs.size();
+            jobsQueued--;
+        }
+
+        job();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pendingJobs == 0) {
+            jobsDone.notify_all();
+        }
+    }
+}
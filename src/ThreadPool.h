@@ -0,0 +1,47 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for background jobs and fork/join parallel loops
+class ThreadPool {
+    public:
+        // threadCount 0 starts one worker per hardware thread
+        explicit ThreadPool(unsigned int threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned int getThreadCount() const { return workers.size(); }
+
+        void submit(std::function<void()> job);
+
+        // blocks until every submitted job has finished
+        void wait();
+
+        // Calls func(begin, end) over [0, count) in chunks of at most grain items.
+        // The calling thread works on chunks too and returns once all are done.
+        void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& func);
+
+    private:
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        // Ring of queued jobs, grown when full; unlike a deque it keeps its
+        // storage, so a steady rate of jobs never allocates
+        std::vector<std::function<void()>> jobs;
+        size_t jobsHead = 0;
+        size_t jobsQueued = 0;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobsDone;
+        size_t pendingJobs = 0;
+        bool stopping = false;
+};
+
+#endif // THREADPOOL_H
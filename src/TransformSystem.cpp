@@ -0,0 +1,126 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+
+// push_back() binds it to a reference, so it needs storage
+const TransformSystem::Handle TransformSystem::NONE;
+
+// translate * rotate * scale, built by columns instead of multiplying three matrices
+static glm::mat4 composeLocal(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+	glm::mat3 r = glm::mat3_cast(rotation);
+	glm::mat4 local;
+	local[0] = glm::vec4(r[0] * scale.x, 0.0f);
+	local[1] = glm::vec4(r[1] * scale.y, 0.0f);
+	local[2] = glm::vec4(r[2] * scale.z, 0.0f);
+	local[3] = glm::vec4(translation, 1.0f);
+	return local;
+}
+
+TransformSystem::Handle TransformSystem::create(Handle parent, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+	Handle handle = (Handle) parents.size();
+	parents.push_back(parent);
+	firstChildren.push_back(NONE);
+	nextSiblings.push_back(NONE);
+	translations.push_back(translation);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	worlds.emplace_back(1.0f);
+	dirty.push_back(0);
+
+	if (parent != NONE)
+	{
+		nextSiblings[handle] = firstChildren[parent];
+		firstChildren[parent] = handle;
+	}
+	markDirty(handle);
+	return handle;
+}
+
+void TransformSystem::clear()
+{
+	parents.clear();
+	firstChildren.clear();
+	nextSiblings.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	worlds.clear();
+	dirty.clear();
+	dirtyList.clear();
+	updatedCount = 0;
+}
+
+void TransformSystem::markDirty(Handle handle)
+{
+	if (!dirty[handle])
+	{
+		dirty[handle] = 1;
+		dirtyList.push_back(handle);
+	}
+}
+
+void TransformSystem::setTranslation(Handle handle, const glm::vec3 &translation)
+{
+	translations[handle] = translation;
+	markDirty(handle);
+}
+
+void TransformSystem::setRotation(Handle handle, const glm::quat &rotation)
+{
+	rotations[handle] = rotation;
+	markDirty(handle);
+}
+
+void TransformSystem::setScale(Handle handle, const glm::vec3 &scale)
+{
+	scales[handle] = scale;
+	markDirty(handle);
+}
+
+void TransformSystem::setLocal(Handle handle, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+	translations[handle] = translation;
+	rotations[handle] = rotation;
+	scales[handle] = scale;
+	markDirty(handle);
+}
+
+void TransformSystem::update()
+{
+	updatedCount = 0;
+	if (dirtyList.empty())
+	{
+		return;
+	}
+
+	// parents have lower handles, so each subtree is walked from its topmost dirty object
+	std::sort(dirtyList.begin(), dirtyList.end());
+	for (Handle root : dirtyList)
+	{
+		if (!dirty[root])
+		{
+			// already recomputed below a dirty ancestor
+			continue;
+		}
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			Handle handle = stack.back();
+			stack.pop_back();
+
+			glm::mat4 local = composeLocal(translations[handle], rotations[handle], scales[handle]);
+			Handle parent = parents[handle];
+			worlds[handle] = parent == NONE ? local : worlds[parent] * local;
+			dirty[handle] = 0;
+			updatedCount++;
+
+			for (Handle child = firstChildren[handle]; child != NONE; child = nextSiblings[child])
+			{
+				stack.push_back(child);
+			}
+		}
+	}
+	dirtyList.clear();
+}
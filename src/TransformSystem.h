@@ -0,0 +1,69 @@
+#pragma  once
+
+#ifndef TRANSFORMSYSTEM_H_INCLUDED
+#define TRANSFORMSYSTEM_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Local translation, rotation and scale of every scene object, with its world
+// matrix cached until it or one of its ancestors moves.
+//
+// Objects live in contiguous arrays indexed by handle. Setting a local value
+// marks the object dirty; update() recomputes the world matrices of the dirty
+// objects and everything below them, so objects that never move cost nothing
+// after their first update. A parent must be created before its children.
+class TransformSystem
+{
+
+public:
+
+	typedef uint32_t Handle;
+	static const Handle NONE = 0xffffffff;
+
+	Handle create(Handle parent = NONE, const glm::vec3 &translation = glm::vec3(0.0f),
+		const glm::quat &rotation = glm::quat(), const glm::vec3 &scale = glm::vec3(1.0f));
+	void clear();
+
+	void setTranslation(Handle handle, const glm::vec3 &translation);
+	void setRotation(Handle handle, const glm::quat &rotation);
+	void setScale(Handle handle, const glm::vec3 &scale);
+	void setLocal(Handle handle, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale);
+
+	const glm::vec3 &getTranslation(Handle handle) const { return translations[handle]; }
+	const glm::quat &getRotation(Handle handle) const { return rotations[handle]; }
+	const glm::vec3 &getScale(Handle handle) const { return scales[handle]; }
+	Handle getParent(Handle handle) const { return parents[handle]; }
+
+	// Recomputes the world matrices of everything that moved since the last call
+	void update();
+	// Valid as of the last update()
+	const glm::mat4 &getWorld(Handle handle) const { return worlds[handle]; }
+	size_t getCount() const { return parents.size(); }
+	// world matrices recomputed by the last update()
+	size_t getUpdatedCount() const { return updatedCount; }
+
+private:
+
+	void markDirty(Handle handle);
+
+	std::vector<Handle> parents;
+	std::vector<Handle> firstChildren;
+	std::vector<Handle> nextSiblings;
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;
+
+	// objects set since the last update, the roots of the subtrees it walks
+	std::vector<Handle> dirtyList;
+	std::vector<Handle> stack;
+	size_t updatedCount = 0;
+
+};
+
+#endif // TRANSFORMSYSTEM_H_INCLUDED
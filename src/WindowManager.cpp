@@ -30,7 +30,7 @@ WindowManager::~WindowManager()
 	}
 }
 
-bool WindowManager::init(int const width, int const height)
+bool WindowManager::init(int const width, int const height, bool visible)
 {
 	glfwSetErrorCallback(error_callback);
 
@@ -45,6 +45,12 @@ bool WindowManager::init(int const width, int const height)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+#ifndef NDEBUG
+	// debug contexts report more through KHR_debug, release builds skip the overhead
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
 	// Create a windowed mode window and its OpenGL context.
 	windowHandle = glfwCreateWindow(width, height, "Final Project", nullptr, nullptr);
@@ -66,6 +72,10 @@ bool WindowManager::init(int const width, int const height)
 	std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+#ifndef NDEBUG
+	GLSL::enableDebugOutput();
+#endif
+
 	// Set vsync
 	glfwSwapInterval(1);
 
@@ -55,7 +55,8 @@ public:
 	WindowManager(const WindowManager&) = delete;
 	WindowManager& operator= (const WindowManager&) = delete;
 
-	bool init(int const width, int const height);
+	// a hidden window still has a context for loading, e.g. to simulate without drawing
+	bool init(int const width, int const height, bool visible = true);
 	void shutdown();
 
 	void setEventCallbacks(EventCallbacks *callbacks);
@@ -6,9 +6,10 @@
 #include <glad/glad.h>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
 #include "GLSL.h"
 #include "Program.h"
-#include "MatrixStack.h"
 #include "WindowManager.h"
 #include "Texture.h"
 #include "Spline.h"
@@ -16,6 +17,29 @@
 #include "AssimpModel.h"
 #include "Animator.h"
 #include "LightTrail.h"
+#include "ResourcePack.h"
+#include "ProgramCache.h"
+#include "FrameUniforms.h"
+#include "MaterialTable.h"
+#include "DrawRecords.h"
+#include "GLState.h"
+#include "MaterialBatcher.h"
+#include "ShaderVariants.h"
+#include "BoneUniforms.h"
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "FrustumCuller.h"
+#include "SpatialIndex.h"
+#include "TransformSystem.h"
+#include "FixedTimestep.h"
+#include "FrameQueue.h"
+#include "RenderFrame.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "Profiler.h"
+#include "GpuTimer.h"
 
 // value_ptr for glm
 #include <glm/gtc/type_ptr.hpp>
@@ -24,7 +48,6 @@
 using namespace std;
 using namespace glm;
 
-#define NUM_LIGHTS 4
 #define MAX_BONES 200
 
 class Collectible {
@@ -35,6 +58,7 @@ public:
 	glm::vec3 AABBmin;
 	glm::vec3 AABBmax;
 	bool collected;
+	TransformSystem::Handle transform = TransformSystem::NONE;
 
 	Collectible(AssimpModel* model, const glm::vec3& position, const float scale)
 		: model(model), position(position), scale(scale), collected(false)
@@ -59,7 +83,48 @@ public:
 	WindowManager * windowManager = nullptr;
 
 	// Our shader programs
-	std::shared_ptr<Program> texProg, prog2, assimptexProg;
+	std::shared_ptr<Program> texProg, prog2, texArrayProg;
+	// texProg and texArrayProg reading their draw records per instance, for merged draws
+	std::shared_ptr<Program> texInstancedProg, texArrayInstancedProg;
+	// assimp_tex shaders compiled per mesh feature set
+	ShaderVariants assimpVariants;
+	// camera, shared by every program through one uniform buffer
+	FrameUniforms frameUniforms;
+	// the frame's lights, binned into view-space clusters on the thread pool
+	LightClusters lightClusters;
+	ThreadPool threadPool;
+	// materials by MaterialId, and the model matrix, material and flags of every draw in the frame
+	MaterialTable materials;
+	DrawRecords drawRecords;
+	// skinning palette of the animated character
+	BoneUniforms boneUniforms;
+	// GPU time of each pass, in the profiler's trace
+	GpuTimer gpuTimer;
+	// collectible diffuse maps repacked into texture arrays, toggled with M
+	MaterialBatcher materialBatcher;
+	std::atomic<bool> batchMaterials{true};
+	// the array texture of each batcher array, on its unit, for render queue packets
+	vector<TextureBinding> arrayBindings;
+	// every draw of the frame, sorted and merged before it reaches GL
+	RenderQueue renderQueue;
+	// per-instance records of merged and instanced draws
+	InstanceBuffer instanceBuffer;
+	// decorative barrels behind the play area, one instanced draw per barrel mesh (--barrels N)
+	size_t barrelFieldCount = 0;
+	vector<mat4> barrelFieldTransforms;
+	vector<InstanceParams> barrelFieldParams;
+	// the frame's meshes, and the barrel field built once, tested against the view frustum
+	FrustumCuller sceneCuller;
+	FrustumCuller barrelFieldCuller;
+
+	enum MaterialId {
+		MATERIAL_GOLD,
+		MATERIAL_SILVER,
+		MATERIAL_BRONZE,
+		MATERIAL_BLACK,
+		MATERIAL_DARK_WHITE,
+		MATERIAL_COLLECTIBLE
+	};
 
 	// ground data
 	GLuint GrndBuffObj, GrndNorBuffObj, GIndxBuffObj;
@@ -71,7 +136,14 @@ public:
 	std::vector<Collectible> collectibles;
 	int collectedCount = 0;
 	int totalCollectibles = 0;
-	float finishTime;
+	// local and cached world transforms of the character and the collectibles
+	TransformSystem transforms;
+	TransformSystem::Handle manNode = TransformSystem::NONE;
+	// collectible boxes by index, so a pickup check only tests the ones near the character
+	SpatialIndex pickupIndex;
+	vector<int> nearbyPickups;
+	// simulated time all collectibles were found at
+	double finishTime;
 	bool reset = false;
 	// character bounding box
 	glm::vec3 manAABBmin, manAABBmax;
@@ -82,9 +154,6 @@ public:
 	Animation *stickfigure_anim, *stickfigure_idle;
 	Animator *stickfigure_animator;
 
-	float AnimDeltaTime = 0.0f;
-	float AnimLastFrame = 0.0f;
-
 	vec3 gMin;
 
 	float lightTrans = -2;
@@ -139,6 +208,23 @@ public:
 
 	Man_State manState = STANDING;
 
+	// movement, pickups and the game reset run in fixed ticks, see simulate()
+	FixedTimestep timestep;
+	// units per second, about what the key repeat moved the character before
+	float manSpeed = 6.0f;
+	// set by keyCallback on the main thread, read by simulate() on the recording thread
+	std::atomic<bool> moveForward{false}, moveBack{false}, moveLeft{false}, moveRight{false};
+	// mouse and scroll look since the last frame, applied by applyLookInput()
+	std::mutex lookMutex;
+	float pendingTheta = 0.0f;
+	float pendingPhi = 0.0f;
+	// framebuffer size for the recording thread, which must not query the window itself
+	std::atomic<int> framebufferWidth{1}, framebufferHeight{1};
+	// the character's position one tick earlier, recordFrame() draws it between the two
+	vec3 prevManTrans = manTrans;
+	// --simulate replaces the keys with a script that walks the character in circles
+	bool scriptedInput = false;
+
 	void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 	{
 		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -149,93 +235,18 @@ public:
 		{
 			glfwSetWindowShouldClose(window, GL_TRUE);
 		}
-		//update global camera rotate
-		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_W) != GLFW_RELEASE) {
-			// eye = eye + wasd_sens * normalize(lookAt - eye); // w vector
-			// lookAt = lookAt + wasd_sens * normalize(lookAt - eye); // w vector
-			// manTrans.x += 0.2f;
-			// eye.x += 0.2f;
-			manTrans += manMoveDir * 0.2f;
-			eye += manMoveDir * 0.2f;
-			lookAt = manTrans;
-
-
-			manState = WALKING;
-
-			// cout << "pressing W" << endl;
-
-
-			if (debug_pos) {
-				cout << "eye: " << eye.x << " " << eye.y << " " << eye.z << endl;
-				cout << "lookAt: " << lookAt.x << " " << lookAt.y << " " << lookAt.z << endl;
-			}
-		} else if (key == GLFW_KEY_W && action == GLFW_RELEASE) {
-			manState = STANDING;
-
-			// cout << "releasing W" << endl;
-		}
-		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_S) != GLFW_RELEASE) {
-			// eye = eye - wasd_sens * normalize(lookAt - eye); // w vector
-			// lookAt = lookAt - wasd_sens * normalize(lookAt - eye); // w vector
-			// manTrans.x -= 0.2f;
-			// eye.x -= 0.2f;
-			manTrans -= manMoveDir * 0.2f;
-			eye -= manMoveDir * 0.2f;
-			lookAt = manTrans;
-
-
-			manState = WALKING;
-
-			if (debug_pos) {
-				cout << "eye: " << eye.x << " " << eye.y << " " << eye.z << endl;
-				cout << "lookAt: " << lookAt.x << " " << lookAt.y << " " << lookAt.z << endl;
-			}
-
-		} else if (key == GLFW_KEY_S && action == GLFW_RELEASE) {
-			manState = STANDING;
-		}
-		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_A) != GLFW_RELEASE) {
-			// eye = eye - wasd_sens * normalize(cross(lookAt - eye, up)); // u vector
-			// lookAt = lookAt - wasd_sens * normalize(cross(lookAt - eye, up)); // u vector
-
-			// manTrans.z -= 0.2f;
-			// eye.z -= 0.2f;
-			vec3 right = normalize(cross(manMoveDir, up));
-			manTrans -= right * 0.2f;
-			eye -= right * 0.2f;
-			lookAt = manTrans;
-
-
-			manState = WALKING;
-
-			if (debug_pos) {
-				cout << "eye: " << eye.x << " " << eye.y << " " << eye.z << endl;
-				cout << "lookAt: " << lookAt.x << " " << lookAt.y << " " << lookAt.z << endl;
-			}
-
-		} else if (key == GLFW_KEY_A && action == GLFW_RELEASE) {
-			manState = STANDING;
-		}
-		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_D) != GLFW_RELEASE) {
-			// eye = eye + wasd_sens * normalize(cross(lookAt - eye, up)); // u vector
-			// lookAt = lookAt + wasd_sens * normalize(cross(lookAt - eye, up)); // u vector
-
-			// manTrans.z += 0.2f;
-			// eye.z += 0.2f;
-			vec3 right = normalize(cross(manMoveDir, up));
-			manTrans += right * 0.2f;
-			eye += right * 0.2f;
-			lookAt = manTrans;
-
-
-			manState = WALKING;
-
-			if (debug_pos) {
-				cout << "eye: " << eye.x << " " << eye.y << " " << eye.z << endl;
-				cout << "lookAt: " << lookAt.x << " " << lookAt.y << " " << lookAt.z << endl;
+		// movement keys only say which way to go, simulate() moves the character every tick
+		if (action != GLFW_REPEAT) {
+			bool pressed = action == GLFW_PRESS;
+			if (key == GLFW_KEY_W) {
+				moveForward = pressed;
+			} else if (key == GLFW_KEY_S) {
+				moveBack = pressed;
+			} else if (key == GLFW_KEY_A) {
+				moveLeft = pressed;
+			} else if (key == GLFW_KEY_D) {
+				moveRight = pressed;
 			}
-		} else if (key == GLFW_KEY_D && action == GLFW_RELEASE) {
-			manState = STANDING;
 		}
 		if (glfwGetKey(window, GLFW_KEY_Q)){
 			lightTrans += 1.0;
@@ -250,6 +261,14 @@ public:
 		if (key == GLFW_KEY_Z && action == GLFW_RELEASE) {
 			glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 		}
+		if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+			batchMaterials = !batchMaterials;
+			cout << "Material batching " << (batchMaterials ? "on" : "off") << endl;
+		}
+		if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+			GLSL::setDebugOutputSynchronous(!GLSL::isDebugOutputSynchronous());
+			cout << "Synchronous GL debug output " << (GLSL::isDebugOutputSynchronous() ? "on" : "off") << endl;
+		}
 	}
 
 	void scrollCallback(GLFWwindow *window, double deltaX, double deltaY)
@@ -257,24 +276,9 @@ public:
 
 			float sensitivity = 0.7f;
 
-			theta = theta + deltaX * sensitivity;
-
-			phi = phi - deltaY * sensitivity;
-
-			if (phi > radians(-10.0f))
-			{
-				phi = radians(-10.0f);
-			}
-			// if (phi > radians(80.0f))
-			// {
-			// 	phi = radians(80.0f);
-			// }
-			if (phi < radians(-80.0f))
-			{
-				phi = radians(-80.0f);
-			}
-
-			updateCameraVectors();
+			std::lock_guard<std::mutex> lock(lookMutex);
+			pendingTheta += deltaX * sensitivity;
+			pendingPhi -= deltaY * sensitivity;
 	}
 
 	void mouseMoveCallback(GLFWwindow* window, double xpos, double ypos) {
@@ -292,8 +296,27 @@ public:
 
 		float mouseSensitivity = 0.005f;
 
-		theta = theta + deltaX * mouseSensitivity;
-		phi = phi + deltaY * mouseSensitivity;
+		std::lock_guard<std::mutex> lock(lookMutex);
+		pendingTheta += deltaX * mouseSensitivity;
+		pendingPhi += deltaY * mouseSensitivity;
+	}
+
+	// turns the camera and character by the look input gathered since the last frame
+	void applyLookInput() {
+		float deltaTheta, deltaPhi;
+		{
+			std::lock_guard<std::mutex> lock(lookMutex);
+			deltaTheta = pendingTheta;
+			deltaPhi = pendingPhi;
+			pendingTheta = 0.0f;
+			pendingPhi = 0.0f;
+		}
+		if (deltaTheta == 0.0f && deltaPhi == 0.0f) {
+			return;
+		}
+
+		theta = theta + deltaTheta;
+		phi = phi + deltaPhi;
 		if (phi > radians(-10.0f))
 		{
 			phi = radians(-10.0f);
@@ -351,92 +374,100 @@ public:
 
 		// Set background color and enable z-buffer test
 		glClearColor(.12f, .34f, .56f, 1.0f);
-		glEnable(GL_DEPTH_TEST);
+		GLState::enable(GL_DEPTH_TEST);
+
+		// registers the PerFrame block binding, so it has to exist before any program links
+		frameUniforms.init();
+		lightClusters.init();
+		materials.init();
+		drawRecords.init(64);
+		boneUniforms.init();
+		gpuTimer.init();
+		AssimpMesh::registerSamplerUnits();
+		MaterialBatcher::registerSamplerUnits();
+		addMaterials();
+
+		auto shaderStart = chrono::high_resolution_clock::now();
+		// the clustered light lookup every lit fragment shader shares
+		const std::string clusterLights = resourceDirectory + "/cluster_lights.glsl";
 
 		// Initialize the GLSL program that we will use for texture mapping
 		texProg = make_shared<Program>();
 		texProg->setVerbose(true);
 		texProg->setShaderNames(resourceDirectory + "/tex_vert.glsl", resourceDirectory + "/tex_frag0.glsl");
-		texProg->init();
-		texProg->addUniform("P");
-		texProg->addUniform("V");
-		texProg->addUniform("M");
-		texProg->addUniform("Texture0");
-		texProg->addUniform("MatAmb");
-		texProg->addUniform("MatSpec");
-		texProg->addUniform("MatShine");
-		texProg->addUniform("numLights");
-		for (int i = 0; i < NUM_LIGHTS; i++) {
-			texProg->addUniform("lightPos[" + to_string(i) + "]");
-			texProg->addUniform("lightColor[" + to_string(i) + "]");
-			texProg->addUniform("lightIntensity[" + to_string(i) + "]");
-		}
-		texProg->addAttribute("vertPos");
-		texProg->addAttribute("vertNor");
-		texProg->addAttribute("vertTex");
+		texProg->setFragmentPrelude(clusterLights);
 
 		// Initialize the GLSL program that we will use for rendering
 		prog2 = make_shared<Program>();
 		prog2->setVerbose(true);
 		prog2->setShaderNames(resourceDirectory + "/simple_light_vert.glsl", resourceDirectory + "/simple_light_frag.glsl");
-		prog2->init();
-		prog2->addUniform("P");
-		prog2->addUniform("V");
-		prog2->addUniform("M");
-		prog2->addUniform("MatAmb");
+		prog2->setFragmentPrelude(clusterLights);
+
+		// The GLSL programs for assimp models, built once the meshes they draw are known
+		assimpVariants.setVerbose(true);
+		assimpVariants.setShaderNames(resourceDirectory + "/assimp_tex_vert.glsl", resourceDirectory + "/assimp_tex_frag.glsl");
+		assimpVariants.setFragmentPrelude(clusterLights);
+		assimpVariants.addFeature(SHADER_FEATURE_SKINNED, "SKINNED");
+		assimpVariants.addFeature(SHADER_FEATURE_DIFFUSE_MAP, "DIFFUSE_MAP");
+		assimpVariants.addFeature(SHADER_FEATURE_SPECULAR_MAP, "SPECULAR_MAP");
+		assimpVariants.addFeature(SHADER_FEATURE_ROUGHNESS_MAP, "ROUGHNESS_MAP");
+		assimpVariants.addFeature(SHADER_FEATURE_METALNESS_MAP, "METALNESS_MAP");
+		assimpVariants.addFeature(SHADER_FEATURE_EMISSION_MAP, "EMISSION_MAP");
+		assimpVariants.addFeature(SHADER_FEATURE_INSTANCED, "INSTANCED");
+		assimpVariants.addAttribute("vertPos");
+		assimpVariants.addAttribute("vertNor");
+		assimpVariants.addAttribute("vertTex");
+		assimpVariants.setLinkCallback([this](Program& prog) {
+			setLightIntensityScale(prog, 0.0f);
+		});
+
+		// same as texProg, but samples the batched texture arrays
+		texArrayProg = make_shared<Program>();
+		texArrayProg->setVerbose(true);
+		texArrayProg->setShaderNames(resourceDirectory + "/tex_vert.glsl", resourceDirectory + "/tex_array_frag.glsl");
+		texArrayProg->setFragmentPrelude(clusterLights);
+
+		// instanced copies of both, for draws the render queue merges
+		texInstancedProg = make_shared<Program>();
+		texInstancedProg->setVerbose(true);
+		texInstancedProg->setShaderNames(resourceDirectory + "/tex_vert.glsl", resourceDirectory + "/tex_frag0.glsl");
+		texInstancedProg->setFragmentPrelude(clusterLights);
+		texInstancedProg->setDefines({"INSTANCED"});
+		texArrayInstancedProg = make_shared<Program>();
+		texArrayInstancedProg->setVerbose(true);
+		texArrayInstancedProg->setShaderNames(resourceDirectory + "/tex_vert.glsl", resourceDirectory + "/tex_array_frag.glsl");
+		texArrayInstancedProg->setFragmentPrelude(clusterLights);
+		texArrayInstancedProg->setDefines({"INSTANCED"});
+
+		// start every compile before waiting on any, so the driver can work on them in parallel
+		texProg->startInit();
+		prog2->startInit();
+		texArrayProg->startInit();
+		texInstancedProg->startInit();
+		texArrayInstancedProg->startInit();
+		texProg->finishInit();
+		prog2->finishInit();
+		texArrayProg->finishInit();
+		texInstancedProg->finishInit();
+		texArrayInstancedProg->finishInit();
+
+		cout << "Shader setup took " << chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - shaderStart).count() << " ms" << endl;
+
+		// each program scales the shared frame lights once, instead of re-sending them every frame
+		setLightIntensityScale(*prog2, 1.0f);
+		setLightIntensityScale(*texProg, 5.0f); // high intensity for visibility
+		setLightIntensityScale(*texArrayProg, 5.0f);
+		setLightIntensityScale(*texInstancedProg, 5.0f);
+		setLightIntensityScale(*texArrayInstancedProg, 5.0f);
+
+		texProg->addAttribute("vertPos");
+		texProg->addAttribute("vertNor");
+		texProg->addAttribute("vertTex");
 		prog2->addAttribute("vertPos");
 		prog2->addAttribute("vertNor");
-		prog2->addUniform("MatDif");
-		prog2->addUniform("MatSpec");
-		prog2->addUniform("MatShine");
-		for (int i = 0; i < NUM_LIGHTS; i++) {
-			prog2->addUniform("lightPos[" + to_string(i) + "]");
-			prog2->addUniform("lightColor[" + to_string(i) + "]");
-			prog2->addUniform("lightIntensity[" + to_string(i) + "]");
-		}
-		prog2->addUniform("numLights");
-		prog2->addUniform("hasEmittance");
-		prog2->addUniform("MatEmitt");
-		prog2->addUniform("MatEmittIntensity");
-		prog2->addUniform("discardCounter");
-		prog2->addUniform("activateDiscard");
-		prog2->addUniform("randFloat1");
-		prog2->addUniform("randFloat2");
-		prog2->addUniform("randFloat3");
-		prog2->addUniform("randFloat4");
-
-		// Initialize the GLSL program that we will use for assimp models
-		assimptexProg = make_shared<Program>();
-		assimptexProg->setVerbose(true);
-		assimptexProg->setShaderNames(resourceDirectory + "/assimp_tex_vert.glsl", resourceDirectory + "/assimp_tex_frag.glsl");
-		assimptexProg->init();
-		assimptexProg->addUniform("P");
-		assimptexProg->addUniform("V");
-		assimptexProg->addUniform("M");
-		assimptexProg->addUniform("texture_diffuse1");
-		assimptexProg->addUniform("texture_specular1");
-		assimptexProg->addUniform("texture_roughness1");
-		assimptexProg->addUniform("texture_metalness1");
-		assimptexProg->addUniform("texture_emission1");
-		assimptexProg->addAttribute("vertPos");
-		assimptexProg->addAttribute("vertNor");
-		assimptexProg->addAttribute("vertTex");
-		assimptexProg->addAttribute("boneIds");
-		assimptexProg->addAttribute("weights");
-		for (int i = 0; i < MAX_BONES; i++) {
-			assimptexProg->addUniform("finalBonesMatrices[" + to_string(i) + "]");
-		}
-		assimptexProg->addUniform("MatAmb");
-		assimptexProg->addUniform("MatDif");
-		assimptexProg->addUniform("MatSpec");
-		assimptexProg->addUniform("MatShine");
-		for (int i = 0; i < NUM_LIGHTS; i++) {
-			assimptexProg->addUniform("lightPos[" + to_string(i) + "]");
-			assimptexProg->addUniform("lightColor[" + to_string(i) + "]");
-			assimptexProg->addUniform("lightIntensity[" + to_string(i) + "]");
-		}
-		assimptexProg->addUniform("numLights");
-		assimptexProg->addUniform("hasTexture");
+		texArrayProg->addAttribute("vertPos");
+		texArrayProg->addAttribute("vertNor");
+		texArrayProg->addAttribute("vertTex");
 		updateCameraVectors();
 	}
 
@@ -444,17 +475,19 @@ public:
 	{
  		string errStr;
 
+		// none of these models are queried per vertex on the CPU, so only their bounds stay resident after upload
+
 		// load the walking character model
-		stickfigure_running = new AssimpModel(resourceDirectory + "/Vanguard/Vanguard.fbx");
+		stickfigure_running = new AssimpModel(resourceDirectory + "/Vanguard/Vanguard.fbx", false, RETAIN_BOUNDS);
 		stickfigure_anim = new Animation(resourceDirectory + "/Vanguard/Vanguard.fbx", stickfigure_running, 0);
 		stickfigure_idle = new Animation(resourceDirectory + "/Vanguard/Vanguard.fbx", stickfigure_running, 1);
 		stickfigure_animator = new Animator(stickfigure_anim);
 
 		// load the cube
-		cube = new AssimpModel(resourceDirectory + "/cube.obj");
+		cube = new AssimpModel(resourceDirectory + "/cube.obj", false, RETAIN_BOUNDS);
 
 		// load the barrel
-		barrel = new AssimpModel(resourceDirectory + "/Barrel/Barrel_OBJ.obj");
+		barrel = new AssimpModel(resourceDirectory + "/Barrel/Barrel_OBJ.obj", false, RETAIN_BOUNDS);
 		// manually assign the barrel texture
 		// this is happening because the barrel does not have any embedded textures
 		// we could import to blender and then embed the textures as a remedy
@@ -464,12 +497,12 @@ public:
 		barrel->assignTexture("texture_normal1", resourceDirectory + "/Barrel/textures/barrel_normal.png");
 
 		// load the alien
-		alien = new AssimpModel(resourceDirectory + "/Alien/Alien_OBJ.obj");
+		alien = new AssimpModel(resourceDirectory + "/Alien/Alien_OBJ.obj", false, RETAIN_BOUNDS);
 		alien->assignTexture("texture_diffuse1", resourceDirectory + "/Alien/textures/alien.jpg");
 
 		// load the creeper
-		creeper = new AssimpModel(resourceDirectory + "/Creeper/Creeper.obj");
-		creeper->assignTexture("texture_deffuse1", resourceDirectory + "/Creeper/textures/creeper.jpg");
+		creeper = new AssimpModel(resourceDirectory + "/Creeper/Creeper.obj", false, RETAIN_BOUNDS);
+		creeper->assignTexture("texture_diffuse1", resourceDirectory + "/Creeper/textures/creeper.jpg");
 
 		// example debug for checking mesh count of a model, helps w multimesh and sanity checks
 		/*std::cout << "Barrel model has " << barrel->getMeshCount() << " meshes" << std::endl;
@@ -477,18 +510,18 @@ public:
 			std::cout << "  Mesh " << i << " has " << barrel->getMeshSize(i) << " vertices" << std::endl;
 		}*/
 		//load the wizard hat
-		wizard_hat = new AssimpModel(resourceDirectory + "/WizardHat/hat_LP.obj");
+		wizard_hat = new AssimpModel(resourceDirectory + "/WizardHat/hat_LP.obj", false, RETAIN_BOUNDS);
 
 		wizard_hat->assignTexture("texture_diffuse1", resourceDirectory + "/WizardHat/textures/diffuse.png");
 		wizard_hat->assignTexture("texture_roughness1", resourceDirectory + "/WizardHat/textures/roughness.png");
 		wizard_hat->assignTexture("texture_metalness1", resourceDirectory + "/WizardHat/textures/normal.png");
 
 		//load the fish
-		fish = new AssimpModel(resourceDirectory + "/Fish/fish.obj");
+		fish = new AssimpModel(resourceDirectory + "/Fish/fish.obj", false, RETAIN_BOUNDS);
 		fish->assignTexture("texture_diffuse1", resourceDirectory + "/Fish/textures/fishscale.jpg");
 
 		//load the cylinder
-		cylinder = new AssimpModel(resourceDirectory + "/Cylinder/Cylinder_Sci_Fi_1.obj");
+		cylinder = new AssimpModel(resourceDirectory + "/Cylinder/Cylinder_Sci_Fi_1.obj", false, RETAIN_BOUNDS);
 		cylinder->assignTexture("texture_diffuse1", resourceDirectory + "/Cylinder/textures/TX_Cylinder_Sci_Fi_1_1_Base_color.png");
 
 		// add 2 instances of the barrel to the collectibles vector Collectible(<model>, <position>)
@@ -514,62 +547,109 @@ public:
 
 		// update total collectibles
 		totalCollectibles = collectibles.size();
+
+		// collectibles never move, collecting one only switches it off until the reset
+		for (size_t i = 0; i < collectibles.size(); i++) {
+			pickupIndex.insert((int) i, collectibles[i].AABBmin, collectibles[i].AABBmax, true);
+			collectibles[i].transform = transforms.create(TransformSystem::NONE, collectibles[i].position, glm::quat(), vec3(collectibles[i].scale));
+		}
+		pickupIndex.buildStatic();
+		manNode = transforms.create();
+
+		// every collectible mesh with a diffuse map can then be drawn from a shared texture array
+		for (const Collectible& collectible : collectibles) {
+			for (const AssimpMesh& mesh : collectible.model->meshes) {
+				materialBatcher.add(mesh.getTexture(TEXTURE_SLOT_DIFFUSE));
+			}
+		}
+		materialBatcher.build();
+		for (int array = 0; array < materialBatcher.getArrayCount(); array++) {
+			arrayBindings.push_back({MaterialBatcher::ARRAY_UNIT, materialBatcher.getArrayTexture(array)});
+		}
+
+		buildBarrelField();
+
+		// compile the character's variants now rather than on its first frame
+		vector<uint32_t> variantMasks;
+		for (const AssimpMesh& mesh : stickfigure_running->meshes) {
+			variantMasks.push_back(mesh.getShaderFeatures());
+		}
+		assimpVariants.prepare(variantMasks);
+		cout << "Built " << assimpVariants.getVariantCount() << " assimp shader variants" << endl;
 	}
 
-	void SetMaterialMan(shared_ptr<Program> curS, int i) {
-		switch (i) {
-			case 0:
-			// gold
-				glUniform3f(curS->getUniform("MatAmb"), 0.24725f, 0.1995f, 0.0745f);
-				glUniform3f(curS->getUniform("MatDif"), 0.75164f, 0.60648f, 0.22648f);
-				glUniform3f(curS->getUniform("MatSpec"), 0.628281f, 0.555802f, 0.366065f);
-				glUniform1f(curS->getUniform("MatShine"), 51.2f);
-			break;
-			case 1:
-			// silver
-				glUniform3f(curS->getUniform("MatAmb"), 0.19225f, 0.19225f, 0.19225f);
-				glUniform3f(curS->getUniform("MatDif"), 0.50754f, 0.50754f, 0.50754f);
-				glUniform3f(curS->getUniform("MatSpec"), 0.508273f, 0.508273f, 0.508273f);
-				glUniform1f(curS->getUniform("MatShine"), 51.2f);
-			break;
-			case 2:
-			// bronze
-				glUniform3f(curS->getUniform("MatAmb"), 0.2125f, 0.1275f, 0.054f);
-				glUniform3f(curS->getUniform("MatDif"), 0.714f, 0.4284f, 0.18144f);
-				glUniform3f(curS->getUniform("MatSpec"), 0.393548f, 0.271906f, 0.166721f);
-				glUniform1f(curS->getUniform("MatShine"), 25.6f);
-			break;
-			case 3:
-			// black
-				glUniform3f(curS->getUniform("MatAmb"), 0.01f, 0.01f, 0.01f);
-				glUniform3f(curS->getUniform("MatDif"), 0.07f, 0.07f, 0.07f);
-				glUniform3f(curS->getUniform("MatSpec"), 0.1f, 0.1f, 0.1f);
-				glUniform1f(curS->getUniform("MatShine"), 10.0f);
-			break;
-			case 4:
-			// dark white
-				glUniform3f(curS->getUniform("MatAmb"), 0.05f, 0.05f, 0.05f);
-				glUniform3f(curS->getUniform("MatDif"), 0.5f, 0.5f, 0.5f);
-				glUniform3f(curS->getUniform("MatSpec"), 0.7f, 0.7f, 0.7f);
-				glUniform1f(curS->getUniform("MatShine"), 10.0f);
-			break;
+	// a square grid of barrels behind the ground, for stress testing instanced drawing
+	void buildBarrelField() {
+		int side = (int) ceil(sqrt((double) barrelFieldCount));
+		float spacing = 2.5f;
+		vec3 origin(-0.5f * spacing * (side - 1), 0.0f, -groundSize - 5.0f);
+		InstanceParams params;
+		params.materialIndex = MATERIAL_COLLECTIBLE;
+		params.flags = DrawRecords::FLAG_TEXTURED;
+		for (size_t i = 0; i < barrelFieldCount; i++) {
+			vec3 position = origin + vec3(spacing * (i % side), 0.0f, -spacing * (float) (i / side));
+			barrelFieldTransforms.push_back(glm::translate(mat4(1.0f), position));
+			barrelFieldParams.push_back(params);
+			barrelFieldCuller.add(barrel->getBoundingBoxMin(), barrel->getBoundingBoxMax(), barrelFieldTransforms.back());
+		}
+		if (barrelFieldCount > 0) {
+			cout << "Barrel field of " << barrelFieldCount << " instances" << endl;
+		}
+	}
+
+	void recordLights(RenderFrame& frame, float time) {
+		// white light above the origin, where the ground and textured programs had it; the assimp
+		// program's copy at (0, 10, 0) had intensity 0, as its lightIntensityScale still does
+		frame.lights.push_back({vec3(0, 2, 0), vec3(1.0, 1.0, 1.0), 1.0f, 0.0f});
+		// each collectible left glows in its own colour, so its light only reaches nearby clusters
+		static const vec3 glowColors[] = {vec3(1.0, 0.4, 0.1), vec3(0.2, 0.6, 1.0), vec3(0.4, 1.0, 0.3), vec3(0.9, 0.3, 1.0)};
+		for (size_t i = 0; i < collectibles.size(); i++) {
+			if (collectibles[i].collected) continue;
+			vec3 bob(0.0f, 1.0f + 0.25f * sin(2.0f * time + i), 0.0f);
+			frame.lights.push_back({collectibles[i].position + bob, glowColors[i % 4], 2.0f, 4.0f});
 		}
 	}
 
-	/* helper for sending top of the matrix strack to GPU */
-	void setModel(std::shared_ptr<Program> prog, std::shared_ptr<MatrixStack>M) {
-		glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-    }
+	// the batcher placement of every mesh of model, false when any mesh cannot be batched
+	bool findPlacements(const AssimpModel* model, ArenaVector<const MaterialBatcher::Placement*>& placements) const {
+		placements.clear();
+		for (const AssimpMesh& mesh : model->meshes) {
+			const MaterialBatcher::Placement* placement = materialBatcher.find(mesh.getTexture(TEXTURE_SLOT_DIFFUSE));
+			if (!placement) {
+				return false;
+			}
+			placements.push_back(placement);
+		}
+		return true;
+	}
+
+	void setLightIntensityScale(Program& prog, float scale) {
+		// cluster radii have to cover the brightest program
+		lightClusters.setIntensityScale(std::max(lightClusters.getIntensityScale(), scale));
+		const Program::UniformInfo* info = prog.findUniform("lightIntensityScale");
+		if (info) {
+			prog.bind();
+			glUniform1f(info->location, scale);
+			prog.unbind();
+		}
+	}
 
-	/* helper function to set model trasnforms */
-  	void setModel(shared_ptr<Program> curS, vec3 trans, float rotY, float rotX, float sc) {
-  		mat4 Trans = glm::translate( glm::mat4(1.0f), trans);
-  		mat4 RotX = glm::rotate( glm::mat4(1.0f), rotX, vec3(1, 0, 0));
-  		mat4 RotY = glm::rotate( glm::mat4(1.0f), rotY, vec3(0, 1, 0));
-  		mat4 ScaleS = glm::scale(glm::mat4(1.0f), vec3(sc));
-  		mat4 ctm = Trans*RotX*RotY*ScaleS;
-  		glUniformMatrix4fv(curS->getUniform("M"), 1, GL_FALSE, value_ptr(ctm));
-  	}
+	// the table order has to match MaterialId
+	void addMaterials() {
+		// gold
+		materials.add(vec3(0.24725f, 0.1995f, 0.0745f), vec3(0.75164f, 0.60648f, 0.22648f), vec3(0.628281f, 0.555802f, 0.366065f), 51.2f);
+		// silver
+		materials.add(vec3(0.19225f, 0.19225f, 0.19225f), vec3(0.50754f, 0.50754f, 0.50754f), vec3(0.508273f, 0.508273f, 0.508273f), 51.2f);
+		// bronze
+		materials.add(vec3(0.2125f, 0.1275f, 0.054f), vec3(0.714f, 0.4284f, 0.18144f), vec3(0.393548f, 0.271906f, 0.166721f), 25.6f);
+		// black
+		materials.add(vec3(0.01f, 0.01f, 0.01f), vec3(0.07f, 0.07f, 0.07f), vec3(0.1f, 0.1f, 0.1f), 10.0f);
+		// dark white
+		materials.add(vec3(0.05f, 0.05f, 0.05f), vec3(0.5f, 0.5f, 0.5f), vec3(0.7f, 0.7f, 0.7f), 10.0f);
+		// collectibles: bright ambient, strong specular, high shininess
+		materials.add(vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f), vec3(0.8f, 0.8f, 0.8f), 32.0f);
+		materials.upload();
+	}
 
 	void updateBoundingBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, glm::vec3& outWorldMin, glm::vec3& outWorldMax) {
 		// Initialize with extreme values
@@ -619,53 +699,25 @@ public:
 
 		// Generate the ground VAO
 		glGenVertexArrays(1, &GroundVertexArrayID);
-		glBindVertexArray(GroundVertexArrayID);
+		GLState::bindVertexArray(GroundVertexArrayID);
 
 		g_GiboLen = 6;
 		glGenBuffers(1, &GrndBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndPos), GrndPos, GL_STATIC_DRAW);
-
-		glGenBuffers(1, &GrndNorBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndNorm), GrndNorm, GL_STATIC_DRAW);
-
-		glGenBuffers(1, &GIndxBuffObj);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
-	}
-
-    //code to draw the ground plane
-	void drawGround(shared_ptr<Program> curS, std::shared_ptr<MatrixStack> Model) {
-		curS->bind();
-		glBindVertexArray(GroundVertexArrayID);
-
-		// Set material for ground
-		SetMaterialMan(curS, 1);
-
-		// Use the matrix stack for the model matrix
-		Model->pushMatrix();
-		Model->loadIdentity();
-		Model->translate(vec3(0, 0, 0));
-		glUniformMatrix4fv(curS->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
-
 		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
+		glGenBuffers(1, &GrndNorBuffObj);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndNorm), GrndNorm, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-		// Draw
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
-		glDrawElements(GL_TRIANGLES, g_GiboLen, GL_UNSIGNED_SHORT, 0);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-
-		Model->popMatrix();
-		curS->unbind();
+		// the vertex array keeps the attribute and index bindings, drawing only binds it
+		glGenBuffers(1, &GIndxBuffObj);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
 	}
 
 	float randFloat(float l, float h) {
@@ -673,188 +725,323 @@ public:
 		return (1.0f - r) * l + r * h;
 	}
 
-	bool checkAABBCollision(const glm::vec3& minA, const glm::vec3& maxA,
-		const glm::vec3& minB, const glm::vec3& maxB)
-	{
-		return (minA.x <= maxB.x && maxA.x >= minB.x) &&
-			(minA.y <= maxB.y && maxA.y >= minB.y) &&
-			(minA.z <= maxB.z && maxA.z >= minB.z);
+	// distance of the model's bounding box centre in front of the camera
+	float viewDepth(const mat4& modelView, const AssimpModel* model) const {
+		vec3 center = 0.5f * (model->getBoundingBoxMin() + model->getBoundingBoxMax());
+		return -(modelView * vec4(center, 1.0f)).z;
+	}
+
+	// queues mesh with its own textures; instancedProgram may be null to never merge it
+	void submitMesh(RenderFrame& frame, const AssimpMesh& mesh, Program* program, Program* instancedProgram, GLuint record, int lod, float depth) {
+		RenderQueue::Packet packet;
+		packet.program = program;
+		packet.instancedProgram = instancedProgram;
+		packet.geometry = mesh.getGeometry(lod);
+		packet.textures = mesh.textureBindings.data();
+		packet.textureCount = (int) mesh.textureBindings.size();
+		packet.record = record;
+		packet.depth = depth;
+		frame.packets.push_back(packet);
 	}
 
 	void resetCollectibles() {
 		for (auto& collectible : collectibles) {
 			collectible.collected = false;
 		}
+		pickupIndex.setAllEnabled(true);
 		collectedCount = 0;
 		std::cout << "Game reset. Find all the collectibles again!" << std::endl;
 	}
 
-	void render(float frametime, float animTime) {
-		// Get current frame buffer size.
-		int width, height;
-		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-		glViewport(0, 0, width, height);
+	// one tick of gameplay: moves the character by the held keys, then collects what it touches
+	void simulate(float dt) {
+		AllocationTracker::Scope allocationTag(AllocationTracker::TAG_GAMEPLAY);
+		Profiler::Zone zone("simulate");
+		prevManTrans = manTrans;
 
-		// Clear framebuffer.
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (scriptedInput) {
+			moveForward = true;
+			theta += 0.5f * dt;
+			updateCameraVectors();
+		}
 
-		float aspect = width/(float)height;
+		bool moving = moveForward || moveBack || moveLeft || moveRight;
+		manState = moving ? WALKING : STANDING;
+		if (moving) {
+			vec3 right = normalize(cross(manMoveDir, up));
+			vec3 step = (manMoveDir * (float) (moveForward - moveBack) + right * (float) (moveRight - moveLeft)) * (manSpeed * dt);
+			manTrans += step;
+			eye += step;
+			lookAt = manTrans;
 
-		// Create the matrix stacks
-		auto Projection = make_shared<MatrixStack>();
-		auto View = make_shared<MatrixStack>();
-		auto Model = make_shared<MatrixStack>();
+			if (debug_pos) {
+				cout << "eye: " << eye.x << " " << eye.y << " " << eye.z << endl;
+				cout << "lookAt: " << lookAt.x << " " << lookAt.y << " " << lookAt.z << endl;
+			}
+		}
+
+		// update the bounding box for collision detection
+		glm::mat4 manTransform = glm::translate(glm::mat4(1.0f), manTrans)
+			* glm::rotate(glm::mat4(1.0f), manRot.x, glm::vec3(1, 0, 0))
+			* glm::rotate(glm::mat4(1.0f), manRot.y, glm::vec3(0, 1, 0))
+			* glm::scale(glm::mat4(1.0f), manScale);
+		updateBoundingBox(stickfigure_running->getBoundingBoxMin(),
+			stickfigure_running->getBoundingBoxMax(),
+			manTransform,
+			manAABBmin,
+			manAABBmax);
+
+		if (collectedCount >= totalCollectibles && !reset) {
+			std::cout << "All items collected! Resetting Game.\n";
+			finishTime = timestep.getTime();
+			reset = true;
+		} else if (collectedCount >= totalCollectibles && (timestep.getTime() - finishTime >= 1.0)) {
+			resetCollectibles();
+			reset = false;
+		}
+
+		// Check for collisions with the collectibles around the character
+		pickupIndex.queryBox(manAABBmin, manAABBmax, nearbyPickups);
+		for (int id : nearbyPickups) {
+			collectibles[id].collected = true;
+			pickupIndex.setEnabled(id, false);
+			collectedCount++;
+			std::cout << "Collected an item! (" << collectedCount << "/" << totalCollectibles << ")\n";
+		}
+	}
+
+	// Runs the ticks due after frameTime seconds of real time, then records what to draw
+	void advance(RenderFrame& frame, double frameTime) {
+		double start = glfwGetTime();
+		applyLookInput();
+		for (int ticks = timestep.advance(frameTime); ticks > 0; ticks--) {
+			simulate((float) timestep.getStep());
+		}
+		recordFrame(frame, (float) frameTime, timestep.getAlpha());
+		frame.stats.recordTime = glfwGetTime() - start;
+	}
+
+	// Everything a frame needs short of GL: camera, lights, animation, culling, draw records and packets.
+	// alpha is how far the frame is from the last tick to the next. Temporaries come from the
+	// thread's FrameArena, the caller resets it once the frame is recorded
+	void recordFrame(RenderFrame& frame, float frameTime, float alpha) {
+		AllocationTracker::Scope allocationTag(AllocationTracker::TAG_RENDER);
+		Profiler::Zone zone("record frame");
+		frame.clear();
+		int width = framebufferWidth;
+		int height = framebufferHeight;
+		frame.width = width;
+		frame.height = height;
+
+		float aspect = width/(float)height;
 
 		// Apply perspective projection
-		Projection->pushMatrix();
-
-		// Projection->perspective(45.0f, aspect, 0.01f, 200.0f);
-		Projection->perspective(45.0f, aspect, 0.01f, 400.0f);
-
-		// View is global translation along negative z for now
-		View->pushMatrix();
-		View->loadIdentity();
-		View->lookAt(eye, lookAt, vec3(0, 1, 0));
-
-		// Draw the ground
-		prog2->bind();
-		glUniformMatrix4fv(prog2->getUniform("P"), 1, GL_FALSE, value_ptr(Projection->topMatrix()));
-		glUniformMatrix4fv(prog2->getUniform("V"), 1, GL_FALSE, value_ptr(View->topMatrix()));
-		glUniform3f(prog2->getUniform("lightColor[0]"), 1.0, 1.0, 1.0); // white light
-		glUniform1f(prog2->getUniform("lightIntensity[0]"), 1.0); // light intensity
-		glUniform3f(prog2->getUniform("lightPos[0]"), 0, 2, 0); // light position at the computer screen
-		glUniform1i(prog2->getUniform("numLights"), 1); // light position at the computer screen
-		drawGround(prog2, Model);
-		prog2->unbind();
-
-		assimptexProg->bind();
-		glUniformMatrix4fv(assimptexProg->getUniform("P"), 1, GL_FALSE, value_ptr(Projection->topMatrix()));
-		glUniformMatrix4fv(assimptexProg->getUniform("V"), 1, GL_FALSE, value_ptr(View->topMatrix()));
-		glUniform3f(assimptexProg->getUniform("lightColor[0]"), 1.0, 1.0, 1.0); // white light
-		glUniform1f(assimptexProg->getUniform("lightIntensity[0]"), 0.0); // light intensity
-		glUniform3f(assimptexProg->getUniform("lightPos[0]"), 0, 10, 0); // light position at the computer screen
-		glUniform1i(assimptexProg->getUniform("numLights"), 1); // light position at the computer screen
-
-		// select animation for vanguard model
-		stickfigure_animator->UpdateAnimation(1.5 * animTime);
-		if (manState == WALKING) {
-			stickfigure_animator->SetCurrentAnimation(stickfigure_anim);
-		} else if (manState == STANDING) {
-			stickfigure_animator->SetCurrentAnimation(stickfigure_idle);
-		}
-
-		// update the bone matrices according to selected animation
-		vector<glm::mat4> transforms = stickfigure_animator->GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i) {
-			glUniformMatrix4fv(assimptexProg->getUniform("finalBonesMatrices[" + std::to_string(i) + "]"), 1, GL_FALSE, value_ptr(transforms[i]));
-		}
-
-		// set the model matrix and draw the walking character model
-		Model->pushMatrix();
-			Model->loadIdentity();
-			Model->translate(manTrans);
-			Model->scale(0.01f);
-			Model->rotate(manRot.y, vec3(0, 1, 0));
-			Model->rotate(manRot.z, vec3(0, 0, 1));
-
-			// update the bounding box for collision detection
-			glm::mat4 manTransform = glm::translate(glm::mat4(1.0f), manTrans)
-				* glm::rotate(glm::mat4(1.0f), manRot.x, glm::vec3(1, 0, 0))
-				* glm::rotate(glm::mat4(1.0f), manRot.y, glm::vec3(0, 1, 0))
-				* glm::scale(glm::mat4(1.0f), manScale);
-			updateBoundingBox(stickfigure_running->getBoundingBoxMin(),
-				stickfigure_running->getBoundingBoxMax(),
-				manTransform,
-				manAABBmin,
-				manAABBmax);
-
-			glUniform1i(assimptexProg->getUniform("hasTexture"), 1);
-			SetMaterialMan(assimptexProg, 0);
-			setModel(assimptexProg, Model);
-			stickfigure_running->Draw(assimptexProg);
-		Model->popMatrix();
-
-		assimptexProg->unbind();
-
-		// Draw the collectibles with the simple texture shader
-		texProg->bind();
-		glUniformMatrix4fv(texProg->getUniform("P"), 1, GL_FALSE, value_ptr(Projection->topMatrix()));
-		glUniformMatrix4fv(texProg->getUniform("V"), 1, GL_FALSE, value_ptr(View->topMatrix()));
-
-		// Set lighting uniforms
-		glUniform3f(texProg->getUniform("lightColor[0]"), 1.0, 1.0, 1.0); // White light
-		glUniform1f(texProg->getUniform("lightIntensity[0]"), 5.0); // High intensity for visibility
-		glUniform3f(texProg->getUniform("lightPos[0]"), 0, 2, 0);
-		glUniform1i(texProg->getUniform("numLights"), 1);
-
-		// Set material properties
-		glUniform3f(texProg->getUniform("MatAmb"), 0.5, 0.5, 0.5); // Bright ambient
-		glUniform3f(texProg->getUniform("MatSpec"), 0.8, 0.8, 0.8); // Strong specular
-		glUniform1f(texProg->getUniform("MatShine"), 32.0f); // High shininess
-
-		// Check for collisions with collectibles
-		for (auto& collectible : collectibles) {
-			if (collectedCount >= totalCollectibles && !reset) {
-				std::cout << "All items collected! Resetting Game.\n";
-				finishTime = glfwGetTime();
-				reset = true;
-			} else if (collectedCount >= totalCollectibles && (glfwGetTime() - finishTime >= 1.0f)) {
-				resetCollectibles();
-				reset = false;
+		const float zFar = 400.0f;
+		mat4 P = glm::perspective(45.0f, aspect, 0.01f, zFar);
+
+		// the character between its last two ticks, the camera follows it there
+		vec3 manPos = glm::mix(prevManTrans, manTrans, alpha);
+		mat4 V = glm::lookAt(eye + (manPos - manTrans), manPos, vec3(0, 1, 0));
+
+		frame.projection = P;
+		frame.view = V;
+		frame.far = zFar;
+		recordLights(frame, glfwGetTime());
+
+		{
+			AllocationTracker::Scope animationTag(AllocationTracker::TAG_ANIMATION);
+			Profiler::Zone animationZone("animation");
+			// select animation for vanguard model
+			stickfigure_animator->UpdateAnimation(1.5 * frameTime);
+			if (manState == WALKING) {
+				stickfigure_animator->SetCurrentAnimation(stickfigure_anim);
+			} else if (manState == STANDING) {
+				stickfigure_animator->SetCurrentAnimation(stickfigure_idle);
 			}
-			if (!collectible.collected &&
-				checkAABBCollision(manAABBmin, manAABBmax, collectible.AABBmin, collectible.AABBmax)) {
-				collectible.collected = true;
-				collectedCount++;
-				std::cout << "Collected an item! (" << collectedCount << "/" << totalCollectibles << ")\n";
+			// the bone matrices of the selected animation, shared by every skinned variant
+			frame.bones = stickfigure_animator->GetFinalBoneMatrices();
+		}
+
+		// only the character moves, the collectibles keep the world matrices of their first frame
+		transforms.setLocal(manNode, manPos,
+			glm::angleAxis(manRot.y, vec3(0, 1, 0)) * glm::angleAxis(manRot.z, vec3(0, 0, 1)), vec3(0.01f));
+		transforms.update();
+		const mat4& manModel = transforms.getWorld(manNode);
+
+		// world bounds of everything that may be drawn, culled in one pass before anything is submitted
+		sceneCuller.clear();
+		size_t groundBox = sceneCuller.add(vec3(-groundSize, 0, -groundSize), vec3(groundSize, 0, groundSize), mat4(1.0f));
+		// skinning moves the meshes away from their bind pose bounds, the character is culled as a whole
+		size_t manBox = sceneCuller.add(stickfigure_running->getBoundingBoxMin(), stickfigure_running->getBoundingBoxMax(), manModel);
+		// index of each collectible's first mesh box, the others follow it
+		ArenaVector<size_t> collectibleBoxes(collectibles.size());
+		for (size_t i = 0; i < collectibles.size(); i++) {
+			if (collectibles[i].collected) continue;
+			collectibleBoxes[i] = sceneCuller.getCount();
+			for (const AssimpMesh& mesh : collectibles[i].model->meshes) {
+				sceneCuller.add(mesh.boundsMin, mesh.boundsMax, transforms.getWorld(collectibles[i].transform));
 			}
 		}
+		{
+			Profiler::Zone cullZone("culling");
+			sceneCuller.cull(P * V, &threadPool);
+		}
 
-		// Draw collectibles
-		for (auto& collectible : collectibles) {
-			// Skip drawing if collected
-			if (collectible.collected) continue;
+		RenderQueue::Packet groundPacket;
+		groundPacket.program = prog2.get();
+		groundPacket.geometry.vertexArray = GroundVertexArrayID;
+		groundPacket.geometry.indexType = GL_UNSIGNED_SHORT;
+		groundPacket.geometry.indexCount = g_GiboLen;
+		groundPacket.record = frame.addRecord(mat4(1.0f), MATERIAL_SILVER);
+		groundPacket.depth = -(V * vec4(0, 0, 0, 1)).z;
+		if (sceneCuller.isVisible(groundBox)) {
+			frame.packets.push_back(groundPacket);
+		}
 
-			Model->pushMatrix();
-				Model->loadIdentity();
-				Model->translate(collectible.position);
-				Model->scale(collectible.scale);
-				setModel(texProg, Model);
-				glUniformMatrix4fv(texProg->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
+		// each character mesh with the leanest variant that fits it; skinned, so never merged.
+		// Variants are looked up, not compiled: that needs the GL thread, and prepare() built them all
+		if (sceneCuller.isVisible(manBox)) {
+			GLuint manDraw = frame.addRecord(manModel, MATERIAL_GOLD, DrawRecords::FLAG_TEXTURED);
+			int manLod = stickfigure_running->selectLod(V * manModel, P, height);
+			for (const AssimpMesh& mesh : stickfigure_running->meshes) {
+				shared_ptr<Program> variant = assimpVariants.find(mesh.getShaderFeatures());
+				if (!variant) continue;
+				submitMesh(frame, mesh, variant.get(), nullptr, manDraw, manLod, viewDepth(V * manModel, stickfigure_running));
+			}
+		}
 
-				// Bind the diffuse texture to texture unit 0
-				glActiveTexture(GL_TEXTURE0);
+		// one record per visible collectible mesh; copies of a model merge into instanced draws
+		ArenaVector<const MaterialBatcher::Placement*> placements;
+		for (size_t i = 0; i < collectibles.size(); i++) {
+			if (collectibles[i].collected) continue;
+
+			const mat4& collectibleModel = transforms.getWorld(collectibles[i].transform);
+			size_t firstBox = collectibleBoxes[i];
+			const AssimpModel* model = collectibles[i].model;
+			int lod = model->selectLod(V * collectibleModel, P, height);
+			float depth = viewDepth(V * collectibleModel, model);
+			if (batchMaterials && findPlacements(model, placements)) {
+				// every batched mesh samples an array, so meshes sharing one draw back to back
+				for (size_t m = 0; m < placements.size(); m++) {
+					if (!sceneCuller.isVisible(firstBox + m)) continue;
+					GLuint flags = DrawRecords::FLAG_TEXTURED | (placements[m]->atlased ? DrawRecords::FLAG_ATLASED : 0);
+					GLuint record = frame.addRecord(collectibleModel, MATERIAL_COLLECTIBLE, flags, placements[m]->layer, placements[m]->uvTransform);
+					RenderQueue::Packet packet;
+					packet.program = texArrayProg.get();
+					packet.instancedProgram = texArrayInstancedProg.get();
+					packet.geometry = model->meshes[m].getGeometry(lod);
+					packet.textures = &arrayBindings[placements[m]->array];
+					packet.textureCount = 1;
+					packet.textureTarget = GL_TEXTURE_2D_ARRAY;
+					packet.record = record;
+					packet.depth = depth;
+					frame.packets.push_back(packet);
+				}
+			} else {
+				GLuint record = frame.addRecord(collectibleModel, MATERIAL_COLLECTIBLE);
+				for (size_t m = 0; m < model->meshes.size(); m++) {
+					if (!sceneCuller.isVisible(firstBox + m)) continue;
+					submitMesh(frame, model->meshes[m], texProg.get(), texInstancedProg.get(), record, lod, depth);
+				}
+			}
+		}
 
-				// draw the collectible
-				collectible.model->Draw(texProg);
-			Model->popMatrix();
+		// static, so only culled and copied into the frame; LOD 1 as the field is never close
+		size_t barrelsVisible = 0;
+		if (!barrelFieldTransforms.empty()) {
+			{
+				Profiler::Zone cullZone("culling barrels");
+				barrelFieldCuller.cull(P * V, &threadPool);
+			}
+			RenderFrame::InstancedBatch& batch = frame.addBatch();
+			batch.model = barrel;
+			batch.program = texInstancedProg;
+			batch.lod = 1;
+			for (size_t i = 0; i < barrelFieldTransforms.size(); i++) {
+				if (barrelFieldCuller.isVisible(i)) {
+					batch.transforms.push_back(barrelFieldTransforms[i]);
+					batch.params.push_back(barrelFieldParams[i]);
+				}
+			}
+			barrelsVisible = batch.transforms.size();
 		}
 
-		// example of drawing a barrel
-		//Model->pushMatrix();
-		//	Model->loadIdentity();
+		RenderFrame::Stats& stats = frame.stats;
+		stats.visible = sceneCuller.getStats().visible + barrelsVisible;
+		stats.culled = sceneCuller.getStats().culled + barrelFieldTransforms.size() - barrelsVisible;
+		stats.transformsUpdated = transforms.getUpdatedCount();
+		stats.transformCount = transforms.getCount();
+		stats.pickupTests = pickupIndex.getLastTestCount();
+		stats.pickupItems = pickupIndex.getItemCount();
+		stats.ticks = timestep.getTickCount();
+		stats.droppedTicks = timestep.getDroppedTicks();
+		stats.tickRate = timestep.getRate();
+	}
 
-		//	// Position barrel
-		//	vec3 barrelPos = glm::vec3(0, 0, -5);
-		//	Model->translate(barrelPos);
+	// Draws a recorded frame; once loading is done, only the main thread calls GL and it does so only here
+	void executeFrame(const RenderFrame& frame) {
+		AllocationTracker::Scope allocationTag(AllocationTracker::TAG_RENDER);
+		Profiler::Zone zone("execute frame");
+		gpuTimer.beginFrame();
+		glViewport(0, 0, frame.width, frame.height);
 
-		//	// Scale the barrel
-		//	Model->scale(vec3(1.0f));
+		{
+			Profiler::Zone passZone("clear");
+			GpuTimer::Zone gpuZone(gpuTimer, "clear");
+			// Clear framebuffer.
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
 
-		//	glUniformMatrix4fv(texProg->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix()));
+		{
+			Profiler::Zone passZone("lights");
+			// camera and lights for every program, written once for the frame
+			frameUniforms.setCamera(frame.projection, frame.view);
+			lightClusters.clearLights();
+			for (const LightClusters::Light& light : frame.lights) {
+				lightClusters.addLight(light.position, light.color, light.intensity, light.radius);
+			}
+			lightClusters.build(frame.projection, frame.view, frame.far, frame.width, frame.height, &threadPool);
+			{
+				// binning is CPU work, only the uploads are timed on the GPU
+				GpuTimer::Zone gpuZone(gpuTimer, "lights");
+				frameUniforms.upload();
+				lightClusters.upload();
+			}
+		}
 
-		//	// Bind the diffuse texture to texture unit 0
-		//	glActiveTexture(GL_TEXTURE0);
+		{
+			Profiler::Zone passZone("uploads");
+			GpuTimer::Zone gpuZone(gpuTimer, "uploads");
+			// every draw of the frame uploaded together; the frame's record indices start at 0
+			drawRecords.beginFrame();
+			drawRecords.push(frame.records);
+			drawRecords.upload();
+			boneUniforms.upload(frame.bones);
+		}
 
-		//	// draw the barrel
-		//	barrel->Draw(texProg);
-		//Model->popMatrix();
+		{
+			Profiler::Zone passZone("scene");
+			GpuTimer::Zone gpuZone(gpuTimer, "scene");
+			// the queue orders the draws by state and depth, whatever order they were recorded in
+			renderQueue.beginFrame(frame.far);
+			for (const RenderQueue::Packet& packet : frame.packets) {
+				renderQueue.submit(packet);
+			}
+			renderQueue.execute(drawRecords, instanceBuffer);
+		}
 
-		texProg->unbind();
+		{
+			Profiler::Zone passZone("instanced");
+			GpuTimer::Zone gpuZone(gpuTimer, "instanced");
+			for (size_t i = 0; i < frame.batchCount; i++) {
+				const RenderFrame::InstancedBatch& batch = frame.batches[i];
+				batch.model->DrawInstanced(batch.program, instanceBuffer, batch.transforms.data(), batch.transforms.size(), batch.params.data(), batch.lod);
+			}
+		}
 
-		// Pop matrix stacks
-		Projection->popMatrix();
-		View->popMatrix();
+		// the ring region written this frame can be reused once the GPU is past these draws
+		drawRecords.endFrame();
+		gpuTimer.endFrame();
 	}
 };
 
@@ -865,23 +1052,102 @@ void mouseMoveCallbackWrapper(GLFWwindow* window, double xpos, double ypos) {
 
 int main(int argc, char *argv[])
 {
+	// Options start with "--" and may appear anywhere, the rest are positional
+	std::vector<std::string> positional;
+	bool glSync = false;
+	size_t barrels = 0;
+	double tickRate = 60.0;
+	double simulateSeconds = 0.0;
+	bool serial = false;
+	bool trackAllocations = false;
+	uint64_t allocationBenchmarkFrames = 0;
+	std::string profilePath;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+		{
+			positional.push_back(arg);
+		}
+		else if (arg == "--gl-sync")
+		{
+			// GL debug messages from inside the offending call, at the cost of stalls
+			glSync = true;
+		}
+		else if (arg == "--barrels" && i + 1 < argc)
+		{
+			barrels = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--tick-rate" && i + 1 < argc)
+		{
+			tickRate = strtod(argv[++i], nullptr);
+		}
+		else if (arg == "--simulate" && i + 1 < argc)
+		{
+			// simulated seconds to run as fast as possible without drawing, then exit
+			simulateSeconds = strtod(argv[++i], nullptr);
+		}
+		else if (arg == "--serial")
+		{
+			// record and draw each frame on the main thread, one after the other, to compare
+			serial = true;
+		}
+		else if (arg == "--profile" && i + 1 < argc)
+		{
+			// time loading and every frame, written to this file as a Chrome trace on exit
+			profilePath = argv[++i];
+		}
+		else if (arg == "--track-allocations")
+		{
+			// count heap allocations per frame and subsystem, reported with the other counters
+			trackAllocations = true;
+		}
+		else if (arg == "--allocation-benchmark" && i + 1 < argc)
+		{
+			// after a warm-up, run this many frames and fail if any of them allocates
+			allocationBenchmarkFrames = strtoull(argv[++i], nullptr, 10);
+			trackAllocations = true;
+		}
+		else
+		{
+			cerr << "Ignoring unknown option " << arg << endl;
+		}
+	}
+
 	// Where the resources are loaded from
 	std::string resourceDir = "../resources";
 
-	if (argc >= 2)
+	if (positional.size() >= 1)
+	{
+		resourceDir = positional[0];
+	}
+
+	// Loaders read from a cooked resource pack only when one is given, see the 'cook'
+	// target; a pack is a snapshot, edits to the loose files do not show through it
+	if (positional.size() >= 2 && !ResourcePack::mount(positional[1], resourceDir))
 	{
-		resourceDir = argv[1];
+		cerr << "Could not mount resource pack " << positional[1] << ", loading loose files" << endl;
 	}
 
+	// Linked programs are cached here and reused while the shaders and driver are unchanged
+	ProgramCache::setDirectory("shader_cache");
+
+	AllocationTracker::setEnabled(trackAllocations);
+	Profiler::setEnabled(!profilePath.empty());
+	Profiler::setThreadName("main");
+
 	Application *application = new Application();
 
 	// Your main will always include a similar set up to establish your window
 	// and GL context, etc
 
 	WindowManager *windowManager = new WindowManager();
-	windowManager->init(640, 480);
+	bool headless = simulateSeconds > 0.0;
+	windowManager->init(640, 480, !headless);
+	GLSL::setDebugOutputSynchronous(glSync);
 	windowManager->setEventCallbacks(application);
 	application->windowManager = windowManager;
+	application->barrelFieldCount = barrels;
 
 	glfwSetInputMode(windowManager->getHandle(), GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 	glfwSetWindowUserPointer(windowManager->getHandle(), application);
@@ -890,38 +1156,218 @@ int main(int argc, char *argv[])
 	// This is the code that will likely change program to program as you
 	// may need to initialize or set up different data and state
 
-	application->init(resourceDir);
-	application->initGeom(resourceDir);
-	application->initGround();
+	{
+		AllocationTracker::Scope allocationTag(AllocationTracker::TAG_ASSETS);
+		Profiler::Zone zone("loading");
+		application->init(resourceDir);
+		application->initGeom(resourceDir);
+		application->initGround();
+	}
+	if (trackAllocations)
+	{
+		AllocationTracker::report(cout);
+		AllocationTracker::reset();
+	}
 
-	auto lastTime = chrono::high_resolution_clock::now();
+	FixedTimestep& timestep = application->timestep;
+	timestep.setRate(tickRate);
+
+	if (headless)
+	{
+		// every tick back to back, the assets were only loaded for their bounds
+		application->scriptedInput = true;
+		double start = glfwGetTime();
+		while (timestep.getTime() < simulateSeconds)
+		{
+			for (int ticks = timestep.advance(timestep.getStep()); ticks > 0; ticks--)
+			{
+				application->simulate((float) timestep.getStep());
+			}
+		}
+		double wall = glfwGetTime() - start;
+		cout << "Simulated " << timestep.getTime() << " s in " << timestep.getTickCount() << " ticks of "
+			<< timestep.getStep() * 1000.0 << " ms, taking " << wall << " s ("
+			<< (wall > 0.0 ? timestep.getTime() / wall : 0.0) << "x real time)" << endl;
+		if (trackAllocations)
+		{
+			AllocationTracker::endFrame();
+			AllocationTracker::report(cout);
+		}
+		if (!profilePath.empty())
+		{
+			Profiler::writeChromeTrace(profilePath);
+		}
+		windowManager->shutdown();
+		return 0;
+	}
 
 	glfwSetInputMode(windowManager->getHandle(), GLFW_STICKY_KEYS, GLFW_TRUE);
 
+	int width, height;
+	glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
+	application->framebufferWidth = width;
+	application->framebufferHeight = height;
+
+	// The recording thread simulates and records frame N+1 while this thread draws frame N.
+	// GLFW only handles window events on the main thread, so it stays the GL thread
+	FrameQueue<RenderFrame> frames;
+	RenderFrame serialFrame;
+	std::thread recorder;
+	if (!serial)
+	{
+		recorder = std::thread([application, &frames]() {
+			Profiler::setThreadName("recorder");
+			// one clock for the simulation and the animation
+			double lastTime = glfwGetTime();
+			while (RenderFrame* frame = frames.acquireWrite())
+			{
+				double now = glfwGetTime();
+				application->advance(*frame, now - lastTime);
+				lastTime = now;
+				frames.publish();
+				FrameArena::local().reset();
+			}
+		});
+	}
+	double lastTime = glfwGetTime();
+
+	// state cache counters are reported as per-frame averages every few seconds
+	int stateFrames = 0;
+	double stateReportTime = glfwGetTime();
+	double recordTime = 0.0, executeTime = 0.0;
+	GLState::resetCounters();
+
+	// frames before the allocation benchmark starts counting, for caches and arenas to reach their size
+	const uint64_t ALLOCATION_WARMUP_FRAMES = 120;
+	uint64_t allocationFrames = 0;
+
 	// Loop until the user closes the window.
 	while (! glfwWindowShouldClose(windowManager->getHandle()))
 	{
-		auto nextLastTIme = chrono::high_resolution_clock::now();
+		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
+		application->framebufferWidth = width;
+		application->framebufferHeight = height;
 
-		float deltaTime = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - lastTime).count();
+		const RenderFrame* frame = &serialFrame;
+		if (serial)
+		{
+			double now = glfwGetTime();
+			application->advance(serialFrame, now - lastTime);
+			lastTime = now;
+		}
+		else if (!(frame = frames.acquireRead()))
+		{
+			break;
+		}
 
-		deltaTime *= 0.000001f; // convert to seconds
+		// Render scene.
+		double executeStart = glfwGetTime();
+		application->executeFrame(*frame);
+		executeTime += glfwGetTime() - executeStart;
+		recordTime += frame->stats.recordTime;
+		RenderFrame::Stats frameStats = frame->stats;
+		if (!serial)
+		{
+			frames.release();
+		}
+		// everything this thread took from its arena for the frame, recording included when serial
+		FrameArena::local().reset();
 
-		lastTime = nextLastTIme;
+		if (trackAllocations)
+		{
+			AllocationTracker::endFrame();
+			allocationFrames++;
+			if (allocationBenchmarkFrames > 0)
+			{
+				if (allocationFrames == ALLOCATION_WARMUP_FRAMES)
+				{
+					AllocationTracker::reset();
+				}
+				else if (allocationFrames == ALLOCATION_WARMUP_FRAMES + allocationBenchmarkFrames)
+				{
+					break;
+				}
+			}
+		}
 
-		float AnimcurrFrame = glfwGetTime();
-		application->AnimDeltaTime = AnimcurrFrame - application->AnimLastFrame;
-		application->AnimLastFrame = AnimcurrFrame;
-		// Render scene.
-		application->render(deltaTime, application->AnimDeltaTime);
+		stateFrames++;
+		// the allocation benchmark skips the report, printing it would allocate mid-run
+		if (allocationBenchmarkFrames == 0 && glfwGetTime() - stateReportTime >= 5.0) {
+			const GLState::Counters& counters = GLState::getCounters();
+			cout << "GL state calls per frame: " << counters.issued / stateFrames << " issued, "
+				<< counters.skipped / stateFrames << " skipped" << endl;
+			cout << "Clustered lights: " << application->lightClusters.getLightCount() << " lights, "
+				<< application->lightClusters.getIndexCount() << " cluster references, at most "
+				<< application->lightClusters.getMaxClusterLights() << " in one cluster" << endl;
+			cout << "Frustum culling, last frame: " << frameStats.visible << " visible, " << frameStats.culled << " culled" << endl;
+			cout << "Simulation: " << frameStats.ticks << " ticks at " << frameStats.tickRate
+				<< " Hz, " << frameStats.droppedTicks << " dropped after stalls" << endl;
+			cout << "Transforms, last frame: " << frameStats.transformsUpdated << " of "
+				<< frameStats.transformCount << " world matrices recomputed" << endl;
+			cout << "Pickup check, last frame: " << frameStats.pickupTests << " of "
+				<< frameStats.pickupItems << " collectibles tested" << endl;
+			cout << "Frame time: " << 1000.0 * recordTime / stateFrames << " ms recording, "
+				<< 1000.0 * executeTime / stateFrames << " ms drawing, " << (serial ? "one after the other" : "overlapped") << endl;
+			const RenderQueue::Stats& queueStats = application->renderQueue.getStats();
+			cout << "Render queue: " << queueStats.packets << " packets in " << queueStats.drawCalls << " draw calls, "
+				<< queueStats.instancedPackets << " of them merged into " << queueStats.instancedDraws << " instanced draws" << endl;
+			if (trackAllocations) {
+				AllocationTracker::report(cout);
+				// the report allocated too, start the next period after it
+				AllocationTracker::reset();
+			}
+			GLState::resetCounters();
+			stateFrames = 0;
+			recordTime = 0.0;
+			executeTime = 0.0;
+			stateReportTime = glfwGetTime();
+		}
 
 		// Swap front and back buffers
-		glfwSwapBuffers(windowManager->getHandle());
+		{
+			Profiler::Zone zone("swap");
+			glfwSwapBuffers(windowManager->getHandle());
+		}
 		// Poll for and process events
 		glfwPollEvents();
 	}
 
+	frames.close();
+	if (recorder.joinable())
+	{
+		recorder.join();
+	}
+
+	int status = 0;
+	if (allocationBenchmarkFrames > 0)
+	{
+		uint64_t steadyFrames = AllocationTracker::getFrameCount();
+		uint64_t allocating = AllocationTracker::getAllocatingFrameCount();
+		AllocationTracker::report(cout);
+		if (steadyFrames < allocationBenchmarkFrames)
+		{
+			cerr << "Allocation benchmark: window closed after " << steadyFrames << " of "
+				<< allocationBenchmarkFrames << " frames" << endl;
+			status = 1;
+		}
+		else if (allocating > 0)
+		{
+			cerr << "Allocation benchmark failed: " << allocating << " of " << steadyFrames
+				<< " steady frames allocated" << endl;
+			status = 1;
+		}
+		else
+		{
+			cout << "Allocation benchmark passed: " << steadyFrames << " frames without a heap allocation" << endl;
+		}
+	}
+
+	if (!profilePath.empty() && Profiler::writeChromeTrace(profilePath))
+	{
+		cout << "Profile written to " << profilePath << endl;
+	}
+
 	// Quit program
 	windowManager->shutdown();
-	return 0;
+	return status;
 }
@@ -0,0 +1,1065 @@
+// Offline asset cooker.
+//
+// Walks a resource directory, imports every model and image and writes cooked
+// outputs (see src/CookedFormats.h) that load without Assimp, stb_image or any
+// processing at startup:
+//   model.fbx -> model.fbx.mesh          optimized vertex/index buffers with LODs
+//                model.fbx.emb<n>.tex    one per embedded texture
+//   image.png -> image.png.tex           block compressed mip chain
+// AssimpModel and AssimpTextureFromFile use these instead of the sources when
+// they are in the mounted pack. Animations are still read from the sources,
+// Animation needs the full node hierarchy of the scene.
+//
+// With --pack, the files named in a pack list (see resources/pack.txt) are then
+// packed into resources.pack, which the game mounts when given its path: listed
+// models and images as their cooked outputs, anything else as is.
+//
+// A manifest in the output directory records a hash of every source and of the
+// settings used to cook it, so a rerun only re-cooks assets whose source,
+// importer settings or output format changed. Assets are cooked in parallel.
+//
+// usage: AssetCooker <resourceDir> <outputDir> [-j threads] [--force] [--pack list]
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "CookedFormats.h"
+#include "MeshOptimizer.h"
+#include "ResourcePack.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+// Same post-processing as AssimpModel::loadModel so cooked meshes match runtime imports
+static const unsigned int MODEL_IMPORT_FLAGS =
+    aiProcess_Triangulate |
+    aiProcess_GenSmoothNormals |
+    aiProcess_CalcTangentSpace |
+    aiProcess_ValidateDataStructure |
+    aiProcess_PopulateArmatureData |
+    aiProcess_GenBoundingBoxes;
+
+static const int MAX_BONE_INFLUENCE = 4;
+
+static const char *MANIFEST_NAME = "manifest.txt";
+static const char *PACK_NAME = "resources.pack";
+// manifest entry tracking the pack; not a valid relative path so it cannot clash
+static const char *PACK_KEY = ":pack";
+
+enum AssetKind {
+    ASSET_MODEL,
+    ASSET_IMAGE
+};
+
+struct ManifestEntry {
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    // relative to the output directory
+    std::vector<std::string> outputs;
+};
+
+// A line of the pack list
+struct PackListEntry {
+    // relative to the resource directory
+    std::string path;
+    // pack the file itself even when it is a cooked asset
+    bool source = false;
+};
+
+struct CookJob {
+    fs::path source;
+    // source path relative to the resource directory, also the manifest key
+    std::string key;
+    AssetKind kind;
+    uint64_t sourceHash = 0;
+    uint64_t settingsHash = 0;
+    bool dirty = true;
+    bool ok = false;
+    std::vector<std::string> outputs;
+};
+
+static std::mutex logMutex;
+
+// ---------------------------------------------------------------------------
+// Hashing and file helpers
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a(const std::string &text, uint64_t hash = FNV_OFFSET_BASIS) {
+    return fnv1a(text.data(), text.size(), hash);
+}
+
+static bool readFile(const fs::path &path, std::vector<unsigned char> &contents) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    contents.resize(static_cast<size_t>(size));
+    return size == 0 || file.read(reinterpret_cast<char *>(contents.data()), size).good();
+}
+
+static std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+// Collects little endian binary output in memory and writes it in one go. The
+// file is written next to its destination and renamed into place so an
+// interrupted cook never leaves a truncated output behind.
+class BinaryWriter {
+    public:
+        template <typename T>
+        void write(const T &value) {
+            writeBytes(&value, sizeof(T));
+        }
+
+        void writeBytes(const void *data, size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        void writeString(const std::string &text) {
+            write(static_cast<uint32_t>(text.size()));
+            writeBytes(text.data(), text.size());
+        }
+
+        bool save(const fs::path &path) const {
+            std::error_code error;
+            fs::create_directories(path.parent_path(), error);
+            fs::path temporary = path;
+            temporary += ".tmp";
+            {
+                std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+                if (!file || !file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size())) {
+                    return false;
+                }
+            }
+            fs::rename(temporary, path, error);
+            return !error;
+        }
+
+    private:
+        std::vector<unsigned char> buffer;
+};
+
+// ---------------------------------------------------------------------------
+// Manifest
+
+static std::map<std::string, ManifestEntry> loadManifest(const fs::path &path) {
+    std::map<std::string, ManifestEntry> manifest;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        // source \t sourceHash \t settingsHash \t output|output|...
+        std::istringstream fields(line);
+        std::string key, sourceHash, settingsHash, outputs;
+        if (!std::getline(fields, key, '\t') || !std::getline(fields, sourceHash, '\t') ||
+            !std::getline(fields, settingsHash, '\t')) {
+            continue;
+        }
+        std::getline(fields, outputs);
+
+        ManifestEntry entry;
+        entry.sourceHash = std::stoull(sourceHash, nullptr, 16);
+        entry.settingsHash = std::stoull(settingsHash, nullptr, 16);
+        std::istringstream outputList(outputs);
+        std::string output;
+        while (std::getline(outputList, output, '|')) {
+            if (!output.empty()) {
+                entry.outputs.push_back(output);
+            }
+        }
+        manifest[key] = std::move(entry);
+    }
+    return manifest;
+}
+
+static bool saveManifest(const fs::path &path, const std::map<std::string, ManifestEntry> &manifest) {
+    std::ostringstream text;
+    text << std::hex;
+    for (const auto &item : manifest) {
+        text << item.first << '\t' << item.second.sourceHash << '\t' << item.second.settingsHash << '\t';
+        for (size_t i = 0; i < item.second.outputs.size(); i++) {
+            text << (i ? "|" : "") << item.second.outputs[i];
+        }
+        text << '\n';
+    }
+    BinaryWriter writer;
+    std::string contents = text.str();
+    writer.writeBytes(contents.data(), contents.size());
+    return writer.save(path);
+}
+
+// Everything that changes the cooked output of a kind of asset besides the source itself
+static uint64_t settingsHash(AssetKind kind) {
+    std::ostringstream settings;
+    settings << "format=" << Cooked::COOKED_FORMAT_VERSION;
+    if (kind == ASSET_MODEL) {
+        settings << ";flags=" << MODEL_IMPORT_FLAGS << ";lods=" << MeshOptimizer::MAX_LODS << ";lodError=" << MeshOptimizer::LOD_MAX_ERROR
+                 << ";influences=" << MAX_BONE_INFLUENCE;
+    }
+    else {
+        settings << ";mips=box;blocks=bc1/bc3/bc4";
+    }
+    return fnv1a(settings.str());
+}
+
+// Hash of the source file plus any side files the importer reads with it
+static bool hashSource(const CookJob &job, uint64_t &hash) {
+    std::vector<unsigned char> contents;
+    if (!readFile(job.source, contents)) {
+        return false;
+    }
+    hash = fnv1a(contents.data(), contents.size());
+
+    // OBJ materials live in separate .mtl files
+    if (job.kind == ASSET_MODEL && toLower(job.source.extension().string()) == ".obj") {
+        std::istringstream lines(std::string(contents.begin(), contents.end()));
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0) {
+                continue;
+            }
+            std::string library = line.substr(7);
+            library.erase(library.find_last_not_of(" \r\t") + 1);
+            std::vector<unsigned char> material;
+            if (readFile(job.source.parent_path() / library, material)) {
+                hash = fnv1a(material.data(), material.size(), hash);
+            }
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Texture cooking
+
+static uint16_t packColor565(const int *rgb) {
+    int r = std::clamp(rgb[0], 0, 255), g = std::clamp(rgb[1], 0, 255), b = std::clamp(rgb[2], 0, 255);
+    return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void unpackColor565(uint16_t color, int *rgb) {
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block from 16 RGBA pixels. Endpoints come from the bounding box of
+// the block, flipped along the axes that correlate negatively with green and
+// inset slightly, which gets close to a PCA fit at a fraction of the cost.
+static void encodeColorBlock(const unsigned char *pixels, unsigned char *out) {
+    int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = std::min<int>(minColor[c], pixels[i * 4 + c]);
+            maxColor[c] = std::max<int>(maxColor[c], pixels[i * 4 + c]);
+            mean[c] += pixels[i * 4 + c] / 16.0f;
+        }
+    }
+    float covarianceRG = 0.0f, covarianceBG = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float g = pixels[i * 4 + 1] - mean[1];
+        covarianceRG += (pixels[i * 4 + 0] - mean[0]) * g;
+        covarianceBG += (pixels[i * 4 + 2] - mean[2]) * g;
+    }
+    if (covarianceRG < 0.0f) {
+        std::swap(minColor[0], maxColor[0]);
+    }
+    if (covarianceBG < 0.0f) {
+        std::swap(minColor[2], maxColor[2]);
+    }
+    for (int c = 0; c < 3; c++) {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        maxColor[c] -= inset;
+        minColor[c] += inset;
+    }
+
+    uint16_t color0 = packColor565(maxColor), color1 = packColor565(minColor);
+    // color0 > color1 selects the four color mode
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    uint32_t selectors = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDistance = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int delta = pixels[i * 4 + c] - palette[p][c];
+                    distance += delta * delta;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            selectors |= static_cast<uint32_t>(best) << (i * 2);
+        }
+    }
+
+    out[0] = color0 & 0xff;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xff;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (selectors >> (i * 8)) & 0xff;
+    }
+}
+
+// BC4 block (also the alpha half of BC3) from one channel of 16 RGBA pixels
+static void encodeSingleChannelBlock(const unsigned char *pixels, int channel, unsigned char *out) {
+    int minValue = 255, maxValue = 0;
+    for (int i = 0; i < 16; i++) {
+        minValue = std::min<int>(minValue, pixels[i * 4 + channel]);
+        maxValue = std::max<int>(maxValue, pixels[i * 4 + channel]);
+    }
+    out[0] = static_cast<unsigned char>(maxValue);
+    out[1] = static_cast<unsigned char>(minValue);
+
+    uint64_t selectors = 0;
+    if (maxValue != minValue) {
+        // endpoint0 > endpoint1 selects the eight value mode
+        int palette[8] = { maxValue, minValue };
+        for (int p = 2; p < 8; p++) {
+            palette[p] = ((8 - p) * maxValue + (p - 1) * minValue) / 7;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDistance = INT32_MAX;
+            for (int p = 0; p < 8; p++) {
+                int distance = std::abs(pixels[i * 4 + channel] - palette[p]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            selectors |= static_cast<uint64_t>(best) << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (selectors >> (i * 8)) & 0xff;
+    }
+}
+
+static size_t blockBytes(Cooked::TextureFormat format) {
+    return format == Cooked::TEXTURE_BC3 ? 16 : 8;
+}
+
+static void compressLevel(const std::vector<unsigned char> &rgba, int width, int height, Cooked::TextureFormat format, BinaryWriter &writer) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::vector<unsigned char> blocks(blocksX * blocksY * blockBytes(format));
+    unsigned char *out = blocks.data();
+    unsigned char pixels[16 * 4];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            // edge blocks repeat the last row/column
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(&pixels[(y * 4 + x) * 4], &rgba[(sy * width + sx) * 4], 4);
+                }
+            }
+            switch (format) {
+                case Cooked::TEXTURE_BC1:
+                    encodeColorBlock(pixels, out);
+                    break;
+                case Cooked::TEXTURE_BC3:
+                    encodeSingleChannelBlock(pixels, 3, out);
+                    encodeColorBlock(pixels, out + 8);
+                    break;
+                case Cooked::TEXTURE_BC4:
+                    encodeSingleChannelBlock(pixels, 0, out);
+                    break;
+            }
+            out += blockBytes(format);
+        }
+    }
+    writer.write(static_cast<uint32_t>(blocks.size()));
+    writer.writeBytes(blocks.data(), blocks.size());
+}
+
+// 2x2 box filter; odd edges reuse the last row/column
+static std::vector<unsigned char> downsample(const std::vector<unsigned char> &rgba, int width, int height, int &outWidth, int &outHeight) {
+    outWidth = std::max(1, width / 2);
+    outHeight = std::max(1, height / 2);
+    std::vector<unsigned char> result(outWidth * outHeight * 4);
+    for (int y = 0; y < outHeight; y++) {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < outWidth; x++) {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c] +
+                          rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c];
+                result[(y * outWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+// Writes a .tex from decoded RGBA pixels, rows top-down as stored in the source image
+static bool cookPixels(const unsigned char *data, int width, int height, int channels, const fs::path &output) {
+    std::vector<unsigned char> level(data, data + width * height * 4);
+
+    Cooked::TextureFormat format = Cooked::TEXTURE_BC3;
+    if (channels == 1) {
+        format = Cooked::TEXTURE_BC4;
+    }
+    else if (channels == 3) {
+        format = Cooked::TEXTURE_BC1;
+    }
+    else {
+        // BC1 is half the size, so only keep the alpha block when alpha is used
+        bool opaque = true;
+        for (size_t i = 3; i < level.size() && opaque; i += 4) {
+            opaque = level[i] == 255;
+        }
+        if (opaque) {
+            format = Cooked::TEXTURE_BC1;
+        }
+    }
+
+    uint32_t mipCount = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) {
+        mipCount++;
+    }
+
+    BinaryWriter writer;
+    writer.write(Cooked::CookedHeader{ Cooked::TEXTURE_MAGIC, Cooked::COOKED_FORMAT_VERSION });
+    writer.write(Cooked::TextureHeader{ static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipCount,
+                                        static_cast<uint32_t>(format), static_cast<uint32_t>(channels) });
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+        compressLevel(level, width, height, format, writer);
+        if (mip + 1 < mipCount) {
+            level = downsample(level, width, height, width, height);
+        }
+    }
+    return writer.save(output);
+}
+
+static bool cookImage(CookJob &job, const fs::path &outputDir) {
+    int width, height, channels;
+    unsigned char *data = stbi_load(job.source.string().c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "Failed to load image " << job.key << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    std::string output = job.key + ".tex";
+    bool ok = cookPixels(data, width, height, channels, outputDir / output);
+    stbi_image_free(data);
+    if (ok) {
+        job.outputs.push_back(output);
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Model cooking
+
+struct CookedBone {
+    uint32_t id;
+    aiMatrix4x4 offset;
+};
+
+struct CookedTextureRef {
+    std::string type;
+    std::string path;
+    int32_t embedded;
+};
+
+struct CookedMesh {
+    std::string name;
+    std::vector<Cooked::CookedVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshOptimizer::LodRange> lods;
+    std::vector<CookedTextureRef> textures;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// Mirrors AssimpModel::SetVertexBoneData
+static void addBoneInfluence(Cooked::CookedVertex &vertex, int boneId, float weight) {
+    if (weight <= 0.0f) {
+        return;
+    }
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (vertex.boneIds[i] == boneId) {
+            return;
+        }
+    }
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (vertex.boneIds[i] < 0) {
+            vertex.boneIds[i] = boneId;
+            vertex.weights[i] = weight;
+            break;
+        }
+    }
+}
+
+static void copyVector(const aiVector3D *source, unsigned int index, float *destination) {
+    if (source) {
+        destination[0] = source[index].x;
+        destination[1] = source[index].y;
+        destination[2] = source[index].z;
+    }
+    else {
+        destination[0] = destination[1] = destination[2] = 0.0f;
+    }
+}
+
+static CookedMesh cookMesh(const aiMesh *mesh, const aiScene *scene, std::map<std::string, CookedBone> &bones) {
+    CookedMesh result;
+    result.name = mesh->mName.C_Str();
+
+    std::vector<Cooked::CookedVertex> &vertices = result.vertices;
+    vertices.resize(mesh->mNumVertices);
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Cooked::CookedVertex &vertex = vertices[i];
+        copyVector(mesh->mVertices, i, vertex.position);
+        copyVector(mesh->mNormals, i, vertex.normal);
+        vertex.texCoords[0] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].x : 0.0f;
+        vertex.texCoords[1] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].y : 0.0f;
+        bool tangents = mesh->mTangents && mesh->mBitangents;
+        copyVector(tangents ? mesh->mTangents : nullptr, i, vertex.tangent);
+        copyVector(tangents ? mesh->mBitangents : nullptr, i, vertex.bitangent);
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            vertex.boneIds[j] = -1;
+            vertex.weights[j] = 0.0f;
+        }
+    }
+    result.indices.reserve(mesh->mNumFaces * 3);
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
+            result.indices.push_back(mesh->mFaces[i].mIndices[j]);
+        }
+    }
+
+    // bone ids are handed out in first-seen order across the node traversal, as at runtime
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone *bone = mesh->mBones[b];
+        auto inserted = bones.insert({ bone->mName.C_Str(), CookedBone{ static_cast<uint32_t>(bones.size()), bone->mOffsetMatrix } });
+        int boneId = inserted.first->second.id;
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            addBoneInfluence(vertices[bone->mWeights[w].mVertexId], boneId, bone->mWeights[w].mWeight);
+        }
+    }
+    for (auto &vertex : vertices) {
+        float total = 0.0f;
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            total += vertex.weights[j];
+        }
+        if (total > 0.0f) {
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+                vertex.weights[j] /= total;
+            }
+        }
+    }
+
+    // texture references by the sampler names the runtime binds them to
+    static const std::pair<aiTextureType, const char *> textureTypes[] = {
+        { aiTextureType_DIFFUSE, "texture_diffuse" },
+        { aiTextureType_SPECULAR, "texture_specular" },
+        { aiTextureType_HEIGHT, "texture_normal" },
+        { aiTextureType_AMBIENT, "texture_height" },
+        { aiTextureType_SHININESS, "texture_roughness" },
+        { aiTextureType_OPACITY, "texture_metalness" },
+        { aiTextureType_EMISSIVE, "texture_emission" },
+    };
+    const aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    for (const auto &type : textureTypes) {
+        for (unsigned int t = 0; t < material->GetTextureCount(type.first); t++) {
+            aiString path;
+            material->GetTexture(type.first, t, &path);
+            // same lookup as AssimpModel::loadMaterialTextures, by "*n" or by file name
+            int embedded = scene->GetEmbeddedTextureAndIndex(path.C_Str()).second;
+            result.textures.push_back({ type.second, path.C_Str(), embedded });
+        }
+    }
+
+    // same pipeline as AssimpModel::optimizeMesh
+    if (!vertices.empty() && !result.indices.empty()) {
+        std::vector<unsigned int> remap;
+        size_t uniqueCount = MeshOptimizer::generateVertexRemap(remap, vertices.data(), vertices.size(), sizeof(Cooked::CookedVertex));
+        MeshOptimizer::remapIndices(result.indices, remap);
+        MeshOptimizer::remapVertices(vertices, remap, uniqueCount);
+
+        std::vector<unsigned int> dominantBone(vertices.size(), MeshOptimizer::INVALID_INDEX);
+        bool skinned = false;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            float bestWeight = 0.0f;
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+                if (vertices[i].boneIds[j] >= 0 && vertices[i].weights[j] > bestWeight) {
+                    bestWeight = vertices[i].weights[j];
+                    dominantBone[i] = vertices[i].boneIds[j];
+                    skinned = true;
+                }
+            }
+        }
+
+        MeshOptimizer::buildLodChain(result.indices, result.lods, vertices[0].position, sizeof(Cooked::CookedVertex), vertices.size(),
+                                     MeshOptimizer::MAX_LODS, MeshOptimizer::LOD_MAX_ERROR, skinned ? dominantBone.data() : nullptr);
+
+        size_t fetchCount = MeshOptimizer::generateVertexFetchRemap(remap, result.indices, vertices.size());
+        MeshOptimizer::remapIndices(result.indices, remap);
+        MeshOptimizer::remapVertices(vertices, remap, fetchCount);
+    }
+
+    for (int c = 0; c < 3; c++) {
+        result.boundsMin[c] = vertices.empty() ? 0.0f : vertices[0].position[c];
+        result.boundsMax[c] = result.boundsMin[c];
+    }
+    for (const auto &vertex : vertices) {
+        for (int c = 0; c < 3; c++) {
+            result.boundsMin[c] = std::min(result.boundsMin[c], vertex.position[c]);
+            result.boundsMax[c] = std::max(result.boundsMax[c], vertex.position[c]);
+        }
+    }
+    return result;
+}
+
+static void collectMeshes(const aiNode *node, const aiScene *scene, std::vector<CookedMesh> &meshes, std::map<std::string, CookedBone> &bones) {
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        meshes.push_back(cookMesh(scene->mMeshes[node->mMeshes[i]], scene, bones));
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        collectMeshes(node->mChildren[i], scene, meshes, bones);
+    }
+}
+
+static bool writeMeshFile(const std::vector<CookedMesh> &meshes, const std::map<std::string, CookedBone> &bones, const fs::path &output) {
+    Cooked::MeshFileHeader fileHeader = {};
+    fileHeader.meshCount = static_cast<uint32_t>(meshes.size());
+    fileHeader.boneCount = static_cast<uint32_t>(bones.size());
+    for (int c = 0; c < 3; c++) {
+        fileHeader.boundsMin[c] = meshes.empty() ? 0.0f : meshes[0].boundsMin[c];
+        fileHeader.boundsMax[c] = meshes.empty() ? 0.0f : meshes[0].boundsMax[c];
+        for (const auto &mesh : meshes) {
+            fileHeader.boundsMin[c] = std::min(fileHeader.boundsMin[c], mesh.boundsMin[c]);
+            fileHeader.boundsMax[c] = std::max(fileHeader.boundsMax[c], mesh.boundsMax[c]);
+        }
+    }
+
+    BinaryWriter writer;
+    writer.write(Cooked::CookedHeader{ Cooked::MESH_MAGIC, Cooked::COOKED_FORMAT_VERSION });
+    writer.write(fileHeader);
+
+    // bones in id order so a loader can fill its table directly
+    std::vector<const std::pair<const std::string, CookedBone> *> boneOrder(bones.size());
+    for (const auto &bone : bones) {
+        boneOrder[bone.second.id] = &bone;
+    }
+    for (const auto *bone : boneOrder) {
+        const aiMatrix4x4 &m = bone->second.offset;
+        // column major, matching AssimpGLMHelpers::ConvertMatrixToGLMFormat
+        const float offset[16] = { m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+                                   m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4 };
+        writer.writeString(bone->first);
+        writer.write(bone->second.id);
+        writer.writeBytes(offset, sizeof(offset));
+    }
+
+    for (const auto &mesh : meshes) {
+        Cooked::MeshHeader header = {};
+        header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+        header.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        std::memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+        std::memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+        writer.write(header);
+        writer.writeString(mesh.name);
+        for (const auto &texture : mesh.textures) {
+            writer.writeString(texture.type);
+            writer.writeString(texture.path);
+            writer.write(texture.embedded);
+        }
+        for (const auto &lod : mesh.lods) {
+            writer.write(Cooked::LodRecord{ lod.indexOffset, lod.indexCount, lod.error });
+        }
+        writer.writeBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Cooked::CookedVertex));
+        if (mesh.vertices.size() <= 65536) {
+            for (unsigned int index : mesh.indices) {
+                writer.write(static_cast<uint16_t>(index));
+            }
+        }
+        else {
+            writer.writeBytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        }
+    }
+    return writer.save(output);
+}
+
+static bool cookModel(CookJob &job, const fs::path &outputDir) {
+    // one importer per job; Assimp importers are not shared between threads
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(job.source.string(), MODEL_IMPORT_FLAGS);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "Failed to import " << job.key << ": " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    std::vector<CookedMesh> meshes;
+    std::map<std::string, CookedBone> bones;
+    collectMeshes(scene->mRootNode, scene, meshes, bones);
+
+    std::string meshOutput = job.key + ".mesh";
+    if (!writeMeshFile(meshes, bones, outputDir / meshOutput)) {
+        return false;
+    }
+    job.outputs.push_back(meshOutput);
+
+    for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+        const aiTexture *texture = scene->mTextures[i];
+        int width, height, channels;
+        unsigned char *data;
+        if (texture->mHeight == 0) {
+            // compressed image file, mWidth is its size in bytes
+            data = stbi_load_from_memory(reinterpret_cast<const unsigned char *>(texture->pcData), texture->mWidth,
+                                         &width, &height, &channels, 4);
+        }
+        else {
+            // raw BGRA texels
+            width = texture->mWidth;
+            height = texture->mHeight;
+            channels = 4;
+            data = static_cast<unsigned char *>(stbi__malloc(width * height * 4));
+            for (int p = 0; data && p < width * height; p++) {
+                const aiTexel &texel = texture->pcData[p];
+                data[p * 4 + 0] = texel.r;
+                data[p * 4 + 1] = texel.g;
+                data[p * 4 + 2] = texel.b;
+                data[p * 4 + 3] = texel.a;
+            }
+        }
+        if (!data) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cerr << "Failed to decode embedded texture " << i << " of " << job.key << std::endl;
+            continue;
+        }
+        std::string textureOutput = job.key + ".emb" + std::to_string(i) + ".tex";
+        bool ok = cookPixels(data, width, height, channels, outputDir / textureOutput);
+        stbi_image_free(data);
+        if (!ok) {
+            return false;
+        }
+        job.outputs.push_back(textureOutput);
+    }
+
+    size_t triangles = 0;
+    for (const auto &mesh : meshes) {
+        triangles += mesh.lods.empty() ? 0 : mesh.lods[0].indexCount / 3;
+    }
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::cout << "Cooked " << job.key << ": " << meshes.size() << " meshes, " << triangles << " triangles, "
+              << bones.size() << " bones" << std::endl;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+static bool classify(const fs::path &path, AssetKind &kind) {
+    static const char *modelExtensions[] = { ".obj", ".fbx", ".dae", ".gltf", ".glb" };
+    static const char *imageExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga" };
+    std::string extension = toLower(path.extension().string());
+    for (const char *candidate : modelExtensions) {
+        if (extension == candidate) {
+            kind = ASSET_MODEL;
+            return true;
+        }
+    }
+    for (const char *candidate : imageExtensions) {
+        if (extension == candidate) {
+            kind = ASSET_IMAGE;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isInside(const fs::path &path, const fs::path &directory) {
+    std::string relative = path.lexically_relative(directory).generic_string();
+    return !relative.empty() && relative.compare(0, 2, "..") != 0;
+}
+
+// Reads a pack list: one path relative to the resource directory per line, or
+// "source <path>"; blank lines and lines starting with '#' are skipped
+static bool loadPackList(const fs::path &path, std::vector<PackListEntry> &entries) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \r\t") + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        PackListEntry entry;
+        if (line.compare(0, 7, "source ") == 0) {
+            entry.source = true;
+            line.erase(0, line.find_first_not_of(" \t", 7));
+        }
+        entry.path = fs::path(line).lexically_normal().generic_string();
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// Rebuilds the pack when any packed file changed. Only what the pack list names
+// goes in, in list order, so files loaded together are read together.
+static bool buildPack(const fs::path &resourceDir, const fs::path &outputDir, const fs::path &packList,
+                      const std::map<std::string, ManifestEntry> &manifest, std::map<std::string, ManifestEntry> &updated) {
+    std::vector<PackListEntry> entries;
+    if (!loadPackList(packList, entries)) {
+        std::cerr << "Failed to read pack list " << packList.string() << std::endl;
+        return false;
+    }
+
+    std::vector<ResourcePack::Input> inputs;
+    std::set<std::string> packed;
+    uint64_t packHash = FNV_OFFSET_BASIS;
+    auto addInput = [&](const std::string &name, const fs::path &file, uint64_t contentHash) {
+        if (!packed.insert(name).second) {
+            return;
+        }
+        packHash = fnv1a(name, packHash);
+        packHash = fnv1a(&contentHash, sizeof(contentHash), packHash);
+        inputs.push_back({ name, file.string(), true });
+    };
+
+    for (const PackListEntry &entry : entries) {
+        AssetKind kind;
+        if (!entry.source && classify(entry.path, kind)) {
+            // the loaders fall back to the source of anything that did not cook
+            auto cooked = updated.find(entry.path);
+            if (cooked == updated.end()) {
+                std::cerr << "Not packing " << entry.path << ", it has no cooked outputs" << std::endl;
+                continue;
+            }
+            uint64_t contentHash = fnv1a(&cooked->second.settingsHash, sizeof(uint64_t), cooked->second.sourceHash);
+            for (const std::string &output : cooked->second.outputs) {
+                addInput(Cooked::PACK_PREFIX + output, outputDir / output, contentHash);
+            }
+            continue;
+        }
+
+        std::vector<unsigned char> contents;
+        if (!readFile(resourceDir / entry.path, contents)) {
+            std::cerr << "Not packing " << entry.path << ", it cannot be read" << std::endl;
+            continue;
+        }
+        addInput(entry.path, resourceDir / entry.path, fnv1a(contents.data(), contents.size()));
+    }
+
+    uint64_t packSettings = fnv1a(&ResourcePack::PACK_VERSION, sizeof(ResourcePack::PACK_VERSION));
+    ManifestEntry entry{ packHash, packSettings, { PACK_NAME } };
+    auto previous = manifest.find(PACK_KEY);
+    if (previous != manifest.end() && previous->second.sourceHash == packHash &&
+        previous->second.settingsHash == packSettings && fs::exists(outputDir / PACK_NAME)) {
+        updated[PACK_KEY] = entry;
+        std::cout << "Pack up to date" << std::endl;
+        return true;
+    }
+
+    if (!ResourcePack::write((outputDir / PACK_NAME).string(), inputs)) {
+        return false;
+    }
+    updated[PACK_KEY] = entry;
+    std::cout << "Packed " << inputs.size() << " files into " << (outputDir / PACK_NAME).string() << " ("
+              << fs::file_size(outputDir / PACK_NAME) / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+static void printUsage() {
+    std::cerr << "usage: AssetCooker <resourceDir> <outputDir> [-j threads] [--force] [--pack list]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> positional;
+    unsigned int threadCount = 0;
+    bool force = false;
+    std::string packList;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threadCount = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--force") {
+            force = true;
+        }
+        else if (arg == "--pack" && i + 1 < argc) {
+            packList = argv[++i];
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            printUsage();
+            return 1;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fs::path resourceDir = fs::absolute(positional[0]).lexically_normal();
+    fs::path outputDir = fs::absolute(positional[1]).lexically_normal();
+    if (!fs::is_directory(resourceDir)) {
+        std::cerr << "Resource directory " << resourceDir << " does not exist" << std::endl;
+        return 1;
+    }
+    fs::create_directories(outputDir);
+
+    std::vector<CookJob> jobs;
+    for (const auto &item : fs::recursive_directory_iterator(resourceDir)) {
+        AssetKind kind;
+        if (!item.is_regular_file() || !classify(item.path(), kind)) {
+            continue;
+        }
+        // skip previous outputs when cooking into a subdirectory of the resources
+        if (isInside(item.path(), outputDir)) {
+            continue;
+        }
+        CookJob job;
+        job.source = item.path();
+        job.key = item.path().lexically_relative(resourceDir).generic_string();
+        job.kind = kind;
+        jobs.push_back(std::move(job));
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const CookJob &a, const CookJob &b) { return a.key < b.key; });
+
+    fs::path manifestPath = outputDir / MANIFEST_NAME;
+    std::map<std::string, ManifestEntry> manifest = force ? std::map<std::string, ManifestEntry>() : loadManifest(manifestPath);
+
+    ThreadPool pool(threadCount);
+
+    // hashing reads every source, so it runs on the pool as well
+    pool.parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            CookJob &job = jobs[i];
+            job.settingsHash = settingsHash(job.kind);
+            if (!hashSource(job, job.sourceHash)) {
+                continue;
+            }
+            auto previous = manifest.find(job.key);
+            if (previous == manifest.end() || previous->second.sourceHash != job.sourceHash ||
+                previous->second.settingsHash != job.settingsHash) {
+                continue;
+            }
+            bool outputsExist = true;
+            for (const std::string &output : previous->second.outputs) {
+                outputsExist = outputsExist && fs::exists(outputDir / output);
+            }
+            job.dirty = !outputsExist;
+        }
+    });
+
+    std::vector<CookJob *> dirty;
+    for (auto &job : jobs) {
+        if (job.dirty) {
+            dirty.push_back(&job);
+        }
+    }
+    // models take far longer than images, start them first for better balance
+    std::stable_sort(dirty.begin(), dirty.end(), [](const CookJob *a, const CookJob *b) { return a->kind < b->kind; });
+
+    std::cout << "Cooking " << dirty.size() << " of " << jobs.size() << " assets on " << pool.getThreadCount() << " threads" << std::endl;
+
+    std::atomic<size_t> failed{0};
+    pool.parallelFor(dirty.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            CookJob &job = *dirty[i];
+            job.ok = job.kind == ASSET_MODEL ? cookModel(job, outputDir) : cookImage(job, outputDir);
+            if (!job.ok) {
+                failed++;
+            }
+        }
+    });
+
+    // rebuild the manifest; failed assets are left out so the next run retries them
+    std::map<std::string, ManifestEntry> updated;
+    for (const auto &job : jobs) {
+        if (!job.dirty) {
+            updated[job.key] = manifest[job.key];
+        }
+        else if (job.ok) {
+            updated[job.key] = ManifestEntry{ job.sourceHash, job.settingsHash, job.outputs };
+        }
+    }
+
+    // without a pack list an earlier pack is removed below with the other stale outputs
+    bool packed = packList.empty() || buildPack(resourceDir, outputDir, packList, manifest, updated);
+
+    // remove outputs of sources that were deleted or no longer produce them
+    size_t removed = 0;
+    for (const auto &item : manifest) {
+        auto current = updated.find(item.first);
+        for (const std::string &output : item.second.outputs) {
+            bool stillProduced = current != updated.end() &&
+                std::find(current->second.outputs.begin(), current->second.outputs.end(), output) != current->second.outputs.end();
+            std::error_code error;
+            if (!stillProduced && fs::remove(outputDir / output, error)) {
+                removed++;
+            }
+        }
+    }
+
+    if (!saveManifest(manifestPath, updated)) {
+        std::cerr << "Failed to write manifest " << manifestPath << std::endl;
+        return 1;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Cooked " << dirty.size() - failed << " assets, " << jobs.size() - dirty.size() << " up to date, "
+              << failed << " failed, " << removed << " stale outputs removed in " << elapsed << " ms" << std::endl;
+    return failed || !packed ? 1 : 0;
+}